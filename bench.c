@@ -0,0 +1,1069 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+#include "bmp24.h"
+#include "kernels.h"
+#include "pipeline.h"
+#include "gaussian.h"
+#include "color.h"
+#include "geometry.h"
+#include "quantize.h"
+#include "qoi.h"
+#include "history.h"
+#include "histogram.h"
+#include "blend.h"
+
+// Compares three ways of running gaussian -> sharpen -> brightness on a large synthetic image:
+// one full pass per operation, the fused pipeline, and the cache-blocked tiled pipeline.
+// Usage: image_processing_bench [size] [tileSize]
+//        image_processing_bench gaussian [size]    recursive Gaussian accuracy and timings
+//        image_processing_bench color [size]       colour conversion throughput
+//        image_processing_bench geometry [size]    rotations, transposes and flips against naive loops
+//        image_processing_bench quantize [size]    palette construction and mapping to 8-bit indexed colour
+//        image_processing_bench qoi [size]         QOI against BMP: file size, save, load, encode and decode
+//        image_processing_bench dirty [size]       incremental pipeline update after small edits
+//        image_processing_bench history [size]     tiled undo history against a full copy per step
+//        image_processing_bench histogram [size]   sampled histograms against exact ones, in memory and from a file
+//        image_processing_bench stats [size]       single-pass statistics and auto-levels against separate passes
+//        image_processing_bench blend [size]       blend modes against a floating-point reference, and a small overlay on a file
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static t_bmp24 *make_test_image(int size) {
+    t_bmp24 *img = bmp24_allocate(size, size, 24);
+    if (!img) return NULL;
+    unsigned int seed = 12345u;
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            // Smooth gradients plus some noise, so kernels see realistic data
+            seed = seed * 1103515245u + 12345u;
+            int noise = (int)((seed >> 16) & 31u) - 16;
+            int r = (x * 255) / size + noise;
+            int g = (y * 255) / size - noise;
+            int b = ((x + y) * 127) / size + noise / 2;
+            img->data[y][x].red = (uint8_t)(r < 0 ? 0 : r > 255 ? 255 : r);
+            img->data[y][x].green = (uint8_t)(g < 0 ? 0 : g > 255 ? 255 : g);
+            img->data[y][x].blue = (uint8_t)(b < 0 ? 0 : b > 255 ? 255 : b);
+        }
+    }
+    return img;
+}
+
+static t_bmp24 *copy_image(const t_bmp24 *src) {
+    t_bmp24 *img = bmp24_allocate(src->width, src->height, 24);
+    if (!img) return NULL;
+    for (int y = 0; y < src->height; y++) memcpy(img->data[y], src->data[y], src->width * sizeof(t_pixel));
+    return img;
+}
+
+static int same_pixels(const t_bmp24 *a, const t_bmp24 *b) {
+    for (int y = 0; y < a->height; y++) {
+        if (memcmp(a->data[y], b->data[y], a->width * sizeof(t_pixel)) != 0) return 0;
+    }
+    return 1;
+}
+
+// Largest channel difference between two images, ignoring border pixels of both
+static int max_difference(const t_bmp24 *a, const t_bmp24 *b, int border) {
+    int largest = 0;
+    for (int y = border; y < a->height - border; y++) {
+        const uint8_t *p = (const uint8_t *)a->data[y], *q = (const uint8_t *)b->data[y];
+        for (int i = border * 3; i < (a->width - border) * 3; i++) {
+            int d = abs(p[i] - q[i]);
+            if (d > largest) largest = d;
+        }
+    }
+    return largest;
+}
+
+// Separable FIR Gaussian in double precision, radius ceil(4 sigma), edges clamped like the
+// recursive filter. Returns the filtered samples, width * 3 per row, top-down.
+static double *fir_gaussian(const t_bmp24 *img, float sigma) {
+    int w = img->width, h = img->height, radius = (int)ceil(4.0 * sigma);
+    double *taps = (double *)malloc((2 * radius + 1) * sizeof(double));
+    double *rows = (double *)malloc((size_t)w * h * 3 * sizeof(double));
+    double *out = (double *)malloc((size_t)w * h * 3 * sizeof(double));
+    if (!taps || !rows || !out) {
+        free(taps);
+        free(rows);
+        free(out);
+        return NULL;
+    }
+    double sum = 0.0;
+    for (int i = -radius; i <= radius; i++) sum += taps[i + radius] = exp(-(double)i * i / (2.0 * sigma * sigma));
+    for (int i = 0; i <= 2 * radius; i++) taps[i] /= sum;
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < h; y++) {
+        const uint8_t *src = (const uint8_t *)img->data[y];
+        for (int x = 0; x < w; x++) {
+            for (int c = 0; c < 3; c++) {
+                double v = 0.0;
+                for (int i = -radius; i <= radius; i++) {
+                    int xx = x + i < 0 ? 0 : (x + i >= w ? w - 1 : x + i);
+                    v += taps[i + radius] * src[3 * xx + c];
+                }
+                rows[((size_t)y * w + x) * 3 + c] = v;
+            }
+        }
+    }
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < h; y++) {
+        for (size_t i = 0; i < (size_t)w * 3; i++) {
+            double v = 0.0;
+            for (int k = -radius; k <= radius; k++) {
+                int yy = y + k < 0 ? 0 : (y + k >= h ? h - 1 : y + k);
+                v += taps[k + radius] * rows[(size_t)yy * w * 3 + i];
+            }
+            out[(size_t)y * w * 3 + i] = v;
+        }
+    }
+    free(taps);
+    free(rows);
+    return out;
+}
+
+// Recursive Gaussian against the FIR reference: the recursive cost stays flat while the FIR
+// cost grows with sigma. Errors are in gray levels over all samples, borders included.
+static int bench_gaussian(int size) {
+    static const float sigmas[] = {0.5f, 1.0f, 2.0f, 5.0f, 10.0f, 20.0f, 50.0f};
+    t_bmp24 *source = make_test_image(size);
+    if (!source) {
+        fprintf(stderr, "Error: Failed to set up the benchmark.\n");
+        return 1;
+    }
+    printf("Image: %d x %d, recursive (Young-van Vliet) vs FIR Gaussian of radius ceil(4 sigma)\n", size, size);
+    printf("%6s %14s %10s %12s %10s\n", "sigma", "recursive (ms)", "FIR (ms)", "max error", "RMSE");
+    for (size_t s = 0; s < sizeof(sigmas) / sizeof(sigmas[0]); s++) {
+        t_bmp24 *blurred = copy_image(source);
+        if (!blurred) break;
+        double start = now_seconds();
+        bmp24_gaussianBlur(blurred, sigmas[s]);
+        double recursive_time = now_seconds() - start;
+        start = now_seconds();
+        double *reference = fir_gaussian(source, sigmas[s]);
+        double fir_time = now_seconds() - start;
+        if (!reference) {
+            bmp24_free(blurred);
+            break;
+        }
+
+        double max_error = 0.0, squared = 0.0;
+        for (int y = 0; y < size; y++) {
+            const uint8_t *p = (const uint8_t *)blurred->data[y];
+            for (int i = 0; i < size * 3; i++) {
+                double e = fabs(p[i] - reference[(size_t)y * size * 3 + i]);
+                if (e > max_error) max_error = e;
+                squared += e * e;
+            }
+        }
+        printf("%6.1f %14.1f %10.1f %12.2f %10.3f\n", sigmas[s], recursive_time * 1000.0, fir_time * 1000.0,
+               max_error, sqrt(squared / ((double)size * size * 3)));
+        free(reference);
+        bmp24_free(blurred);
+    }
+    bmp24_free(source);
+    return 0;
+}
+
+// Throughput of each conversion over the whole image, in megapixels per second, plus the
+// largest channel difference after a planar round trip
+static int bench_color(int size) {
+    static const char *names[] = {"ycbcr", "yuv", "hsv"};
+    t_bmp24 *source = make_test_image(size);
+    t_bmp24 *work = source ? copy_image(source) : NULL;
+    if (!source || !work) {
+        fprintf(stderr, "Error: Failed to set up the benchmark.\n");
+        return 1;
+    }
+    double megapixels = (double)size * size / 1e6;
+    printf("Image: %d x %d, throughput in megapixels per second\n", size, size);
+    printf("%-8s %10s %10s %10s %10s %10s\n", "space", "to planar", "from", "in place", "back", "max error");
+    for (int space = COLOR_YCBCR; space <= COLOR_HSV; space++) {
+        double start = now_seconds();
+        t_planar_image *planar = bmp24_toPlanar(source, (t_color_space)space);
+        double to_time = now_seconds() - start;
+        if (!planar) break;
+        start = now_seconds();
+        bmp24_fromPlanar(work, planar);
+        double from_time = now_seconds() - start;
+        int max_error = 0;
+        for (int y = 0; y < size; y++) {
+            const uint8_t *a = (const uint8_t *)source->data[y], *b = (const uint8_t *)work->data[y];
+            for (int i = 0; i < size * 3; i++) {
+                int e = abs(a[i] - b[i]);
+                if (e > max_error) max_error = e;
+            }
+        }
+        planar_free(planar);
+
+        start = now_seconds();
+        bmp24_toColorSpace(work, (t_color_space)space);
+        double in_place_time = now_seconds() - start;
+        start = now_seconds();
+        bmp24_fromColorSpace(work, (t_color_space)space);
+        double back_time = now_seconds() - start;
+        printf("%-8s %10.1f %10.1f %10.1f %10.1f %10d\n", names[space], megapixels / to_time, megapixels / from_time,
+               megapixels / in_place_time, megapixels / back_time, max_error);
+    }
+
+    double start = now_seconds();
+    t_bmp8 *gray = bmp24_toGray8(source, LUMA_BT601);
+    double luma_time = now_seconds() - start;
+    start = now_seconds();
+    bmp24_equalize(work);
+    double equalize_time = now_seconds() - start;
+    printf("%-8s %10.1f\n", "luma", megapixels / luma_time);
+    printf("%-8s %10.1f   (fine luma, histogram and luma shift)\n", "equalize", megapixels / equalize_time);
+    bmp8_free(gray);
+    bmp24_free(source);
+    bmp24_free(work);
+    return 0;
+}
+
+// Pixel (x, y) of the source that lands on (x, y) of a w x h result
+typedef void (*t_source_of)(int x, int y, int w, int h, int *sx, int *sy);
+static void source_rotate90(int x, int y, int w, int h, int *sx, int *sy) { (void)h; *sx = y; *sy = w - 1 - x; }
+static void source_rotate180(int x, int y, int w, int h, int *sx, int *sy) { *sx = w - 1 - x; *sy = h - 1 - y; }
+static void source_rotate270(int x, int y, int w, int h, int *sx, int *sy) { (void)w; *sx = h - 1 - y; *sy = x; }
+static void source_transpose(int x, int y, int w, int h, int *sx, int *sy) { (void)w; (void)h; *sx = y; *sy = x; }
+static void source_flip_h(int x, int y, int w, int h, int *sx, int *sy) { (void)h; *sx = w - 1 - x; *sy = y; }
+static void source_flip_v(int x, int y, int w, int h, int *sx, int *sy) { (void)w; *sx = x; *sy = h - 1 - y; }
+
+static int check_geometry24(const t_bmp24 *src, const t_bmp24 *out, t_source_of source_of) {
+    for (int y = 0; y < out->height; y++) {
+        for (int x = 0; x < out->width; x++) {
+            int sx, sy;
+            source_of(x, y, out->width, out->height, &sx, &sy);
+            if (memcmp(&out->data[y][x], &src->data[sy][sx], sizeof(t_pixel)) != 0) return 0;
+        }
+    }
+    return 1;
+}
+
+static int check_geometry8(const t_bmp8 *src, const t_bmp8 *out, t_source_of source_of) {
+    int w = (int)out->width, h = (int)out->height;
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            int sx, sy;
+            source_of(x, y, w, h, &sx, &sy);
+            // Both are stored bottom-up
+            if (out->data[(size_t)(h - 1 - y) * w + x] != src->data[(size_t)(src->height - 1 - sy) * src->width + sx]) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+// The loop geometric ops replace: one pixel at a time down the destination columns
+static t_bmp24 *naive_rotate90(const t_bmp24 *img) {
+    t_bmp24 *out = bmp24_allocate(img->height, img->width, 24);
+    if (!out) return NULL;
+    for (int y = 0; y < img->height; y++) {
+        for (int x = 0; x < img->width; x++) out->data[x][img->height - 1 - y] = img->data[y][x];
+    }
+    return out;
+}
+
+static int bench_geometry(int size) {
+    // Sides that are not multiples of the tile size exercise the ragged edges
+    int width = size + 5, height = size * 3 / 4 + 3;
+    t_bmp24 *square = make_test_image(width > height ? width : height);
+    t_bmp24 *source = square ? bmp24_allocate(width, height, 24) : NULL;
+    if (!source) {
+        fprintf(stderr, "Error: Failed to set up the benchmark.\n");
+        return 1;
+    }
+    for (int y = 0; y < height; y++) memcpy(source->data[y], square->data[y], width * sizeof(t_pixel));
+    bmp24_free(square);
+    t_bmp8 *gray = bmp24_toGray8(source, LUMA_BT601);
+    if (!gray) return 1;
+    double megapixels = (double)width * height / 1e6;
+    printf("Image: %d x %d, throughput in megapixels per second\n", width, height);
+
+    double start = now_seconds();
+    t_bmp24 *naive = naive_rotate90(source);
+    double naive_time = now_seconds() - start;
+    printf("%-12s %10.1f %10s\n", "naive 90", megapixels / naive_time, "(bmp24)");
+    bmp24_free(naive);
+
+    static const char *names[] = {"rotate 90", "rotate 180", "rotate 270", "transpose", "flip h", "flip v"};
+    static const t_source_of sources[] = {source_rotate90, source_rotate180, source_rotate270, source_transpose,
+                                          source_flip_h, source_flip_v};
+    printf("%-12s %10s %10s %8s\n", "op", "bmp24", "bmp8", "check");
+    int failures = 0;
+    for (int op = 0; op < 6; op++) {
+        t_bmp24 *out24 = NULL;
+        t_bmp8 *out8 = NULL;
+        double time24, time8;
+        if (op < 4) {
+            start = now_seconds();
+            out24 = (op == 3) ? bmp24_transpose(source) : bmp24_rotate(source, 90 * (op + 1));
+            time24 = now_seconds() - start;
+            start = now_seconds();
+            out8 = (op == 3) ? bmp8_transpose(gray) : bmp8_rotate(gray, 90 * (op + 1));
+            time8 = now_seconds() - start;
+        } else {
+            // In place, on copies
+            out24 = copy_image(source);
+            out8 = bmp8_allocate(gray->width, gray->height);
+            if (!out24 || !out8) break;
+            memcpy(out8->data, gray->data, gray->dataSize);
+            start = now_seconds();
+            if (op == 4) bmp24_flipHorizontal(out24);
+            else bmp24_flipVertical(out24);
+            time24 = now_seconds() - start;
+            start = now_seconds();
+            if (op == 4) bmp8_flipHorizontal(out8);
+            else bmp8_flipVertical(out8);
+            time8 = now_seconds() - start;
+        }
+        if (!out24 || !out8) break;
+        int ok = check_geometry24(source, out24, sources[op]) && check_geometry8(gray, out8, sources[op]);
+        if (!ok) failures++;
+        printf("%-12s %10.1f %10.1f %8s\n", names[op], megapixels / time24, megapixels / time8, ok ? "ok" : "FAILED");
+        bmp24_free(out24);
+        bmp8_free(out8);
+    }
+    bmp24_free(source);
+    bmp8_free(gray);
+    return failures ? 1 : 0;
+}
+
+// Peak signal to noise ratio of an indexed image against the 24-bit original, in dB
+static double palette_psnr(const t_bmp24 *src, const t_bmp8 *indexed) {
+    double squared = 0.0;
+    int w = src->width, h = src->height;
+    for (int y = 0; y < h; y++) {
+        const uint8_t *a = (const uint8_t *)src->data[y];
+        const uint8_t *row = indexed->data + (size_t)(h - 1 - y) * w;
+        for (int x = 0; x < w; x++) {
+            for (int c = 0; c < 3; c++) {
+                double e = (double)a[x * 3 + c] - indexed->colorTable[row[x] * 4 + c];
+                squared += e * e;
+            }
+        }
+    }
+    double mse = squared / ((double)w * h * 3);
+    return mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+// The mapping the inverse table replaces: a search of the whole palette for every pixel
+static t_bmp8 *naive_map(const t_bmp24 *img, const t_palette *palette) {
+    t_bmp8 *out = bmp8_allocate(img->width, img->height);
+    if (!out) return NULL;
+    for (int i = 0; i < palette->count; i++) {
+        out->colorTable[i * 4] = palette->colors[i].blue;
+        out->colorTable[i * 4 + 1] = palette->colors[i].green;
+        out->colorTable[i * 4 + 2] = palette->colors[i].red;
+    }
+    for (int y = 0; y < img->height; y++) {
+        uint8_t *dst = out->data + (size_t)(img->height - 1 - y) * img->width;
+        for (int x = 0; x < img->width; x++) {
+            const t_pixel *p = &img->data[y][x];
+            int best = 0, best_distance = 1 << 30;
+            for (int i = 0; i < palette->count; i++) {
+                int dr = p->red - palette->colors[i].red, dg = p->green - palette->colors[i].green;
+                int db = p->blue - palette->colors[i].blue;
+                int d = dr * dr + dg * dg + db * db;
+                if (d < best_distance) {
+                    best_distance = d;
+                    best = i;
+                }
+            }
+            dst[x] = (uint8_t)best;
+        }
+    }
+    return out;
+}
+
+// Palette construction time, mapping throughput and quality for both methods, with and without
+// dithering, against a full palette search per pixel
+static int bench_quantize(int size) {
+    static const char *methods[] = {"median cut", "octree"};
+    t_bmp24 *source = make_test_image(size);
+    if (!source) {
+        fprintf(stderr, "Error: Failed to set up the benchmark.\n");
+        return 1;
+    }
+    double megapixels = (double)size * size / 1e6;
+    printf("Image: %d x %d, 256 colours, mapping throughput in megapixels per second\n", size, size);
+    printf("%-12s %8s %12s %10s %10s %12s %10s\n", "method", "colours", "palette (ms)", "map", "PSNR", "dithered", "PSNR");
+    t_palette first = {0};
+    for (int method = QUANTIZE_MEDIAN_CUT; method <= QUANTIZE_OCTREE; method++) {
+        t_palette palette;
+        double start = now_seconds();
+        if (quantize_buildPalette(source, 256, (t_quantize_method)method, &palette) != 0) break;
+        double palette_time = now_seconds() - start;
+        if (method == QUANTIZE_MEDIAN_CUT) first = palette;
+        start = now_seconds();
+        t_bmp8 *plain = bmp24_mapToPalette(source, &palette, DITHER_NONE);
+        double plain_time = now_seconds() - start;
+        start = now_seconds();
+        t_bmp8 *dithered = bmp24_mapToPalette(source, &palette, DITHER_FLOYD_STEINBERG);
+        double dither_time = now_seconds() - start;
+        if (!plain || !dithered) break;
+        printf("%-12s %8d %12.1f %10.1f %10.2f %12.1f %10.2f\n", methods[method], palette.count, palette_time * 1000.0,
+               megapixels / plain_time, palette_psnr(source, plain), megapixels / dither_time,
+               palette_psnr(source, dithered));
+        bmp8_free(plain);
+        bmp8_free(dithered);
+    }
+    double start = now_seconds();
+    t_bmp8 *naive = naive_map(source, &first);
+    double naive_time = now_seconds() - start;
+    if (naive) {
+        printf("%-12s %8d %12s %10.1f %10.2f   (median cut palette, full search)\n", "naive", first.count, "",
+               megapixels / naive_time, palette_psnr(source, naive));
+    }
+    bmp8_free(naive);
+    bmp24_free(source);
+    return 0;
+}
+
+// Saves, loads, encodes and decodes img as BMP and as QOI. Throughputs are in megabytes of
+// 24-bit pixels per second, so both formats are measured against the same amount of image.
+static int bench_qoi_image(const char *name, const t_bmp24 *img) {
+    char paths[2][256];
+    snprintf(paths[0], sizeof(paths[0]), "%s/image_processing_bench_%d.bmp", P_tmpdir, (int)getpid());
+    snprintf(paths[1], sizeof(paths[1]), "%s/image_processing_bench_%d.qoi", P_tmpdir, (int)getpid());
+    double megabytes = (double)img->width * img->height * 3 / (1024.0 * 1024.0);
+    double bmp_size = 0.0;
+    int failures = 0;
+    for (int format = 0; format < 2; format++) {
+        double start = now_seconds();
+        bmp24_saveImage((t_bmp24 *)img, paths[format]);     // The extension picks the format
+        double save_time = now_seconds() - start;
+        start = now_seconds();
+        t_bmp24 *loaded = bmp24_loadImage(paths[format]);
+        double load_time = now_seconds() - start;
+        remove(paths[format]);
+
+        t_byte_buffer encoded;
+        buffer_init(&encoded);
+        start = now_seconds();
+        int status = format ? qoi_encodeMemory(img, &encoded) : bmp24_encodeMemory(img, &encoded);
+        double encode_time = now_seconds() - start;
+        start = now_seconds();
+        t_bmp24 *decoded = status == 0 ? bmp24_decodeMemory(encoded.data, encoded.size) : NULL;
+        double decode_time = now_seconds() - start;
+        double size = encoded.size / (1024.0 * 1024.0);
+        if (format == 0) bmp_size = size;
+
+        int ok = loaded && decoded && same_pixels(img, loaded) && same_pixels(img, decoded);
+        if (!ok) failures++;
+        printf("%-8s %-5s %10.1f %8.2f %10.1f %10.1f %10.1f %10.1f %6s\n", name, format ? "QOI" : "BMP", size,
+               size / bmp_size, megabytes / save_time, megabytes / load_time, megabytes / encode_time,
+               megabytes / decode_time, ok ? "ok" : "FAILED");
+        bmp24_free(loaded);
+        bmp24_free(decoded);
+        buffer_free(&encoded);
+    }
+    return failures;
+}
+
+// A noisy photo-like image and a flat 16-colour graphic of the same size
+static int bench_qoi(int size) {
+    t_bmp24 *photo = make_test_image(size);
+    t_bmp8 *indexed = photo ? bmp24_quantize(photo, 16, QUANTIZE_MEDIAN_CUT, DITHER_NONE) : NULL;
+    t_bmp24 *graphic = indexed ? bmp8_expandPalette(indexed) : NULL;
+    bmp8_free(indexed);
+    if (!graphic) {
+        fprintf(stderr, "Error: Failed to set up the benchmark.\n");
+        return 1;
+    }
+    printf("Image: %d x %d, throughput in MB of 24-bit pixels per second\n", size, size);
+    printf("%-8s %-5s %10s %8s %10s %10s %10s %10s %6s\n", "image", "file", "size (MB)", "ratio", "save", "load",
+           "encode", "decode", "check");
+    int failures = bench_qoi_image("photo", photo) + bench_qoi_image("graphic", graphic);
+    bmp24_free(photo);
+    bmp24_free(graphic);
+    return failures ? 1 : 0;
+}
+
+// Runs plan on a copy of source, the reference an incremental update must reproduce
+static t_bmp24 *full_result24(const t_pipeline *plan, const t_bmp24 *source) {
+    t_bmp24 *result = copy_image(source);
+    if (result && pipeline_executeTiledBmp24(plan, result, 0) != 0) {
+        bmp24_free(result);
+        return NULL;
+    }
+    return result;
+}
+
+static t_bmp8 *full_result8(const t_pipeline *plan, const t_bmp8 *source) {
+    t_bmp8 *result = bmp8_allocate(source->width, source->height);
+    if (!result) return NULL;
+    memcpy(result->data, source->data, source->dataSize);
+    if (pipeline_executeTiledBmp8(plan, result, 0) != 0) {
+        bmp8_free(result);
+        return NULL;
+    }
+    return result;
+}
+
+// A retouch session: the chain's result is computed once, then a few small patches of the source
+// are brightened and the result is brought up to date, against recomputing it in full
+static int bench_dirty(int size) {
+    t_bmp24 *source = make_test_image(size);
+    t_pipeline *plan = pipeline_parse("gaussian,sharpen,brightness=20");
+    if (!source || !plan) {
+        fprintf(stderr, "Error: Failed to set up the benchmark.\n");
+        return 1;
+    }
+    pipeline_optimize(plan);
+    t_bmp8 *source8 = bmp24_toGray8(source, LUMA_BT601);
+    t_bmp24 *result = full_result24(plan, source);
+    t_bmp8 *result8 = source8 ? full_result8(plan, source8) : NULL;
+    if (!result || !result8) return 1;
+
+    // A patch in the middle, one across the top-left corner and one overlapping the first
+    t_rect patches[] = {{size / 2, size / 3, 64, 64}, {-10, -10, 40, 30}, {size / 2 + 32, size / 3 + 40, 64, 64}};
+    // The edits record themselves; both images clip the patches alike and share the region
+    t_dirty_region dirty;
+    dirty_clear(&dirty);
+    source->dirty = &dirty;
+    source8->dirty = &dirty;
+    for (size_t i = 0; i < sizeof(patches) / sizeof(patches[0]); i++) {
+        bmp24_brightnessRegion(source, 40, &patches[i]);
+        bmp8_brightnessRegion(source8, 40, &patches[i]);
+    }
+    long long changed = 0;
+    for (int i = 0; i < dirty.count; i++) {
+        t_rect r;
+        if (rect_clip(&dirty.rects[i], size, size, &r)) changed += (long long)r.width * r.height;
+    }
+
+    double start = now_seconds();
+    int status = pipeline_updateBmp24(plan, source, result, &dirty);
+    double update_time = now_seconds() - start;
+    start = now_seconds();
+    t_bmp24 *full = full_result24(plan, source);
+    double full_time = now_seconds() - start;
+    int status8 = pipeline_updateBmp8(plan, source8, result8, &dirty);
+    t_bmp8 *full8 = full_result8(plan, source8);
+    if (status != 0 || status8 != 0 || !full || !full8) return 1;
+
+    int same = same_pixels(result, full) && memcmp(result8->data, full8->data, full8->dataSize) == 0;
+    printf("Image: %d x %d, chain: gaussian, sharpen, brightness=20, footprint %d pixels\n", size, size,
+           pipeline_footprint(plan));
+    printf("Edited: %d patches merged into %d rectangles, %lld pixels (%.3f%% of the image)\n",
+           (int)(sizeof(patches) / sizeof(patches[0])), dirty.count, changed, 100.0 * changed / ((double)size * size));
+    printf("%-12s %10s\n", "mode", "time (ms)");
+    printf("%-12s %10.2f\n", "full", full_time * 1000.0);
+    printf("%-12s %10.2f   (%.0fx faster)\n", "incremental", update_time * 1000.0, full_time / update_time);
+    printf("Incremental result %s the full recompute (24-bit and 8-bit).\n", same ? "matches" : "DIFFERS FROM");
+    pipeline_free(plan);
+    bmp24_free(source);
+    bmp24_free(result);
+    bmp24_free(full);
+    bmp8_free(source8);
+    bmp8_free(result8);
+    bmp8_free(full8);
+    return same ? 0 : 1;
+}
+
+// A retouch session recorded in the undo history: many small patches, then one whole-image
+// filter. Every step is undone and redone, and the image is checked against copies taken along
+// the way; a full copy of the image per step is what the history replaces.
+static int bench_history(int size) {
+    const int patches = 64;
+    t_bmp24 *img = make_test_image(size);
+    t_bmp24 *original = img ? copy_image(img) : NULL;
+    t_history *history = img ? history_createBmp24(img, HISTORY_DEFAULT_LIMIT) : NULL;
+    if (!img || !original || !history) {
+        fprintf(stderr, "Error: Failed to set up the benchmark.\n");
+        return 1;
+    }
+
+    double edit_time = 0.0, commit_time = 0.0, copy_time = 0.0;
+    for (int i = 0; i < patches; i++) {
+        t_rect patch = {(i * 977) % (size - 64), (i * 631) % (size - 64), 64, 64};
+        double start = now_seconds();
+        history_begin(history, &patch);
+        bmp24_brightnessRegion(img, 30, &patch);
+        history_commit(history, "Brightness");
+        commit_time += now_seconds() - start;
+    }
+    t_bmp24 *patched = copy_image(img);
+    double start = now_seconds();
+    t_bmp24 *snapshot = copy_image(img);
+    copy_time = now_seconds() - start;
+    bmp24_free(snapshot);
+    start = now_seconds();
+    history_begin(history, NULL);
+    bmp24_negative(img);
+    history_commit(history, "Negative");
+    edit_time = now_seconds() - start;
+    long long bytes = history->bytes;
+    t_bmp24 *final = copy_image(img);
+    if (!patched || !final) return 1;
+
+    start = now_seconds();
+    int undone = history_undo(history);
+    double undo_whole = now_seconds() - start;
+    int same = undone && same_pixels(img, patched);
+    start = now_seconds();
+    while (history_undo(history)) undone++;
+    double undo_patches = now_seconds() - start;
+    same = same && same_pixels(img, original);
+    int redone = 0;
+    start = now_seconds();
+    while (history_redo(history)) redone++;
+    double redo_time = now_seconds() - start;
+    same = same && same_pixels(img, final) && undone == patches + 1 && redone == patches + 1;
+
+    long long image_bytes = (long long)size * size * 3;
+    printf("Image: %d x %d, %d patches of 64 x 64 then a negative of the whole image\n", size, size, patches);
+    printf("%-28s %10s\n", "operation", "time (ms)");
+    printf("%-28s %10.3f\n", "full copy, per step", copy_time * 1000.0);
+    printf("%-28s %10.3f\n", "patch edit + commit, mean", commit_time * 1000.0 / patches);
+    printf("%-28s %10.3f\n", "whole-image edit + commit", edit_time * 1000.0);
+    printf("%-28s %10.3f\n", "undo whole-image step", undo_whole * 1000.0);
+    printf("%-28s %10.3f\n", "undo patch step, mean", undo_patches * 1000.0 / patches);
+    printf("%-28s %10.3f\n", "redo all steps", redo_time * 1000.0);
+    printf("History: %.1f MB for %d steps, against %.1f MB for a full copy per step\n", bytes / 1e6,
+           patches + 1, (patches + 1) * (double)image_bytes / 1e6);
+    printf("Undo and redo %s the copies taken along the way.\n", same ? "reproduce" : "DO NOT REPRODUCE");
+    history_free(history);
+    bmp24_free(img);
+    bmp24_free(original);
+    bmp24_free(patched);
+    bmp24_free(final);
+    return same ? 0 : 1;
+}
+
+// Largest difference between the equalization maps of two histograms, in gray levels
+static int map_difference(const unsigned int *a, const unsigned int *b) {
+    unsigned int *mapA = bmp8_computeCDF(a);
+    unsigned int *mapB = bmp8_computeCDF(b);
+    int worst = 256;
+    if (mapA && mapB) {
+        worst = 0;
+        for (int v = 0; v < 256; v++) {
+            int d = abs((int)mapA[v] - (int)mapB[v]);
+            if (d > worst) worst = d;
+        }
+    }
+    free(mapA);
+    free(mapB);
+    return worst;
+}
+
+// Sampled histograms at falling rates against the exact one: time, share of pixels read, the
+// estimated and the measured CDF error, and how far the equalization maps drift. Then the same
+// from a file on disk, against loading the whole image.
+static int bench_histogram(int size) {
+    const double rates[] = {1.0, 0.25, 0.05, 0.01, 0.002};
+    t_bmp24 *color = make_test_image(size);
+    t_bmp8 *img = color ? bmp24_toGray8(color, LUMA_BT601) : NULL;
+    if (!img) {
+        fprintf(stderr, "Error: Failed to set up the benchmark.\n");
+        return 1;
+    }
+    double start = now_seconds();
+    unsigned int *exact = bmp8_computeHistogram(img);
+    double exact_time = now_seconds() - start;
+    unsigned int *exact24 = bmp24_sampleLumaHistogram(color, NULL, 1.0, NULL);
+    if (!exact || !exact24) return 1;
+
+    int ok = 1;
+    printf("Image: %d x %d\n", size, size);
+    printf("%-8s %-6s %10s %8s %10s %10s %8s\n", "rate", "depth", "time (ms)", "read %", "bound", "error", "map diff");
+    printf("%-8s %-6s %10.2f %8.2f %10s %10s %8s\n", "exact", "8-bit", exact_time * 1000.0, 100.0, "-", "-", "-");
+    for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        for (int depth = 8; depth <= 24; depth += 16) {
+            t_sample_info info;
+            start = now_seconds();
+            unsigned int *hist = depth == 8 ? bmp8_sampleHistogram(img, NULL, rates[i], &info)
+                                            : bmp24_sampleLumaHistogram(color, NULL, rates[i], &info);
+            double time = now_seconds() - start;
+            if (!hist) return 1;
+            const unsigned int *reference = depth == 8 ? exact : exact24;
+            double error = histogram_cdfError(hist, reference);
+            printf("%-8g %2d-bit %10.2f %8.2f %10.5f %10.5f %8d\n", rates[i], depth, time * 1000.0,
+                   100.0 * info.sampled / info.total, info.errorBound, error, map_difference(hist, reference));
+            // The estimate is a 95% bound, so it should only rarely be beaten
+            if (rates[i] == 1.0 ? error != 0.0 : error > 2.0 * info.errorBound) ok = 0;
+            free(hist);
+        }
+    }
+
+    const char *path = "/tmp/image_processing_bench_histogram.bmp";
+    bmp8_saveImage(path, img);
+    start = now_seconds();
+    t_bmp8 *loaded = bmp8_loadImage(path);
+    unsigned int *full = loaded ? bmp8_computeHistogram(loaded) : NULL;
+    double load_time = now_seconds() - start;
+    t_sample_info info;
+    start = now_seconds();
+    unsigned int *sampled = histogram_sampleFile(path, 0.01, &info);
+    double file_time = now_seconds() - start;
+    if (!full || !sampled) return 1;
+    printf("From the file: load + exact %.2f ms, sampled at 0.01 %.2f ms (%.2f%% read, error %.5f)\n",
+           load_time * 1000.0, file_time * 1000.0, 100.0 * info.sampled / info.total, histogram_cdfError(sampled, full));
+    ok = ok && memcmp(full, exact, 256 * sizeof(unsigned int)) == 0;
+    printf("Sampled errors %s their estimates.\n", ok ? "stay within" : "EXCEED");
+    unlink(path);
+    free(full);
+    free(sampled);
+    bmp8_free(loaded);
+    free(exact);
+    free(exact24);
+    bmp8_free(img);
+    bmp24_free(color);
+    return ok ? 0 : 1;
+}
+
+// What bmp24_computeStats replaces: one pass per statistic and channel, the percentiles from a
+// histogram of their own
+static void naive_stats(const t_bmp24 *img, int channel, int *min, int *max, double *mean, double *variance,
+                        int *p1, int *p99) {
+    const uint8_t *base;
+    *min = 255;
+    *max = 0;
+    for (int y = 0; y < img->height; y++)
+        for (int x = 0; x < img->width; x++) {
+            base = (const uint8_t *)&img->data[y][x];
+            if (base[channel] < *min) *min = base[channel];
+            if (base[channel] > *max) *max = base[channel];
+        }
+    double sum = 0.0, n = (double)img->width * img->height;
+    for (int y = 0; y < img->height; y++)
+        for (int x = 0; x < img->width; x++) sum += ((const uint8_t *)&img->data[y][x])[channel];
+    *mean = sum / n;
+    double squares = 0.0;
+    for (int y = 0; y < img->height; y++)
+        for (int x = 0; x < img->width; x++) {
+            double d = ((const uint8_t *)&img->data[y][x])[channel] - *mean;
+            squares += d * d;
+        }
+    *variance = squares / n;
+    unsigned long long hist[256] = {0}, seen = 0;
+    for (int y = 0; y < img->height; y++)
+        for (int x = 0; x < img->width; x++) hist[((const uint8_t *)&img->data[y][x])[channel]]++;
+    *p1 = *p99 = -1;
+    for (int v = 0; v < 256; v++) {
+        seen += hist[v];
+        if (*p1 < 0 && seen >= 0.01 * n) *p1 = v;
+        if (*p99 < 0 && seen >= 0.99 * n) *p99 = v;
+    }
+}
+
+// Statistics of a washed-out image in one pass against separate passes, then the auto-levels
+// stretch it feeds
+static int bench_stats(int size) {
+    t_bmp24 *img = make_test_image(size);
+    if (!img) {
+        fprintf(stderr, "Error: Failed to set up the benchmark.\n");
+        return 1;
+    }
+    for (int y = 0; y < size; y++)
+        for (int x = 0; x < size; x++) {
+            img->data[y][x].blue = (uint8_t)(60 + img->data[y][x].blue / 3);
+            img->data[y][x].green = (uint8_t)(70 + img->data[y][x].green / 2);
+            img->data[y][x].red = (uint8_t)(40 + img->data[y][x].red / 4);
+        }
+
+    t_image_stats stats;
+    double start = now_seconds();
+    if (bmp24_computeStats(img, NULL, &stats) != 0) return 1;
+    double single_time = now_seconds() - start;
+    int ok = 1;
+    start = now_seconds();
+    for (int c = 0; c < 3; c++) {
+        int min, max, p1, p99;
+        double mean, variance;
+        naive_stats(img, c, &min, &max, &mean, &variance, &p1, &p99);
+        const t_channel_stats *channel = &stats.channel[c];
+        if (min != channel->min || max != channel->max || fabs(mean - channel->mean) > 1e-6 ||
+            fabs(variance - channel->variance) > 1e-6 * (1.0 + variance) || p1 != stats_percentile(channel, 0.01) ||
+            p99 != stats_percentile(channel, 0.99))
+            ok = 0;
+    }
+    double naive_time = now_seconds() - start;
+
+    start = now_seconds();
+    int status = bmp24_autoLevels(img, 0.005, LEVELS_PER_CHANNEL);
+    double levels_time = now_seconds() - start;
+    t_image_stats after;
+    if (status != 0 || bmp24_computeStats(img, NULL, &after) != 0) return 1;
+
+    printf("Image: %d x %d, channels squeezed into part of the range\n", size, size);
+    printf("%-24s %10s\n", "operation", "time (ms)");
+    printf("%-24s %10.2f\n", "separate passes", naive_time * 1000.0);
+    printf("%-24s %10.2f   (%.1fx faster)\n", "single pass", single_time * 1000.0, naive_time / single_time);
+    printf("%-24s %10.2f\n", "auto-levels (0.5% clip)", levels_time * 1000.0);
+    const char *names[] = {"blue", "green", "red"};
+    for (int c = 0; c < 3; c++) {
+        printf("%-6s before %3d-%3d (p0.5 %3d, p99.5 %3d), after %3d-%3d (p0.5 %3d, p99.5 %3d)\n", names[c],
+               stats.channel[c].min, stats.channel[c].max, stats_percentile(&stats.channel[c], 0.005),
+               stats_percentile(&stats.channel[c], 0.995), after.channel[c].min, after.channel[c].max,
+               stats_percentile(&after.channel[c], 0.005), stats_percentile(&after.channel[c], 0.995));
+        if (stats_percentile(&after.channel[c], 0.995) < 250) ok = 0;
+    }
+    printf("Single-pass statistics %s the separate passes.\n", ok ? "match" : "DIFFER FROM");
+    bmp24_free(img);
+    return ok ? 0 : 1;
+}
+
+// The blend of one byte in floating point, rounded once at the end of each step
+static uint8_t reference_blend(int b, int o, int a, t_blend_mode mode) {
+    double f = o;
+    if (mode == BLEND_ADD) f = b + o > 255 ? 255 : b + o;
+    else if (mode == BLEND_MULTIPLY) f = round(b * o / 255.0);
+    else if (mode == BLEND_SCREEN) f = 255 - round((255 - b) * (255 - o) / 255.0);
+    else if (mode == BLEND_DIFFERENCE) f = abs(b - o);
+    return (uint8_t)round((b * (255.0 - a) + f * a) / 255.0);
+}
+
+// Every mode over a whole image through a mask, checked against the floating-point reference,
+// then a small watermark blended into a large file in place against loading and saving it all
+static int bench_blend(int size) {
+    const char *names[] = {"over", "add", "multiply", "screen", "difference"};
+    t_bmp24 *base = make_test_image(size);
+    t_bmp24 *overlay = base ? bmp24_rotate(base, 180) : NULL;
+    t_bmp8 *mask = base ? bmp24_toGray8(base, LUMA_BT601) : NULL;
+    t_bmp24 *work = base ? copy_image(base) : NULL;
+    if (!base || !overlay || !mask || !work) {
+        fprintf(stderr, "Error: Failed to set up the benchmark.\n");
+        return 1;
+    }
+    const int opacity = 200, dx = size / 8, dy = -size / 8;
+    int ok = 1;
+    printf("Image: %d x %d, overlay offset by (%d, %d), mask and opacity %d\n", size, size, dx, dy, opacity);
+    printf("%-12s %10s %10s %8s\n", "mode", "time (ms)", "MB/s", "exact");
+    for (int mode = BLEND_OVER; mode <= BLEND_DIFFERENCE; mode++) {
+        for (int y = 0; y < size; y++) memcpy(work->data[y], base->data[y], size * sizeof(t_pixel));
+        double start = now_seconds();
+        if (bmp24_blend(work, overlay, mask, dx, dy, (t_blend_mode)mode, opacity) != 0) return 1;
+        double time = now_seconds() - start;
+        int exact = 1;
+        for (int y = 0; y < size && exact; y++) {
+            for (int x = 0; x < size; x++) {
+                int sx = x - dx, sy = y - dy;
+                const uint8_t *b = (const uint8_t *)&base->data[y][x];
+                const uint8_t *w = (const uint8_t *)&work->data[y][x];
+                int inside = sx >= 0 && sx < size && sy >= 0 && sy < size;
+                for (int c = 0; c < 3; c++) {
+                    uint8_t expected = b[c];
+                    if (inside) {
+                        int a = (int)round(mask->data[(size_t)(size - 1 - sy) * size + sx] * opacity / 255.0);
+                        expected = reference_blend(b[c], ((const uint8_t *)&overlay->data[sy][sx])[c], a,
+                                                   (t_blend_mode)mode);
+                    }
+                    if (w[c] != expected) exact = 0;
+                }
+            }
+        }
+        double covered = (double)(size - dx) * (size + dy) * 3;
+        printf("%-12s %10.2f %10.0f %8s\n", names[mode], time * 1000.0, covered / time / 1e6, exact ? "yes" : "NO");
+        ok = ok && exact;
+    }
+
+    // A 256 x 256 watermark near the bottom-right corner of the file
+    const char *path = "/tmp/image_processing_bench_blend.bmp";
+    t_bmp24 *mark = bmp24_allocate(256, 256, 24);
+    if (!mark) return 1;
+    bmp24_saveImage(base, path);
+    for (int y = 0; y < 256; y++) memcpy(mark->data[y], overlay->data[y], 256 * sizeof(t_pixel));
+    double start = now_seconds();
+    t_bmp24 *loaded = bmp24_loadImage(path);
+    int status = loaded ? bmp24_blend(loaded, mark, NULL, size - 300, size - 300, BLEND_OVER, 128) : -1;
+    if (status == 0) bmp24_saveImage(loaded, path);
+    double whole_time = now_seconds() - start;
+    bmp24_saveImage(base, path);
+    start = now_seconds();
+    if (status != 0 || bmp24_blendFile(path, mark, NULL, size - 300, size - 300, BLEND_OVER, 128) != 0) return 1;
+    double file_time = now_seconds() - start;
+    t_bmp24 *check = bmp24_loadImage(path);
+    ok = ok && check && same_pixels(check, loaded);
+    printf("256 x 256 watermark on the file: load, blend and save %.2f ms, in place %.2f ms\n", whole_time * 1000.0,
+           file_time * 1000.0);
+    printf("Blends %s the reference, in memory and in the file.\n", ok ? "match" : "DO NOT MATCH");
+    unlink(path);
+    bmp24_free(check);
+    bmp24_free(loaded);
+    bmp24_free(mark);
+    bmp24_free(base);
+    bmp24_free(overlay);
+    bmp24_free(work);
+    bmp8_free(mask);
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "color") == 0) {
+        int size = argc > 2 ? atoi(argv[2]) : 2048;
+        if (size < 16) {
+            fprintf(stderr, "Error: Image size must be at least 16.\n");
+            return 1;
+        }
+        return bench_color(size);
+    }
+    if (argc > 1 && strcmp(argv[1], "geometry") == 0) {
+        int size = argc > 2 ? atoi(argv[2]) : 4096;
+        if (size < 16) {
+            fprintf(stderr, "Error: Image size must be at least 16.\n");
+            return 1;
+        }
+        return bench_geometry(size);
+    }
+    if (argc > 1 && strcmp(argv[1], "quantize") == 0) {
+        int size = argc > 2 ? atoi(argv[2]) : 2048;
+        if (size < 16) {
+            fprintf(stderr, "Error: Image size must be at least 16.\n");
+            return 1;
+        }
+        return bench_quantize(size);
+    }
+    if (argc > 1 && strcmp(argv[1], "qoi") == 0) {
+        int size = argc > 2 ? atoi(argv[2]) : 2048;
+        if (size < 16) {
+            fprintf(stderr, "Error: Image size must be at least 16.\n");
+            return 1;
+        }
+        return bench_qoi(size);
+    }
+    if (argc > 1 && strcmp(argv[1], "dirty") == 0) {
+        int size = argc > 2 ? atoi(argv[2]) : 4096;
+        if (size < 256) {
+            fprintf(stderr, "Error: Image size must be at least 256.\n");
+            return 1;
+        }
+        return bench_dirty(size);
+    }
+    if (argc > 1 && strcmp(argv[1], "history") == 0) {
+        int size = argc > 2 ? atoi(argv[2]) : 4096;
+        if (size < 256) {
+            fprintf(stderr, "Error: Image size must be at least 256.\n");
+            return 1;
+        }
+        return bench_history(size);
+    }
+    if (argc > 1 && strcmp(argv[1], "histogram") == 0) {
+        int size = argc > 2 ? atoi(argv[2]) : 4096;
+        if (size < 16) {
+            fprintf(stderr, "Error: Image size must be at least 16.\n");
+            return 1;
+        }
+        return bench_histogram(size);
+    }
+    if (argc > 1 && strcmp(argv[1], "stats") == 0) {
+        int size = argc > 2 ? atoi(argv[2]) : 4096;
+        if (size < 16) {
+            fprintf(stderr, "Error: Image size must be at least 16.\n");
+            return 1;
+        }
+        return bench_stats(size);
+    }
+    if (argc > 1 && strcmp(argv[1], "blend") == 0) {
+        int size = argc > 2 ? atoi(argv[2]) : 4096;
+        if (size < 512) {
+            fprintf(stderr, "Error: Image size must be at least 512.\n");
+            return 1;
+        }
+        return bench_blend(size);
+    }
+    if (argc > 1 && strcmp(argv[1], "gaussian") == 0) {
+        int size = argc > 2 ? atoi(argv[2]) : 512;
+        if (size < 16) {
+            fprintf(stderr, "Error: Image size must be at least 16.\n");
+            return 1;
+        }
+        return bench_gaussian(size);
+    }
+
+    int size = argc > 1 ? atoi(argv[1]) : 4096;
+    int tile_size = argc > 2 ? atoi(argv[2]) : 0;
+    if (size < 16) {
+        fprintf(stderr, "Error: Image size must be at least 16.\n");
+        return 1;
+    }
+
+    t_bmp24 *source = make_test_image(size);
+    t_bmp24 *op_by_op = source ? copy_image(source) : NULL;
+    t_bmp24 *fused = source ? copy_image(source) : NULL;
+    t_bmp24 *tiled = source ? copy_image(source) : NULL;
+    t_bmp24 *merged = source ? copy_image(source) : NULL;
+    t_pipeline *pipeline = pipeline_parse("gaussian,sharpen,brightness=20");
+    t_pipeline *merging = pipeline_parse("merge,gaussian,sharpen,brightness=20");
+    float **gaussian = create_kernel(3, gaussian_blur_values_3x3);
+    float **sharpen = create_kernel(3, sharpen_values_3x3);
+    if (!source || !op_by_op || !fused || !tiled || !merged || !pipeline || !merging || !gaussian || !sharpen) {
+        fprintf(stderr, "Error: Failed to set up the benchmark.\n");
+        return 1;
+    }
+    pipeline_optimize(pipeline);
+    pipeline_optimize(merging);
+
+    double start = now_seconds();
+    bmp24_applyFilter(op_by_op, gaussian, 3);
+    bmp24_applyFilter(op_by_op, sharpen, 3);
+    bmp24_brightness(op_by_op, 20);
+    double op_time = now_seconds() - start;
+
+    start = now_seconds();
+    pipeline_executeBmp24(pipeline, fused);
+    double fused_time = now_seconds() - start;
+
+    start = now_seconds();
+    pipeline_executeTiledBmp24(pipeline, tiled, tile_size);
+    double tiled_time = now_seconds() - start;
+
+    start = now_seconds();
+    pipeline_executeBmp24(merging, merged);
+    double merged_time = now_seconds() - start;
+
+    // Modeled main-memory traffic, in image sizes: a kernel pass reads its input, snapshots it
+    // and writes its output (about 4 images counting the write-allocate), a point pass reads and
+    // writes once. The tiled run reads each tile with its halo and writes it once.
+    double image_mb = (double)size * size * 3 / (1024.0 * 1024.0);
+    int halo = 2;
+    int tile = tile_size > 0 ? tile_size : 0;
+    if (tile == 0) {
+        long l2_size = PIPELINE_DEFAULT_L2_SIZE;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+        long reported = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        if (reported > 0) l2_size = reported;
+#endif
+        // Same rule as the pipeline: two tile buffers take half of L2
+        tile = (int)sqrt((double)l2_size / 4.0 / 3.0) - 2 * halo;
+        if (tile < 16) tile = 16;
+    }
+    double overlap = (double)(tile + 2 * halo) * (tile + 2 * halo) / ((double)tile * tile);
+    double op_traffic = image_mb * (4 + 4 + 2);
+    double fused_traffic = image_mb * (4 + 4);
+    double tiled_traffic = image_mb * (overlap + 1 + 1);
+    double merged_traffic = image_mb * 4;
+
+    printf("Image: %d x %d (%.1f MB), chain: gaussian, sharpen, brightness=20\n", size, size, image_mb);
+    printf("%-12s %10s %20s\n", "mode", "time (ms)", "est. traffic (MB)");
+    printf("%-12s %10.1f %20.1f\n", "op-by-op", op_time * 1000.0, op_traffic);
+    printf("%-12s %10.1f %20.1f\n", "fused", fused_time * 1000.0, fused_traffic);
+    printf("%-12s %10.1f %20.1f   (tile %d)\n", "tiled", tiled_time * 1000.0, tiled_traffic, tile);
+    printf("%-12s %10.1f %20.1f\n", "merged", merged_time * 1000.0, merged_traffic);
+    printf("Tiled output %s the fused output.\n", same_pixels(fused, tiled) ? "matches" : "DIFFERS FROM");
+    // The border ring of a merged kernel is clamped like one larger kernel, so it is reported apart
+    printf("Merged output differs from the fused output by up to %d levels inside, %d on the border.\n",
+           max_difference(fused, merged, 2), max_difference(fused, merged, 0));
+
+    free_kernel(gaussian, 3);
+    free_kernel(sharpen, 3);
+    pipeline_free(pipeline);
+    pipeline_free(merging);
+    bmp24_free(source);
+    bmp24_free(op_by_op);
+    bmp24_free(fused);
+    bmp24_free(tiled);
+    bmp24_free(merged);
+    return 0;
+}
@@ -0,0 +1,37 @@
+#ifndef BLEND_H
+#define BLEND_H
+
+#include <stdint.h>
+#include "bmp8.h"
+#include "bmp24.h"
+#include "color.h"
+
+// Overlay pixels mixed by one pass of the row kernel, bounding its scratch buffers
+#define BLEND_CHUNK 1024
+// Bytes the row kernel mixes together, a fixed block the compiler turns into SIMD code
+#define BLEND_LANES 32
+
+typedef enum {
+    BLEND_OVER,         // The overlay itself, covering the base by its alpha
+    BLEND_ADD,          // base + overlay, saturated
+    BLEND_MULTIPLY,     // base * overlay / 255: darkens
+    BLEND_SCREEN,       // 255 - (255 - base) * (255 - overlay) / 255: lightens
+    BLEND_DIFFERENCE    // |base - overlay|
+} t_blend_mode;
+
+// Mixes overlay into base with its top-left corner at (x, y) of base. Whatever falls outside of
+// base is clipped, so only the rows and columns the overlay covers are touched. The blend of
+// each channel is mixed with the base by alpha = opacity (0 to 255), times mask / 255 when a
+// mask of the overlay's size is given. All arithmetic is integer with exact rounding; rows are
+// blended in parallel by a kernel the compiler vectorizes.
+// Returns 0 on success, -1 on error.
+int bmp24_blend(t_bmp24 *base, const t_bmp24 *overlay, const t_bmp8 *mask, int x, int y, t_blend_mode mode,
+                int opacity);
+// Same on an uncompressed 24-bit BMP file in place, reading and writing back only the rows the
+// overlay covers, so a small overlay on a huge file costs little I/O
+int bmp24_blendFile(const char *filename, const t_bmp24 *overlay, const t_bmp8 *mask, int x, int y,
+                    t_blend_mode mode, int opacity);
+// Parses over, add, multiply, screen or difference. Returns 0 on success, -1 if unknown.
+int blend_parseMode(const char *name, t_blend_mode *mode);
+
+#endif // BLEND_H
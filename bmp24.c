@@ -1,4 +1,6 @@
 #include "bmp24.h"
+#include "color.h"
+#include "qoi.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -70,6 +72,8 @@ t_bmp24 *bmp24_allocate(int width, int signed_height, int colorDepth) {
     img->width = width;
     img->height = actual_height;
     img->colorDepth = colorDepth;
+    img->view = 0;
+    img->dirty = NULL;
 
     memset(&img->header, 0, sizeof(t_bmp_header));
     memset(&img->header_info, 0, sizeof(t_bmp_info));
@@ -99,7 +103,9 @@ t_bmp24 *bmp24_allocate(int width, int signed_height, int colorDepth) {
 
 void bmp24_free(t_bmp24 *img) {
     if (!img) return;
-    if (img->data) {
+    if (img->view) {
+        free(img->data);   // Only the row pointers are ours
+    } else if (img->data) {
         bmp24_freeDataPixels(img->data, img->height);
     }
     free(img);
@@ -207,6 +213,10 @@ t_bmp24 *bmp24_loadImage(const char *filename) {
     if (fread(&bmpHeader, sizeof(t_bmp_header), 1, file) != 1) {
         fprintf(stderr, "Error reading BMP file header.\n"); fclose(file); return NULL;
     }
+    if (memcmp(&bmpHeader, "qoif", 4) == 0) {
+        fclose(file);
+        return qoi_loadImage(filename);
+    }
     if (fread(&bmpInfoHeader, sizeof(t_bmp_info), 1, file) != 1) {
         fprintf(stderr, "Error reading BMP info header.\n"); fclose(file); return NULL;
     }
@@ -255,6 +265,11 @@ void bmp24_saveImage(t_bmp24 *img, const char *filename) {
         return;
     }
 
+    if (qoi_isFilename(filename)) {
+        qoi_saveImage(img, filename);
+        return;
+    }
+
     FILE *file = fopen(filename, "wb");
     if (!file) {
         printf("Error: Cannot open file for writing");
@@ -294,10 +309,132 @@ void bmp24_saveImage(t_bmp24 *img, const char *filename) {
     fclose(file);
 }
 
+// Decodes data, pointing the rows into it when view is set
+static t_bmp24 *decode_memory(uint8_t *data, size_t size, int view) {
+    t_bmp_header header;
+    t_bmp_info info;
+    // QOI files are always decoded into an image of their own
+    if (data && size >= 4 && memcmp(data, "qoif", 4) == 0) return qoi_decodeMemory(data, size);
+    if (!data || size < sizeof(header) + sizeof(info)) {
+        fprintf(stderr, "Error reading BMP file header.\n");
+        return NULL;
+    }
+    memcpy(&header, data, sizeof(header));
+    memcpy(&info, data + sizeof(header), sizeof(info));
+    if (header.type != BMP_TYPE) {
+        fprintf(stderr, "Error: Not a BMP file. Signature is %04X.\n", header.type);
+        return NULL;
+    }
+    if (info.bits != 24 || info.compression != 0) {
+        fprintf(stderr, "Error: Not an uncompressed 24-bit BMP file (bits %d, compression %u).\n", info.bits,
+                info.compression);
+        return NULL;
+    }
+    int width = info.width;
+    int height = info.height < 0 ? -info.height : info.height;
+    size_t pitch = ((size_t)width * 3 + 3) & ~(size_t)3;
+    if (width <= 0 || height <= 0 || header.offset < sizeof(header) + sizeof(info) || header.offset > size ||
+        (size - header.offset) / pitch < (size_t)height) {
+        fprintf(stderr, "Error: Truncated or inconsistent BMP data.\n");
+        return NULL;
+    }
+
+    uint8_t *pixels = data + header.offset;
+    t_bmp24 *img;
+    if (view) {
+        img = (t_bmp24 *)malloc(sizeof(t_bmp24));
+        t_pixel **rows = (t_pixel **)malloc(height * sizeof(t_pixel *));
+        if (!img || !rows) {
+            fprintf(stderr, "Error: Failed to allocate memory for t_bmp24 structure.\n");
+            free(img);
+            free(rows);
+            return NULL;
+        }
+        img->data = rows;
+        img->width = width;
+        img->height = height;
+        img->colorDepth = 24;
+        img->view = 1;
+        img->dirty = NULL;
+    } else {
+        img = bmp24_allocate(width, info.height, 24);
+        if (!img) return NULL;
+    }
+    img->header = header;
+    img->header_info = info;
+    for (int y = 0; y < height; y++) {
+        uint8_t *row = pixels + (size_t)(info.height > 0 ? height - 1 - y : y) * pitch;
+        if (view) img->data[y] = (t_pixel *)row;
+        else memcpy(img->data[y], row, (size_t)width * sizeof(t_pixel));
+    }
+    return img;
+}
+
+t_bmp24 *bmp24_decodeMemory(const void *data, size_t size) {
+    return decode_memory((uint8_t *)data, size, 0);
+}
+
+t_bmp24 *bmp24_viewMemory(void *data, size_t size) {
+    return decode_memory((uint8_t *)data, size, 1);
+}
+
+size_t bmp24_encodedSize(const t_bmp24 *img) {
+    size_t pitch = ((size_t)img->width * 3 + 3) & ~(size_t)3;
+    return sizeof(t_bmp_header) + sizeof(t_bmp_info) + pitch * img->height;
+}
+
+int bmp24_encodeMemory(const t_bmp24 *img, t_byte_buffer *out) {
+    if (!img || !img->data || !out) {
+        fprintf(stderr, "Error: Cannot encode NULL image.\n");
+        return -1;
+    }
+    size_t pitch = ((size_t)img->width * 3 + 3) & ~(size_t)3;
+    uint8_t *dst = buffer_append(out, bmp24_encodedSize(img));
+    if (!dst) {
+        fprintf(stderr, "Error: Output buffer too small for a %dx%d image.\n", img->width, img->height);
+        return -1;
+    }
+
+    // The headers bmp24_saveImage writes
+    t_bmp_header header = img->header;
+    t_bmp_info info = img->header_info;
+    header.type = BMP_TYPE;
+    header.offset = sizeof(t_bmp_header) + sizeof(t_bmp_info);
+    info.size = sizeof(t_bmp_info);
+    info.width = img->width;
+    info.height = img->height;
+    info.planes = 1;
+    info.bits = 24;
+    info.compression = 0;
+    info.imagesize = (uint32_t)(pitch * img->height);
+    header.size = header.offset + info.imagesize;
+    info.xresolution = 0;
+    info.yresolution = 0;
+    info.ncolors = 0;
+    info.importantcolors = 0;
+    memcpy(dst, &header, sizeof(header));
+    memcpy(dst + sizeof(header), &info, sizeof(info));
+    dst += header.offset;
+
+    size_t row_bytes = (size_t)img->width * sizeof(t_pixel);
+    for (int y = img->height - 1; y >= 0; y--) {
+        memcpy(dst, img->data[y], row_bytes);
+        memset(dst + row_bytes, 0, pitch - row_bytes);
+        dst += pitch;
+    }
+    return 0;
+}
+
 void bmp24_negative(t_bmp24 *img) {
-    if (!img || !img->data) return;
-    for (int y = 0; y < img->height; y++) {
-        for (int x = 0; x < img->width; x++) {
+    bmp24_negativeRegion(img, NULL);
+}
+
+void bmp24_negativeRegion(t_bmp24 *img, const t_rect *roi) {
+    t_rect r;
+    if (!img || !img->data || !rect_clip(roi, img->width, img->height, &r)) return;
+    dirty_add(img->dirty, &r);
+    for (int y = r.y; y < r.y + r.height; y++) {
+        for (int x = r.x; x < r.x + r.width; x++) {
             img->data[y][x].red = 255 - img->data[y][x].red;
             img->data[y][x].green = 255 - img->data[y][x].green;
             img->data[y][x].blue = 255 - img->data[y][x].blue;
@@ -306,24 +443,40 @@ void bmp24_negative(t_bmp24 *img) {
 }
 
 void bmp24_grayscale(t_bmp24 *img) {
-    if (!img || !img->data) return;
-    for (int y = 0; y < img->height; y++) {
-        for (int x = 0; x < img->width; x++) {
-            uint8_t r = img->data[y][x].red;
-            uint8_t g = img->data[y][x].green;
-            uint8_t b = img->data[y][x].blue;
-            uint8_t gray = (uint8_t)roundf(((float)r + (float)g + (float)b) / 3.0f);
-            img->data[y][x].red = gray;
-            img->data[y][x].green = gray;
-            img->data[y][x].blue = gray;
+    bmp24_grayscaleRegion(img, NULL);
+}
+
+void bmp24_grayscaleRegion(t_bmp24 *img, const t_rect *roi) {
+    t_rect r;
+    if (!img || !img->data || !rect_clip(roi, img->width, img->height, &r)) return;
+    dirty_add(img->dirty, &r);
+    uint8_t *gray = (uint8_t *)malloc(r.width);
+    if (!gray) {
+        fprintf(stderr, "Error: Failed to allocate memory for grayscale.\n");
+        return;
+    }
+    for (int y = r.y; y < r.y + r.height; y++) {
+        t_pixel *row = img->data[y] + r.x;
+        color_lumaRow((const uint8_t *)row, gray, r.width, LUMA_MEAN);
+        for (int x = 0; x < r.width; x++) {
+            row[x].red = gray[x];
+            row[x].green = gray[x];
+            row[x].blue = gray[x];
         }
     }
+    free(gray);
 }
 
 void bmp24_brightness(t_bmp24 *img, int value) {
-    if (!img || !img->data) return;
-    for (int y = 0; y < img->height; y++) {
-        for (int x = 0; x < img->width; x++) {
+    bmp24_brightnessRegion(img, value, NULL);
+}
+
+void bmp24_brightnessRegion(t_bmp24 *img, int value, const t_rect *roi) {
+    t_rect rect;
+    if (!img || !img->data || !rect_clip(roi, img->width, img->height, &rect)) return;
+    dirty_add(img->dirty, &rect);
+    for (int y = rect.y; y < rect.y + rect.height; y++) {
+        for (int x = rect.x; x < rect.x + rect.width; x++) {
             int r = img->data[y][x].red + value;
             int g = img->data[y][x].green + value;
             int b = img->data[y][x].blue + value;
@@ -372,43 +525,77 @@ t_pixel bmp24_convolution(t_bmp24 *img, int cx, int cy, float **kernel, int kern
     return new_pixel;
 }
 
-typedef struct { float y, u, v; } t_yuv_pixel;
+void bmp24_applyFilter(t_bmp24 *img, float **kernel, int kernelSize) {
+    bmp24_applyFilterRegion(img, kernel, kernelSize, NULL);
+}
 
-void bmp24_equalize(t_bmp24 *img) {
-    if (!img || !img->data) return;
+void bmp24_applyFilterRegion(t_bmp24 *img, float **kernel, int kernelSize, const t_rect *roi) {
+    if (!img || !img->data || !kernel || kernelSize % 2 == 0 || kernelSize < 1) {
+        fprintf(stderr, "Error: Invalid parameters for bmp24_applyFilter.\n");
+        return;
+    }
 
-    int width = img->width;
-    int height = img->height;
+    int n = kernelSize / 2;
+    // Only centres whose whole neighbourhood lies inside the image are filtered
+    t_rect interior = {n, n, img->width - 2 * n, img->height - 2 * n};
+    t_rect r;
+    if (!rect_clip(roi, img->width, img->height, &r) || !rect_intersect(&r, &interior, &r)) return;
+    dirty_add(img->dirty, &r);
+
+    // Snapshot of the region rows and the halo rows around them; other rows are never read
+    t_rect halo = rect_expand(r, n);
+    t_pixel **rows = (t_pixel **)malloc(img->height * sizeof(t_pixel *));
+    t_pixel **copies = bmp24_allocateDataPixels(img->width, halo.height);
+    if (!rows || !copies) {
+        fprintf(stderr, "Error: Failed to allocate memory for temporary data in applyFilter.\n");
+        free(rows);
+        bmp24_freeDataPixels(copies, halo.height);
+        return;
+    }
+    for (int y = 0; y < img->height; y++) rows[y] = img->data[y];
+    for (int y = 0; y < halo.height; y++) {
+        memcpy(copies[y], img->data[halo.y + y], img->width * sizeof(t_pixel));
+        rows[halo.y + y] = copies[y];
+    }
+    t_bmp24 original = *img;
+    original.data = rows;
 
-    t_yuv_pixel **yuv_data = (t_yuv_pixel **)malloc(height * sizeof(t_yuv_pixel *));
-    if (!yuv_data) { fprintf(stderr, "Error: Failed to allocate YUV data rows.\n"); return; }
-    for (int i = 0; i < height; i++) {
-        yuv_data[i] = (t_yuv_pixel *)malloc(width * sizeof(t_yuv_pixel));
-        if (!yuv_data[i]) {
-            fprintf(stderr, "Error: Failed to allocate YUV data row %d.\n", i);
-            for (int k = 0; k < i; k++) free(yuv_data[k]);
-            free(yuv_data);
-            return;
+    for (int y = r.y; y < r.y + r.height; y++) {
+        for (int x = r.x; x < r.x + r.width; x++) {
+            img->data[y][x] = bmp24_convolution(&original, x, y, kernel, kernelSize);
         }
     }
 
+    bmp24_freeDataPixels(copies, halo.height);
+    free(rows);
+}
+
+// Equalizes Y and keeps each channel's offset from it, so hues are preserved. Y is only rounded
+// to pick its histogram bin; the offsets stay in 16-bit fixed point, so the result agrees with
+// the floating-point Y + chroma round trip except where that one rounds a tie the other way.
+// Without a histogram, the luma of every pixel of the region is counted.
+static void equalize_luma(t_bmp24 *img, const t_rect *roi, const unsigned int *histogram) {
+    t_rect region;
+    if (!img || !img->data || !rect_clip(roi, img->width, img->height, &region)) return;
+    dirty_add(img->dirty, &region);
+
+    int width = region.width;
+    int height = region.height;
+    t_pixel **pixels = img->data + region.y;
+    int x0 = region.x;
+    size_t plane_size = (size_t)width * height;
+
+    uint8_t *luma = (uint8_t *)malloc(plane_size);
+    if (!luma) { fprintf(stderr, "Error: Failed to allocate the luma plane.\n"); return; }
+
+    #pragma omp parallel for schedule(static)
     for (int r_idx = 0; r_idx < height; r_idx++) {
-        for (int c_idx = 0; c_idx < width; c_idx++) {
-            float R = (float)img->data[r_idx][c_idx].red;
-            float G = (float)img->data[r_idx][c_idx].green;
-            float B = (float)img->data[r_idx][c_idx].blue;
-            yuv_data[r_idx][c_idx].y = 0.299f * R + 0.587f * G + 0.114f * B;
-            yuv_data[r_idx][c_idx].u = -0.14713f * R - 0.28886f * G + 0.436f * B;
-            yuv_data[r_idx][c_idx].v = 0.615f * R - 0.51499f * G - 0.10001f * B;
-        }
+        color_fineLumaRow((const uint8_t *)(pixels[r_idx] + x0), luma + (size_t)r_idx * width, width);
     }
 
     unsigned int y_histogram[256] = {0};
-    for (int r_idx = 0; r_idx < height; r_idx++) {
-        for (int c_idx = 0; c_idx < width; c_idx++) {
-            y_histogram[float_to_uint8_clamp(yuv_data[r_idx][c_idx].y)]++;
-        }
-    }
+    if (histogram) memcpy(y_histogram, histogram, sizeof(y_histogram));
+    else for (size_t i = 0; i < plane_size; i++) y_histogram[luma[i]]++;
 
     unsigned int y_cdf[256] = {0};
     y_cdf[0] = y_histogram[0];
@@ -421,33 +608,188 @@ void bmp24_equalize(t_bmp24 *img) {
         if (y_cdf[i] > 0) { cdf_min = y_cdf[i]; break; }
     }
 
+    // A sampled histogram may miss levels the image holds, which map like their neighbours
     uint8_t y_equalized_map[256];
-    unsigned long total_pixels = (unsigned long)width * height;
+    unsigned long total_pixels = y_cdf[255];
     float N_minus_cdf_min = (float)(total_pixels - cdf_min);
     if (N_minus_cdf_min < 1.0f) N_minus_cdf_min = 1.0f; // Avoid division by zero or issues if N=cdf_min
 
     for (int i = 0; i < 256; i++) {
-        float mapped_val = roundf(((float)(y_cdf[i] - cdf_min) / N_minus_cdf_min) * 255.0f);
+        unsigned int below = y_cdf[i] > cdf_min ? y_cdf[i] - cdf_min : 0;
+        float mapped_val = roundf(((float)below / N_minus_cdf_min) * 255.0f);
         y_equalized_map[i] = float_to_uint8_clamp(mapped_val);
     }
 
+    #pragma omp parallel for schedule(static)
     for (int r_idx = 0; r_idx < height; r_idx++) {
-        for (int c_idx = 0; c_idx < width; c_idx++) {
-            yuv_data[r_idx][c_idx].y = (float)y_equalized_map[float_to_uint8_clamp(yuv_data[r_idx][c_idx].y)];
+        color_shiftLumaRow((uint8_t *)(pixels[r_idx] + x0), luma + (size_t)r_idx * width, y_equalized_map, width);
+    }
+
+    free(luma);
+}
+
+void bmp24_equalize(t_bmp24 *img) {
+    equalize_luma(img, NULL, NULL);
+}
+
+void bmp24_equalizeHistogram(t_bmp24 *img, const unsigned int *histogram) {
+    if (histogram) equalize_luma(img, NULL, histogram);
+}
+
+void bmp24_equalizeRegion(t_bmp24 *img, const t_rect *roi) {
+    equalize_luma(img, roi, NULL);
+}
+
+t_bmp8 *bmp24_toGray8(const t_bmp24 *img, t_luma_mode mode) {
+    if (!img || !img->data) {
+        fprintf(stderr, "Error: Cannot convert NULL image.\n");
+        return NULL;
+    }
+    t_bmp8 *gray = bmp8_allocate((unsigned int)img->width, (unsigned int)img->height);
+    if (!gray) return NULL;
+
+    // t_bmp8 rows are bottom-up
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < img->height; y++) {
+        color_lumaRow((const uint8_t *)img->data[y],
+                      gray->data + (size_t)(img->height - 1 - y) * img->width, img->width, mode);
+    }
+    return gray;
+}
+
+int bmp24_convertFileToGray8(const char *input, const char *output, t_luma_mode mode) {
+    FILE *in = fopen(input, "rb");
+    if (!in) {
+        fprintf(stderr, "Error: Cannot open %s for reading.\n", input);
+        return -1;
+    }
+    t_bmp_header header;
+    t_bmp_info info;
+    if (fread(&header, sizeof(header), 1, in) != 1 || fread(&info, sizeof(info), 1, in) != 1) {
+        fprintf(stderr, "Error reading BMP headers.\n");
+        fclose(in);
+        return -1;
+    }
+    if (header.type != BMP_TYPE || info.bits != 24 || info.compression != 0 || info.width <= 0 || info.height == 0) {
+        fprintf(stderr, "Error: Not an uncompressed 24-bit BMP file.\n");
+        fclose(in);
+        return -1;
+    }
+    FILE *out = fopen(output, "wb");
+    if (!out) {
+        fprintf(stderr, "Error: Cannot open %s for writing.\n", output);
+        fclose(in);
+        return -1;
+    }
+
+    int width = info.width;
+    int height = abs(info.height);
+    uint32_t in_pitch = ((uint32_t)width * 3u + 3u) & ~3u;
+    uint32_t out_pitch = ((uint32_t)width + 3u) & ~3u;
+
+    t_bmp_header out_header;
+    t_bmp_info out_info;
+    memset(&out_header, 0, sizeof(out_header));
+    memset(&out_info, 0, sizeof(out_info));
+    out_header.type = BMP_TYPE;
+    out_header.offset = HEADER_SIZE + INFO_SIZE + 1024;
+    out_header.size = out_header.offset + out_pitch * (uint32_t)height;
+    out_info.size = INFO_SIZE;
+    out_info.width = width;
+    out_info.height = height;
+    out_info.planes = 1;
+    out_info.bits = 8;
+    out_info.imagesize = out_pitch * (uint32_t)height;
+    out_info.ncolors = 256;
+    uint8_t palette[1024];
+    for (int i = 0; i < 256; i++) {
+        palette[i * 4] = palette[i * 4 + 1] = palette[i * 4 + 2] = (uint8_t)i;
+        palette[i * 4 + 3] = 0;
+    }
+
+    uint8_t *in_rows = (uint8_t *)malloc((size_t)in_pitch * GRAY8_STREAM_ROWS);
+    uint8_t *out_rows = (uint8_t *)calloc((size_t)out_pitch * GRAY8_STREAM_ROWS, 1);
+    int ok = in_rows && out_rows &&
+             fwrite(&out_header, sizeof(out_header), 1, out) == 1 &&
+             fwrite(&out_info, sizeof(out_info), 1, out) == 1 &&
+             fwrite(palette, 1, sizeof(palette), out) == sizeof(palette) &&
+             fseek(in, header.offset, SEEK_SET) == 0;
+
+    // The output is written bottom-up; a bottom-up source is read straight through, a top-down
+    // one (negative height) is read backwards one batch at a time
+    for (int done = 0; ok && done < height; done += GRAY8_STREAM_ROWS) {
+        int count = (height - done < GRAY8_STREAM_ROWS) ? height - done : GRAY8_STREAM_ROWS;
+        if (info.height < 0) {
+            long first = (long)header.offset + (long)(height - done - count) * in_pitch;
+            ok = fseek(in, first, SEEK_SET) == 0;
+        }
+        ok = ok && fread(in_rows, in_pitch, count, in) == (size_t)count;
+        if (!ok) break;
+
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < count; i++) {
+            int src = (info.height < 0) ? count - 1 - i : i;
+            color_lumaRow(in_rows + (size_t)src * in_pitch, out_rows + (size_t)i * out_pitch, width, mode);
         }
+        ok = fwrite(out_rows, out_pitch, count, out) == (size_t)count;
     }
+    if (!ok) fprintf(stderr, "Error: Failed to convert %s to 8-bit grayscale.\n", input);
 
-    for (int r_idx = 0; r_idx < height; r_idx++) {
-        for (int c_idx = 0; c_idx < width; c_idx++) {
-            float Y_eq = yuv_data[r_idx][c_idx].y;
-            float U = yuv_data[r_idx][c_idx].u;
-            float V = yuv_data[r_idx][c_idx].v;
-            img->data[r_idx][c_idx].red = float_to_uint8_clamp(Y_eq + 1.13983f * V);
-            img->data[r_idx][c_idx].green = float_to_uint8_clamp(Y_eq - 0.39465f * U - 0.58060f * V);
-            img->data[r_idx][c_idx].blue = float_to_uint8_clamp(Y_eq + 2.03211f * U);
+    free(in_rows);
+    free(out_rows);
+    fclose(in);
+    if (fclose(out) != 0) ok = 0;
+    return ok ? 0 : -1;
+}
+
+t_bmp24 *bmp24_loadRegion(const char *filename, const t_rect *roi) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        printf("Error: Cannot open file for reading");
+        return NULL;
+    }
+
+    t_bmp_header bmpHeader;
+    t_bmp_info bmpInfoHeader;
+    if (fread(&bmpHeader, sizeof(t_bmp_header), 1, file) != 1 ||
+        fread(&bmpInfoHeader, sizeof(t_bmp_info), 1, file) != 1) {
+        fprintf(stderr, "Error reading BMP headers.\n"); fclose(file); return NULL;
+    }
+    if (bmpHeader.type != BMP_TYPE || bmpInfoHeader.bits != 24 || bmpInfoHeader.compression != 0) {
+        fprintf(stderr, "Error: Not an uncompressed 24-bit BMP file.\n");
+        fclose(file);
+        return NULL;
+    }
+
+    int width = bmpInfoHeader.width;
+    int height = abs(bmpInfoHeader.height);
+    t_rect r;
+    if (!rect_clip(roi, width, height, &r)) {
+        fprintf(stderr, "Error: Region lies outside of the %d x %d image.\n", width, height);
+        fclose(file);
+        return NULL;
+    }
+
+    t_bmp24 *img = bmp24_allocate(r.width, r.height, DEFAULT_DEPTH);
+    if (!img) {
+        fclose(file);
+        return NULL;
+    }
+
+    // Seek straight to the covered part of each row; a positive height means bottom-up rows
+    uint32_t row_pitch = ((uint32_t)width * 3u + 3u) & ~3u;
+    for (int y = 0; y < r.height; y++) {
+        int file_row = (bmpInfoHeader.height > 0) ? height - 1 - (r.y + y) : r.y + y;
+        long position = (long)bmpHeader.offset + (long)file_row * row_pitch + (long)r.x * 3;
+        if (fseek(file, position, SEEK_SET) != 0 ||
+            fread(img->data[y], sizeof(t_pixel), r.width, file) != (size_t)r.width) {
+            fprintf(stderr, "Error: Failed to read region row %d.\n", r.y + y);
+            bmp24_free(img);
+            fclose(file);
+            return NULL;
         }
     }
 
-    for (int i = 0; i < height; i++) free(yuv_data[i]);
-    free(yuv_data);
-}
\ No newline at end of file
+    fclose(file);
+    return img;
+}
@@ -4,6 +4,8 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stddef.h>
+#include "rect.h"
+#include "bmp8.h"
 
 #define BITMAP_MAGIC        0x00
 #define BITMAP_SIZE         0x02
@@ -20,12 +22,22 @@
 
 #define DEFAULT_DEPTH       0x18
 
+// Rows converted per batch when streaming a 24-bit file into an 8-bit one
+#define GRAY8_STREAM_ROWS   64
+
 typedef struct {
     uint8_t blue;
     uint8_t green;
     uint8_t red;
 } t_pixel;
 
+// Luma weights for conversion to 8-bit grayscale, in 8-bit fixed point
+typedef enum {
+    LUMA_MEAN,      // (R + G + B) / 3, rounded, as bmp24_grayscale
+    LUMA_BT601,     // 0.299 R + 0.587 G + 0.114 B
+    LUMA_BT709      // 0.2126 R + 0.7152 G + 0.0722 B
+} t_luma_mode;
+
 #pragma pack(push, 1)
 
 typedef struct {
@@ -59,6 +71,8 @@ typedef struct {
     int height;
     int colorDepth;
     t_pixel **data;
+    int view;   // Rows point into a caller's buffer (bmp24_viewMemory) and are not freed
+    t_dirty_region *dirty;   // When set, the ops below add every rectangle they change; NULL after loading
 } t_bmp24;
 
 t_pixel **bmp24_allocateDataPixels(int width, int height);
@@ -66,9 +80,23 @@ void bmp24_freeDataPixels(t_pixel **pixels, int height);
 t_bmp24 *bmp24_allocate(int width, int signed_height, int colorDepth);
 void bmp24_free(t_bmp24 *img);
 
+// bmp24_loadImage also reads QOI files, recognised by their magic bytes, and bmp24_saveImage
+// writes QOI when the file name ends in .qoi
 t_bmp24 *bmp24_loadImage(const char *filename);
+t_bmp24 *bmp24_loadRegion(const char *filename, const t_rect *roi);
 void bmp24_saveImage(t_bmp24 *img, const char *filename);
 
+// In-memory files. bmp24_decodeMemory copies the pixels out of data; bmp24_viewMemory only
+// allocates the row pointers, which point at the rows inside data whatever their order and
+// padding, so edits go straight to the buffer, which must outlive the image. QOI data is
+// decoded into an image of its own by both. Both return NULL if data does not hold a complete
+// uncompressed 24-bit BMP or QOI file.
+t_bmp24 *bmp24_decodeMemory(const void *data, size_t size);
+t_bmp24 *bmp24_viewMemory(void *data, size_t size);
+// Appends the file bmp24_saveImage would write. Returns 0 on success, -1 on error.
+int bmp24_encodeMemory(const t_bmp24 *img, t_byte_buffer *out);
+size_t bmp24_encodedSize(const t_bmp24 *img);
+
 void file_rawRead(uint32_t position, void *buffer, uint32_t size, size_t n, FILE *file);
 void file_rawWrite(uint32_t position, void *buffer, uint32_t size, size_t n, FILE *file);
 
@@ -83,7 +111,26 @@ void bmp24_grayscale(t_bmp24 *img);
 void bmp24_brightness(t_bmp24 *img, int value);
 
 t_pixel bmp24_convolution(t_bmp24 *img, int cx, int cy, float **kernel, int kernelSize);
+void bmp24_applyFilter(t_bmp24 *img, float **kernel, int kernelSize);
 
+// Equalizes the BT.601 luma and moves each channel by the change of its pixel's luma
 void bmp24_equalize(t_bmp24 *img);
+// Same with a luma histogram gathered beforehand, e.g. by bmp24_sampleLumaHistogram
+void bmp24_equalizeHistogram(t_bmp24 *img, const unsigned int *histogram);
+
+// Builds a real 8-bit image (grayscale palette) instead of three equal channels
+t_bmp8 *bmp24_toGray8(const t_bmp24 *img, t_luma_mode mode);
+// Same conversion from file to file, holding only GRAY8_STREAM_ROWS colour rows at a time.
+// Returns 0 on success, -1 on error.
+int bmp24_convertFileToGray8(const char *input, const char *output, t_luma_mode mode);
+
+// Region variants: roi uses top-left origin coordinates, NULL means the whole image.
+// The whole-image calls above go through them, and all add what they write to img->dirty.
+// Convolution reads its halo from outside of the region but only writes inside it.
+void bmp24_negativeRegion(t_bmp24 *img, const t_rect *roi);
+void bmp24_grayscaleRegion(t_bmp24 *img, const t_rect *roi);
+void bmp24_brightnessRegion(t_bmp24 *img, int value, const t_rect *roi);
+void bmp24_applyFilterRegion(t_bmp24 *img, float **kernel, int kernelSize, const t_rect *roi);
+void bmp24_equalizeRegion(t_bmp24 *img, const t_rect *roi);
 
 #endif // BMP24_H
\ No newline at end of file
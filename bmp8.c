@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <string.h> // For memcpy, calloc
 #include <math.h>   // For round
+#include "qoi.h"
 
 // Helper function to extract unsigned int from header
 static unsigned int read_uint_le(const unsigned char *buffer, int offset) {
@@ -14,6 +15,79 @@ static unsigned short read_ushort_le(const unsigned char *buffer, int offset) {
     return buffer[offset] | (buffer[offset + 1] << 8);
 }
 
+// Helper function to store unsigned int into header
+static void write_uint_le(unsigned char *buffer, int offset, unsigned int value) {
+    buffer[offset] = value & 0xFF;
+    buffer[offset + 1] = (value >> 8) & 0xFF;
+    buffer[offset + 2] = (value >> 16) & 0xFF;
+    buffer[offset + 3] = (value >> 24) & 0xFF;
+}
+
+// Rows are stored unpadded in memory, but padded to 4 bytes on disk
+static unsigned int bmp8_rowPitch(unsigned int width) {
+    return (width + 3u) & ~3u;
+}
+
+t_bmp8 *bmp8_allocate(unsigned int width, unsigned int height) {
+    if (width == 0 || height == 0) {
+        fprintf(stderr, "Error: Invalid dimensions for bmp8 allocation (%u x %u).\n", width, height);
+        return NULL;
+    }
+    t_bmp8 *img = (t_bmp8 *)malloc(sizeof(t_bmp8));
+    if (!img) {
+        fprintf(stderr, "Error: Failed to allocate memory for t_bmp8 structure.\n");
+        return NULL;
+    }
+    img->data = (unsigned char *)calloc((size_t)width * height, 1);
+    if (!img->data) {
+        fprintf(stderr, "Error: Failed to allocate memory for pixel data.\n");
+        free(img);
+        return NULL;
+    }
+
+    unsigned int imageSize = bmp8_rowPitch(width) * height;
+    memset(img->header, 0, sizeof(img->header));
+    img->header[0] = 'B';
+    img->header[1] = 'M';
+    write_uint_le(img->header, 2, 54 + 1024 + imageSize);
+    write_uint_le(img->header, 10, 54 + 1024);
+    write_uint_le(img->header, 14, 40);
+    write_uint_le(img->header, 18, width);
+    write_uint_le(img->header, 22, height);
+    img->header[26] = 1;  // planes
+    img->header[28] = 8;  // bits per pixel
+    write_uint_le(img->header, 34, imageSize);
+    write_uint_le(img->header, 46, 256);
+
+    // Grayscale palette
+    for (int i = 0; i < 256; i++) {
+        img->colorTable[i * 4] = (unsigned char)i;
+        img->colorTable[i * 4 + 1] = (unsigned char)i;
+        img->colorTable[i * 4 + 2] = (unsigned char)i;
+        img->colorTable[i * 4 + 3] = 0;
+    }
+
+    img->width = width;
+    img->height = height;
+    img->colorDepth = 8;
+    img->dataSize = width * height;
+    img->view = 0;
+    img->dirty = NULL;
+    return img;
+}
+
+int bmp8_readPixelData(t_bmp8 *img, FILE *file) {
+    unsigned int pitch = bmp8_rowPitch(img->width);
+    for (unsigned int y = 0; y < img->height; y++) {
+        if (fread(img->data + y * img->width, sizeof(unsigned char), img->width, file) != img->width ||
+            (pitch != img->width && fseek(file, pitch - img->width, SEEK_CUR) != 0)) {
+            fprintf(stderr, "Error: Failed to read pixel data (read %ld, expected %u).\n", ftell(file), pitch * img->height);
+            return -1;
+        }
+    }
+    return 0;
+}
+
 t_bmp8 *bmp8_loadImage(const char *filename) {
     FILE *file = fopen(filename, "rb");
     if (!file) {
@@ -27,6 +101,8 @@ t_bmp8 *bmp8_loadImage(const char *filename) {
         fclose(file);
         return NULL;
     }
+    img->view = 0;
+    img->dirty = NULL;
 
     if (fread(img->header, sizeof(unsigned char), 54, file) != 54) {
         fprintf(stderr, "Error: Failed to read BMP header.\n");
@@ -46,7 +122,6 @@ t_bmp8 *bmp8_loadImage(const char *filename) {
     img->width = read_uint_le(img->header, 18);
     img->height = read_uint_le(img->header, 22);
     img->colorDepth = read_ushort_le(img->header, 28);
-    img->dataSize = read_uint_le(img->header, 34);
 
     if (img->colorDepth != 8) {
         fprintf(stderr, "Error: Image is not 8-bit (colorDepth = %u).\n", img->colorDepth);
@@ -55,10 +130,8 @@ t_bmp8 *bmp8_loadImage(const char *filename) {
         return NULL;
     }
 
-    if (img->dataSize == 0) {
-        img->dataSize = img->width * img->height;
-    }
-
+    // Padding is stripped on load, so dataSize is always width * height in memory
+    img->dataSize = img->width * img->height;
 
     // Read color table (256 entries * 4 bytes/entry = 1024 bytes for 8-bit BMP)
     if (fread(img->colorTable, sizeof(unsigned char), 1024, file) != 1024) {
@@ -76,8 +149,7 @@ t_bmp8 *bmp8_loadImage(const char *filename) {
         return NULL;
     }
 
-    if (fread(img->data, sizeof(unsigned char), img->dataSize, file) != img->dataSize) {
-        fprintf(stderr, "Error: Failed to read pixel data (read %ld, expected %u).\n", ftell(file), img->dataSize);
+    if (bmp8_readPixelData(img, file) != 0) {
         free(img->data);
         free(img);
         fclose(file);
@@ -94,6 +166,11 @@ void bmp8_saveImage(const char *filename, t_bmp8 *img) {
         return;
     }
 
+    if (qoi_isFilename(filename)) {
+        qoi_saveBmp8(img, filename);
+        return;
+    }
+
     FILE *file = fopen(filename, "wb");
     if (!file) {
         printf("Error opening file for writing");
@@ -112,10 +189,15 @@ void bmp8_saveImage(const char *filename, t_bmp8 *img) {
         return;
     }
 
-    if (fwrite(img->data, sizeof(unsigned char), img->dataSize, file) != img->dataSize) {
-        fprintf(stderr, "Error: Failed to write pixel data.\n");
-        fclose(file);
-        return;
+    unsigned int pitch = bmp8_rowPitch(img->width);
+    const unsigned char padding[3] = {0, 0, 0};
+    for (unsigned int y = 0; y < img->height; y++) {
+        if (fwrite(img->data + y * img->width, sizeof(unsigned char), img->width, file) != img->width ||
+            fwrite(padding, sizeof(unsigned char), pitch - img->width, file) != pitch - img->width) {
+            fprintf(stderr, "Error: Failed to write pixel data.\n");
+            fclose(file);
+            return;
+        }
     }
 
     fclose(file);
@@ -123,13 +205,117 @@ void bmp8_saveImage(const char *filename, t_bmp8 *img) {
 
 void bmp8_free(t_bmp8 *img) {
     if (img) {
-        if (img->data) {
+        if (img->data && !img->view) {
             free(img->data);
         }
         free(img);
     }
 }
 
+// Decodes data, borrowing its pixels when view is set and the layout allows it
+static t_bmp8 *decode_memory(const unsigned char *data, size_t size, int view) {
+    if (!data || size < 54 || data[0] != 'B' || data[1] != 'M') {
+        fprintf(stderr, "Error: Not a BMP file (invalid signature).\n");
+        return NULL;
+    }
+    unsigned int depth = read_ushort_le(data, 28);
+    if (depth != 8 || read_uint_le(data, 30) != 0) {
+        fprintf(stderr, "Error: Image is not an uncompressed 8-bit BMP (colorDepth = %u).\n", depth);
+        return NULL;
+    }
+    unsigned int width = read_uint_le(data, 18);
+    int signed_height = (int)read_uint_le(data, 22);
+    unsigned int height = signed_height < 0 ? 0u - (unsigned int)signed_height : (unsigned int)signed_height;
+    size_t offset = read_uint_le(data, 10);
+    unsigned int pitch = bmp8_rowPitch(width);
+    if (width == 0 || height == 0 || width > 0x7FFFFFFFu / height || offset < 54 ||
+        offset > size || (size - offset) / pitch < height) {
+        fprintf(stderr, "Error: Truncated or inconsistent BMP data.\n");
+        return NULL;
+    }
+
+    t_bmp8 *img = (t_bmp8 *)malloc(sizeof(t_bmp8));
+    if (!img) {
+        fprintf(stderr, "Error: Failed to allocate memory for t_bmp8 structure.\n");
+        return NULL;
+    }
+    memcpy(img->header, data, 54);
+    // Palettes shorter than 256 entries end where the pixels start
+    size_t palette = offset - 54 < 1024 ? offset - 54 : 1024;
+    memset(img->colorTable, 0, sizeof(img->colorTable));
+    memcpy(img->colorTable, data + 54, palette);
+    if (offset != 54 + 1024 || signed_height < 0) {
+        // Saved with a full palette and bottom-up rows, as t_bmp8 stores them
+        write_uint_le(img->header, 2, 54 + 1024 + pitch * height);
+        write_uint_le(img->header, 10, 54 + 1024);
+        write_uint_le(img->header, 22, height);
+        write_uint_le(img->header, 34, pitch * height);
+    }
+    img->width = width;
+    img->height = height;
+    img->colorDepth = 8;
+    img->dataSize = width * height;
+
+    img->dirty = NULL;
+
+    const unsigned char *pixels = data + offset;
+    if (view && pitch == width && signed_height > 0) {
+        img->data = (unsigned char *)pixels;
+        img->view = 1;
+        return img;
+    }
+    img->view = 0;
+    img->data = (unsigned char *)malloc(img->dataSize);
+    if (!img->data) {
+        fprintf(stderr, "Error: Failed to allocate memory for pixel data.\n");
+        free(img);
+        return NULL;
+    }
+    for (unsigned int y = 0; y < height; y++) {
+        unsigned int file_row = signed_height > 0 ? y : height - 1 - y;
+        memcpy(img->data + (size_t)y * width, pixels + (size_t)file_row * pitch, width);
+    }
+    return img;
+}
+
+t_bmp8 *bmp8_decodeMemory(const void *data, size_t size) {
+    return decode_memory((const unsigned char *)data, size, 0);
+}
+
+t_bmp8 *bmp8_viewMemory(void *data, size_t size) {
+    return decode_memory((const unsigned char *)data, size, 1);
+}
+
+size_t bmp8_encodedSize(const t_bmp8 *img) {
+    return 54 + 1024 + (size_t)bmp8_rowPitch(img->width) * img->height;
+}
+
+int bmp8_encodeMemory(const t_bmp8 *img, t_byte_buffer *out) {
+    if (!img || !img->data || !out) {
+        fprintf(stderr, "Error: Cannot encode NULL image.\n");
+        return -1;
+    }
+    unsigned char *dst = buffer_append(out, bmp8_encodedSize(img));
+    if (!dst) {
+        fprintf(stderr, "Error: Output buffer too small for a %ux%u image.\n", img->width, img->height);
+        return -1;
+    }
+    memcpy(dst, img->header, 54);
+    memcpy(dst + 54, img->colorTable, 1024);
+    dst += 54 + 1024;
+    unsigned int pitch = bmp8_rowPitch(img->width);
+    if (pitch == img->width) {
+        memcpy(dst, img->data, img->dataSize);
+        return 0;
+    }
+    for (unsigned int y = 0; y < img->height; y++) {
+        memcpy(dst, img->data + (size_t)y * img->width, img->width);
+        memset(dst + img->width, 0, pitch - img->width);
+        dst += pitch;
+    }
+    return 0;
+}
+
 void bmp8_printInfo(t_bmp8 *img) {
     if (!img) {
         printf("Image Info: NULL image\n");
@@ -142,53 +328,97 @@ void bmp8_printInfo(t_bmp8 *img) {
     printf("  Data Size: %u\n", img->dataSize);
 }
 
+// Region rows are counted from the top, memory rows are stored bottom-up
+static unsigned char *bmp8_regionRow(const t_bmp8 *img, const t_rect *region, int row) {
+    return img->data + (size_t)(img->height - 1 - (unsigned int)(region->y + row)) * img->width + region->x;
+}
+
 void bmp8_negative(t_bmp8 *img) {
-    if (!img || !img->data) return;
-    for (unsigned int i = 0; i < img->dataSize; i++) {
-        img->data[i] = 255 - img->data[i];
+    bmp8_negativeRegion(img, NULL);
+}
+
+void bmp8_negativeRegion(t_bmp8 *img, const t_rect *roi) {
+    t_rect r;
+    if (!img || !img->data || !rect_clip(roi, img->width, img->height, &r)) return;
+    dirty_add(img->dirty, &r);
+    for (int y = 0; y < r.height; y++) {
+        unsigned char *row = bmp8_regionRow(img, &r, y);
+        for (int x = 0; x < r.width; x++) {
+            row[x] = 255 - row[x];
+        }
     }
 }
 
 void bmp8_brightness(t_bmp8 *img, int value) {
-    if (!img || !img->data) return;
-    for (unsigned int i = 0; i < img->dataSize; i++) {
-        int new_val = (int)img->data[i] + value;
-        if (new_val < 0) new_val = 0;
-        if (new_val > 255) new_val = 255;
-        img->data[i] = (unsigned char)new_val;
+    bmp8_brightnessRegion(img, value, NULL);
+}
+
+void bmp8_brightnessRegion(t_bmp8 *img, int value, const t_rect *roi) {
+    t_rect r;
+    if (!img || !img->data || !rect_clip(roi, img->width, img->height, &r)) return;
+    dirty_add(img->dirty, &r);
+    for (int y = 0; y < r.height; y++) {
+        unsigned char *row = bmp8_regionRow(img, &r, y);
+        for (int x = 0; x < r.width; x++) {
+            int new_val = (int)row[x] + value;
+            if (new_val < 0) new_val = 0;
+            if (new_val > 255) new_val = 255;
+            row[x] = (unsigned char)new_val;
+        }
     }
 }
 
 void bmp8_threshold(t_bmp8 *img, int threshold_val) {
-    if (!img || !img->data) return;
-    for (unsigned int i = 0; i < img->dataSize; i++) {
-        if (img->data[i] >= threshold_val) {
-            img->data[i] = 255;
-        } else {
-            img->data[i] = 0;
+    bmp8_thresholdRegion(img, threshold_val, NULL);
+}
+
+void bmp8_thresholdRegion(t_bmp8 *img, int threshold_val, const t_rect *roi) {
+    t_rect r;
+    if (!img || !img->data || !rect_clip(roi, img->width, img->height, &r)) return;
+    dirty_add(img->dirty, &r);
+    for (int y = 0; y < r.height; y++) {
+        unsigned char *row = bmp8_regionRow(img, &r, y);
+        for (int x = 0; x < r.width; x++) {
+            row[x] = (row[x] >= threshold_val) ? 255 : 0;
         }
     }
 }
 
 void bmp8_applyFilter(t_bmp8 *img, float **kernel, int kernelSize) {
+    bmp8_applyFilterRegion(img, kernel, kernelSize, NULL);
+}
+
+void bmp8_applyFilterRegion(t_bmp8 *img, float **kernel, int kernelSize, const t_rect *roi) {
     if (!img || !img->data || !kernel || kernelSize % 2 == 0 || kernelSize < 1) {
         fprintf(stderr, "Error: Invalid parameters for bmp8_applyFilter.\n");
         return;
     }
 
-    unsigned char *original_data = (unsigned char *)malloc(img->dataSize);
+    int n = kernelSize / 2;
+    unsigned int width = img->width;
+    unsigned int height = img->height;
+
+    // Only centres whose whole neighbourhood lies inside the image are filtered
+    t_rect interior = {n, n, (int)width - 2 * n, (int)height - 2 * n};
+    t_rect r;
+    if (!rect_clip(roi, width, height, &r) || !rect_intersect(&r, &interior, &r)) return;
+    dirty_add(img->dirty, &r);
+
+    // Memory rows of the region, plus the halo read from outside of it
+    unsigned int first_row = height - (unsigned int)(r.y + r.height);
+    unsigned int last_row = height - (unsigned int)r.y;
+    unsigned int halo_first = first_row - n;
+    size_t copy_size = (size_t)(last_row - first_row + 2 * n) * width;
+
+    unsigned char *original_data = (unsigned char *)malloc(copy_size);
     if (!original_data) {
         fprintf(stderr, "Error: Failed to allocate memory for temporary data in applyFilter.\n");
         return;
     }
-    memcpy(original_data, img->data, img->dataSize);
-
-    int n = kernelSize / 2;
-    unsigned int width = img->width;
-    unsigned int height = img->height;
+    memcpy(original_data, img->data + (size_t)halo_first * width, copy_size);
 
-    for (unsigned int y_center = n; y_center < height - n; y_center++) {
-        for (unsigned int x_center = n; x_center < width - n; x_center++) {
+    for (unsigned int y_center = first_row; y_center < last_row; y_center++) {
+        for (unsigned int x_center = r.x; x_center < (unsigned int)(r.x + r.width); x_center++) {
             float sum = 0.0f;
             for (int i_offset = -n; i_offset <= n; i_offset++) {
                 for (int j_offset = -n; j_offset <= n; j_offset++) {
@@ -198,7 +428,7 @@ void bmp8_applyFilter(t_bmp8 *img, float **kernel, int kernelSize) {
 
                     float kernel_val = kernel[i_offset + n][j_offset + n];
 
-                    sum += (float)original_data[img_y * width + img_x] * kernel_val;
+                    sum += (float)original_data[(img_y - halo_first) * width + img_x] * kernel_val;
                 }
             }
             int val = (int)round(sum);
@@ -211,6 +441,10 @@ void bmp8_applyFilter(t_bmp8 *img, float **kernel, int kernelSize) {
 }
 
 unsigned int *bmp8_computeHistogram(t_bmp8 *img) {
+    return bmp8_computeHistogramRegion(img, NULL);
+}
+
+unsigned int *bmp8_computeHistogramRegion(t_bmp8 *img, const t_rect *roi) {
     if (!img || !img->data) return NULL;
 
     // Use calloc to initialize histogram to zeros
@@ -220,8 +454,13 @@ unsigned int *bmp8_computeHistogram(t_bmp8 *img) {
         return NULL;
     }
 
-    for (unsigned int i = 0; i < img->dataSize; i++) {
-        hist[img->data[i]]++;
+    t_rect r;
+    if (!rect_clip(roi, img->width, img->height, &r)) return hist;
+    for (int y = 0; y < r.height; y++) {
+        const unsigned char *row = bmp8_regionRow(img, &r, y);
+        for (int x = 0; x < r.width; x++) {
+            hist[row[x]]++;
+        }
     }
     return hist;
 }
@@ -276,9 +515,76 @@ unsigned int *bmp8_computeCDF(const unsigned int *hist) {
 }
 
 void bmp8_equalize(t_bmp8 *img, const unsigned int *hist_eq_map) {
-    if (!img || !img->data || !hist_eq_map) return;
+    bmp8_equalizeRegion(img, hist_eq_map, NULL);
+}
+
+void bmp8_equalizeRegion(t_bmp8 *img, const unsigned int *hist_eq_map, const t_rect *roi) {
+    t_rect r;
+    if (!img || !img->data || !hist_eq_map || !rect_clip(roi, img->width, img->height, &r)) return;
+    dirty_add(img->dirty, &r);
 
-    for (unsigned int i = 0; i < img->dataSize; i++) {
-        img->data[i] = (unsigned char)hist_eq_map[img->data[i]];
+    for (int y = 0; y < r.height; y++) {
+        unsigned char *row = bmp8_regionRow(img, &r, y);
+        for (int x = 0; x < r.width; x++) {
+            row[x] = (unsigned char)hist_eq_map[row[x]];
+        }
     }
-}
\ No newline at end of file
+}
+
+t_bmp8 *bmp8_loadRegion(const char *filename, const t_rect *roi) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        printf("Error opening file for reading");
+        return NULL;
+    }
+
+    unsigned char header[54];
+    unsigned char colorTable[1024];
+    if (fread(header, sizeof(unsigned char), 54, file) != 54 || header[0] != 'B' || header[1] != 'M') {
+        fprintf(stderr, "Error: Failed to read a BMP header.\n");
+        fclose(file);
+        return NULL;
+    }
+    unsigned int width = read_uint_le(header, 18);
+    unsigned int height = read_uint_le(header, 22);
+    unsigned int offset = read_uint_le(header, 10);
+    if (read_ushort_le(header, 28) != 8) {
+        fprintf(stderr, "Error: Image is not 8-bit (colorDepth = %u).\n", read_ushort_le(header, 28));
+        fclose(file);
+        return NULL;
+    }
+    if (fread(colorTable, sizeof(unsigned char), 1024, file) != 1024) {
+        fprintf(stderr, "Error: Failed to read color table.\n");
+        fclose(file);
+        return NULL;
+    }
+
+    t_rect r;
+    if (!rect_clip(roi, width, height, &r)) {
+        fprintf(stderr, "Error: Region lies outside of the %u x %u image.\n", width, height);
+        fclose(file);
+        return NULL;
+    }
+    t_bmp8 *img = bmp8_allocate(r.width, r.height);
+    if (!img) {
+        fclose(file);
+        return NULL;
+    }
+    memcpy(img->colorTable, colorTable, sizeof(colorTable));
+
+    // Seek straight to each covered row: file rows are bottom-up and padded to the row pitch
+    unsigned int pitch = bmp8_rowPitch(width);
+    for (int y = 0; y < r.height; y++) {
+        long position = (long)offset + (long)(height - 1 - (unsigned int)(r.y + y)) * pitch + r.x;
+        if (fseek(file, position, SEEK_SET) != 0 ||
+            fread(img->data + (size_t)(r.height - 1 - y) * r.width, 1, r.width, file) != (size_t)r.width) {
+            fprintf(stderr, "Error: Failed to read region row %d.\n", r.y + y);
+            bmp8_free(img);
+            fclose(file);
+            return NULL;
+        }
+    }
+
+    fclose(file);
+    return img;
+}
@@ -3,6 +3,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include "rect.h"
+#include "buffer.h"
 
 typedef struct {
     unsigned char header[54];
@@ -13,13 +15,31 @@ typedef struct {
     unsigned int height;
     unsigned int colorDepth;
     unsigned int dataSize;
+    int view;   // data points into a caller's buffer (bmp8_viewMemory) and is not freed
+    t_dirty_region *dirty;   // When set, the ops below add every rectangle they change; NULL after loading
 } t_bmp8;
 
+t_bmp8 *bmp8_allocate(unsigned int width, unsigned int height);
 t_bmp8 *bmp8_loadImage(const char *filename);
+// Reads width x height pixels from the file position just after the colour table into img's
+// buffer. Returns 0 on success, -1 on a short read.
+int bmp8_readPixelData(t_bmp8 *img, FILE *file);
+t_bmp8 *bmp8_loadRegion(const char *filename, const t_rect *roi);
+// Writes the colours of the colour table as a 24-bit QOI file when the name ends in .qoi
 void bmp8_saveImage(const char *filename, t_bmp8 *img);
 void bmp8_free(t_bmp8 *img);
 void bmp8_printInfo(t_bmp8 *img);
 
+// In-memory files. bmp8_decodeMemory copies the pixels out of data. bmp8_viewMemory leaves them
+// in place when the file layout matches t_bmp8 (bottom-up rows whose width is a multiple of 4),
+// so edits go straight to the buffer, which must outlive the image; other layouts are copied.
+// Both return NULL if data does not hold a complete 8-bit BMP.
+t_bmp8 *bmp8_decodeMemory(const void *data, size_t size);
+t_bmp8 *bmp8_viewMemory(void *data, size_t size);
+// Appends the file bmp8_saveImage would write. Returns 0 on success, -1 on error.
+int bmp8_encodeMemory(const t_bmp8 *img, t_byte_buffer *out);
+size_t bmp8_encodedSize(const t_bmp8 *img);
+
 void bmp8_negative(t_bmp8 *img);
 void bmp8_brightness(t_bmp8 *img, int value);
 void bmp8_threshold(t_bmp8 *img, int threshold);
@@ -30,4 +50,14 @@ unsigned int * bmp8_computeHistogram(t_bmp8 * img);
 unsigned int * bmp8_computeCDF(const unsigned int * hist);
 void bmp8_equalize(t_bmp8 * img, const unsigned int * hist_eq);
 
+// Region variants: roi uses top-left origin coordinates, NULL means the whole image.
+// The whole-image calls above go through them, and all add what they write to img->dirty.
+// Convolution reads its halo from outside of the region but only writes inside it.
+void bmp8_negativeRegion(t_bmp8 *img, const t_rect *roi);
+void bmp8_brightnessRegion(t_bmp8 *img, int value, const t_rect *roi);
+void bmp8_thresholdRegion(t_bmp8 *img, int threshold, const t_rect *roi);
+void bmp8_applyFilterRegion(t_bmp8 *img, float **kernel, int kernelSize, const t_rect *roi);
+unsigned int * bmp8_computeHistogramRegion(t_bmp8 * img, const t_rect *roi);
+void bmp8_equalizeRegion(t_bmp8 * img, const unsigned int * hist_eq, const t_rect *roi);
+
 #endif // BMP8_H
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include "buffer.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Read size while draining a stream
+#define BUFFER_READ_CHUNK (256 * 1024)
+
+void buffer_init(t_byte_buffer *buffer) {
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+void buffer_wrap(t_byte_buffer *buffer, void *storage, size_t capacity) {
+    buffer->data = (uint8_t *)storage;
+    buffer->size = 0;
+    buffer->capacity = capacity;
+    buffer->fixed = 1;
+}
+
+uint8_t *buffer_append(t_byte_buffer *buffer, size_t size) {
+    if (size > buffer->capacity - buffer->size) {
+        if (buffer->fixed) return NULL;
+        // Doubling keeps repeated appends linear overall
+        size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+        while (capacity - buffer->size < size) {
+            if (capacity > SIZE_MAX / 2) return NULL;
+            capacity *= 2;
+        }
+        uint8_t *grown = (uint8_t *)realloc(buffer->data, capacity);
+        if (!grown) return NULL;
+        buffer->data = grown;
+        buffer->capacity = capacity;
+    }
+    uint8_t *dst = buffer->data + buffer->size;
+    buffer->size += size;
+    return dst;
+}
+
+void buffer_free(t_byte_buffer *buffer) {
+    if (!buffer->fixed) free(buffer->data);
+    buffer_init(buffer);
+}
+
+int buffer_readFile(t_byte_buffer *buffer, FILE *file) {
+    for (;;) {
+        size_t chunk = buffer->fixed ? buffer->capacity - buffer->size : BUFFER_READ_CHUNK;
+        if (chunk == 0) return (fgetc(file) == EOF && !ferror(file)) ? 0 : -1;   // Full: fine only at the end
+        uint8_t *dst = buffer_append(buffer, chunk);
+        if (!dst) return -1;
+        size_t n = fread(dst, 1, chunk, file);
+        buffer->size -= chunk - n;
+        if (n < chunk) return ferror(file) ? -1 : 0;
+    }
+}
+
+int buffer_writeFile(const t_byte_buffer *buffer, FILE *file) {
+    if (fwrite(buffer->data, 1, buffer->size, file) != buffer->size) return -1;
+    return fflush(file) == 0 ? 0 : -1;
+}
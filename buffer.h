@@ -0,0 +1,33 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// Byte buffer that encoders append to: either growable heap storage, or storage supplied by the
+// caller that is never reallocated, so encoding into it fails instead of overflowing
+typedef struct {
+    uint8_t *data;
+    size_t size;        // Bytes written so far
+    size_t capacity;
+    int fixed;          // data belongs to the caller
+} t_byte_buffer;
+
+// Empty growable buffer
+void buffer_init(t_byte_buffer *buffer);
+// Fixed buffer over capacity bytes of caller storage
+void buffer_wrap(t_byte_buffer *buffer, void *storage, size_t capacity);
+// Extends the buffer by size bytes and returns them for writing. Returns NULL when a fixed
+// buffer is too small or growing fails; the buffer is left as it was.
+uint8_t *buffer_append(t_byte_buffer *buffer, size_t size);
+// Releases growable storage and empties the buffer
+void buffer_free(t_byte_buffer *buffer);
+
+// Appends everything left in file, for pipes whose length is not known in advance.
+// Returns 0 on success, -1 on error.
+int buffer_readFile(t_byte_buffer *buffer, FILE *file);
+// Returns 0 on success, -1 on error
+int buffer_writeFile(const t_byte_buffer *buffer, FILE *file);
+
+#endif // BUFFER_H
@@ -0,0 +1,428 @@
+#include "cache.h"
+#include "qoi.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#define CACHE_COPY_BUFFER (64 * 1024)
+// Temporary files older than this were left by a store that never finished, e.g. a crash
+// between mkstemp and rename; younger ones may still be written
+#define CACHE_TEMP_MAX_AGE 3600
+
+// XXH64 (Collet), streamed. Fast enough that hashing an input costs less than decoding it.
+#define PRIME64_1 11400714785074694791ULL
+#define PRIME64_2 14029467366897019727ULL
+#define PRIME64_3 1609587929392839161ULL
+#define PRIME64_4 9650029242287828579ULL
+#define PRIME64_5 2870177450012600261ULL
+
+typedef struct {
+    uint64_t v[4];
+    uint64_t total;
+    uint8_t buffer[32];
+    size_t buffered;
+} t_hash_state;
+
+typedef struct {
+    char name[CACHE_KEY_LENGTH + 4];   // <key>.bmp or <key>.qoi
+    time_t mtime;
+    long mtime_nsec;
+    long long size;
+} t_cache_entry;
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t hash_round(uint64_t acc, uint64_t input) {
+    acc += input * PRIME64_2;
+    return rotl64(acc, 31) * PRIME64_1;
+}
+
+static inline uint64_t hash_merge(uint64_t acc, uint64_t v) {
+    acc ^= hash_round(0, v);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+static void hash_init(t_hash_state *h) {
+    memset(h, 0, sizeof(*h));
+    h->v[0] = PRIME64_1 + PRIME64_2;
+    h->v[1] = PRIME64_2;
+    h->v[2] = 0;
+    h->v[3] = (uint64_t)0 - PRIME64_1;
+}
+
+static void hash_stripe(t_hash_state *h, const uint8_t *p) {
+    for (int i = 0; i < 4; i++) h->v[i] = hash_round(h->v[i], read64(p + 8 * i));
+}
+
+static void hash_update(t_hash_state *h, const void *data, size_t length) {
+    const uint8_t *p = (const uint8_t *)data;
+    h->total += length;
+    if (h->buffered + length < 32) {
+        memcpy(h->buffer + h->buffered, p, length);
+        h->buffered += length;
+        return;
+    }
+    if (h->buffered > 0) {
+        size_t fill = 32 - h->buffered;
+        memcpy(h->buffer + h->buffered, p, fill);
+        hash_stripe(h, h->buffer);
+        p += fill;
+        length -= fill;
+        h->buffered = 0;
+    }
+    for (; length >= 32; p += 32, length -= 32) hash_stripe(h, p);
+    memcpy(h->buffer, p, length);
+    h->buffered = length;
+}
+
+static uint64_t hash_digest(const t_hash_state *h) {
+    uint64_t acc;
+    if (h->total >= 32) {
+        acc = rotl64(h->v[0], 1) + rotl64(h->v[1], 7) + rotl64(h->v[2], 12) + rotl64(h->v[3], 18);
+        for (int i = 0; i < 4; i++) acc = hash_merge(acc, h->v[i]);
+    } else {
+        acc = PRIME64_5;
+    }
+    acc += h->total;
+    const uint8_t *p = h->buffer;
+    size_t left = h->buffered;
+    for (; left >= 8; p += 8, left -= 8) {
+        acc ^= hash_round(0, read64(p));
+        acc = rotl64(acc, 27) * PRIME64_1 + PRIME64_4;
+    }
+    if (left >= 4) {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        acc ^= (uint64_t)v * PRIME64_1;
+        acc = rotl64(acc, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+        left -= 4;
+    }
+    for (; left > 0; p++, left--) {
+        acc ^= *p * PRIME64_5;
+        acc = rotl64(acc, 11) * PRIME64_1;
+    }
+    acc ^= acc >> 33;
+    acc *= PRIME64_2;
+    acc ^= acc >> 29;
+    acc *= PRIME64_3;
+    acc ^= acc >> 32;
+    return acc;
+}
+
+// Every field that affects the output, in a fixed layout: two chains hash alike exactly when
+// their plans do the same thing
+static uint64_t hash_pipeline(const t_pipeline *pipeline, int32_t format) {
+    t_hash_state h;
+    hash_init(&h);
+    int32_t header[3] = {CACHE_VERSION, pipeline->count, format};
+    hash_update(&h, header, sizeof(header));
+    for (int i = 0; i < pipeline->count; i++) {
+        const t_op *op = &pipeline->ops[i];
+        // Fields an op type does not use may hold leftovers, e.g. value after folding into a LUT
+        int32_t type = (int32_t)op->type;
+        hash_update(&h, &type, sizeof(type));
+        if (op->type == OP_BRIGHTNESS || op->type == OP_THRESHOLD) hash_update(&h, &op->value, sizeof(op->value));
+        if (op->type == OP_LUT) hash_update(&h, op->lut, sizeof(op->lut));
+        if (op->type == OP_KERNEL) {
+            hash_update(&h, &op->kernelSize, sizeof(op->kernelSize));
+            for (int k = 0; k < op->kernelSize * op->kernelSize; k++) {
+                float value = op->kernel[k] == 0.0f ? 0.0f : op->kernel[k];   // -0 and 0 alike
+                hash_update(&h, &value, sizeof(value));
+            }
+        }
+    }
+    return hash_digest(&h);
+}
+
+int cache_key(const char *inputPath, const t_pipeline *pipeline, const char *outputPath, char key[CACHE_KEY_LENGTH]) {
+    if (!inputPath || !pipeline || !outputPath || !key) return -1;
+    FILE *file = fopen(inputPath, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot open %s for reading.\n", inputPath);
+        return -1;
+    }
+    uint8_t *buffer = (uint8_t *)malloc(CACHE_COPY_BUFFER);
+    if (!buffer) {
+        fclose(file);
+        return -1;
+    }
+    t_hash_state h;
+    hash_init(&h);
+    size_t n;
+    while ((n = fread(buffer, 1, CACHE_COPY_BUFFER, file)) > 0) hash_update(&h, buffer, n);
+    int failed = ferror(file);
+    fclose(file);
+    free(buffer);
+    if (failed) {
+        fprintf(stderr, "Error: Failed to read %s.\n", inputPath);
+        return -1;
+    }
+    snprintf(key, CACHE_KEY_LENGTH, "%016llx%016llx", (unsigned long long)hash_digest(&h),
+             (unsigned long long)hash_pipeline(pipeline, qoi_isFilename(outputPath)));
+    return 0;
+}
+
+static int copy_fd(int from_fd, int to_fd) {
+    char *buffer = (char *)malloc(CACHE_COPY_BUFFER);
+    if (!buffer) return -1;
+    int status = 0;
+    ssize_t n;
+    while (status == 0 && (n = read(from_fd, buffer, CACHE_COPY_BUFFER)) != 0) {
+        if (n < 0) {
+            if (errno != EINTR) status = -1;
+            continue;
+        }
+        for (ssize_t done = 0; done < n;) {
+            ssize_t w = write(to_fd, buffer + done, n - done);
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) {
+                status = -1;
+                break;
+            }
+            done += w;
+        }
+    }
+    free(buffer);
+    return status;
+}
+
+// Entries carry the extension of the format they hold, which the key already depends on
+static void entry_path(const t_result_cache *cache, const char *key, const char *outputPath, char *path,
+                       size_t size) {
+    snprintf(path, size, "%s/%s%s", cache->dir, key, qoi_isFilename(outputPath) ? ".qoi" : ".bmp");
+}
+
+// Adds to the hit and miss totals kept in <dir>/stats, under an exclusive lock on that file
+static void record_access(t_result_cache *cache, int hit) {
+    pthread_mutex_lock(&cache->lock);
+    if (hit) cache->hits++;
+    else cache->misses++;
+    pthread_mutex_unlock(&cache->lock);
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/stats", cache->dir);
+    int fd = open(path, O_RDWR | O_CREAT, 0666);
+    if (fd < 0) return;
+    if (flock(fd, LOCK_EX) == 0) {
+        char text[128] = {0};
+        unsigned long long hits = 0, misses = 0;
+        if (pread(fd, text, sizeof(text) - 1, 0) > 0) sscanf(text, "hits %llu misses %llu", &hits, &misses);
+        if (hit) hits++;
+        else misses++;
+        // Counts only grow, so the new text always covers the old one
+        int length = snprintf(text, sizeof(text), "hits %llu misses %llu\n", hits, misses);
+        if (pwrite(fd, text, length, 0) != length) fprintf(stderr, "Warning: Failed to update %s.\n", path);
+        flock(fd, LOCK_UN);
+    }
+    close(fd);
+}
+
+// <key>.tmpXXXXXX, the name cache_store gives mkstemp
+static int is_temp_name(const char *name) {
+    size_t length = strlen(name);
+    return length == CACHE_KEY_LENGTH - 1 + 10 && strncmp(name + CACHE_KEY_LENGTH - 1, ".tmp", 4) == 0;
+}
+
+static void sweep_temp_files(const char *dir) {
+    DIR *d = opendir(dir);
+    if (!d) return;
+    time_t now = time(NULL);
+    struct dirent *item;
+    while ((item = readdir(d)) != NULL) {
+        struct stat st;
+        if (!is_temp_name(item->d_name) || fstatat(dirfd(d), item->d_name, &st, 0) != 0) continue;
+        if (now - st.st_mtim.tv_sec > CACHE_TEMP_MAX_AGE) unlinkat(dirfd(d), item->d_name, 0);
+    }
+    closedir(d);
+}
+
+t_result_cache *cache_open(const char *dir, long long limit) {
+    if (!dir || limit <= 0) {
+        fprintf(stderr, "Error: Invalid cache directory or size limit.\n");
+        return NULL;
+    }
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Error: Cannot create cache directory %s.\n", dir);
+        return NULL;
+    }
+    t_result_cache *cache = (t_result_cache *)calloc(1, sizeof(t_result_cache));
+    if (!cache || !(cache->dir = strdup(dir))) {
+        fprintf(stderr, "Error: Failed to allocate the result cache.\n");
+        free(cache);
+        return NULL;
+    }
+    cache->limit = limit;
+    pthread_mutex_init(&cache->lock, NULL);
+    sweep_temp_files(dir);
+    return cache;
+}
+
+void cache_close(t_result_cache *cache) {
+    if (!cache) return;
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->dir);
+    free(cache);
+}
+
+int cache_fetch(t_result_cache *cache, const char *key, const char *outputPath) {
+    if (!cache || !key || !outputPath) return -1;
+    char path[4096];
+    entry_path(cache, key, outputPath, path, sizeof(path));
+    // An entry evicted after open stays readable through the descriptor
+    int entry_fd = open(path, O_RDONLY);
+    if (entry_fd < 0) {
+        record_access(cache, 0);
+        return 0;
+    }
+    int out_fd = open(outputPath, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (out_fd < 0) {
+        fprintf(stderr, "Error: Cannot open %s for writing.\n", outputPath);
+        close(entry_fd);
+        return -1;
+    }
+    int status = copy_fd(entry_fd, out_fd);
+    close(entry_fd);
+    if (close(out_fd) != 0) status = -1;
+    if (status != 0) {
+        fprintf(stderr, "Error: Failed to copy the cached result to %s.\n", outputPath);
+        return -1;
+    }
+    utimensat(AT_FDCWD, path, NULL, 0);   // Most recently used
+    record_access(cache, 1);
+    return 1;
+}
+
+static int compare_entries(const void *a, const void *b) {
+    const t_cache_entry *x = (const t_cache_entry *)a, *y = (const t_cache_entry *)b;
+    if (x->mtime != y->mtime) return x->mtime < y->mtime ? -1 : 1;
+    if (x->mtime_nsec != y->mtime_nsec) return x->mtime_nsec < y->mtime_nsec ? -1 : 1;
+    return 0;
+}
+
+static int is_entry_name(const char *name) {
+    size_t length = strlen(name);
+    return length == CACHE_KEY_LENGTH - 1 + 4 &&
+           (strcmp(name + CACHE_KEY_LENGTH - 1, ".bmp") == 0 || strcmp(name + CACHE_KEY_LENGTH - 1, ".qoi") == 0);
+}
+
+// Lists the entries of the directory. Returns the count, or -1 on error.
+static int list_entries(const char *dir, t_cache_entry **entries, long long *bytes) {
+    *entries = NULL;
+    *bytes = 0;
+    DIR *d = opendir(dir);
+    if (!d) return -1;
+    int count = 0, capacity = 0;
+    struct dirent *item;
+    while ((item = readdir(d)) != NULL) {
+        if (!is_entry_name(item->d_name)) continue;
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            t_cache_entry *grown = (t_cache_entry *)realloc(*entries, capacity * sizeof(t_cache_entry));
+            if (!grown) {
+                closedir(d);
+                free(*entries);
+                *entries = NULL;
+                return -1;
+            }
+            *entries = grown;
+        }
+        t_cache_entry *entry = &(*entries)[count];
+        struct stat st;
+        if (fstatat(dirfd(d), item->d_name, &st, 0) != 0) continue;   // Evicted by someone else meanwhile
+        strcpy(entry->name, item->d_name);
+        entry->mtime = st.st_mtim.tv_sec;
+        entry->mtime_nsec = st.st_mtim.tv_nsec;
+        entry->size = (long long)st.st_size;
+        *bytes += entry->size;
+        count++;
+    }
+    closedir(d);
+    return count;
+}
+
+// One process evicts at a time; the others skip eviction rather than wait, the next store
+// catches up
+static void evict(t_result_cache *cache) {
+    char lock_path[4096];
+    snprintf(lock_path, sizeof(lock_path), "%s/lock", cache->dir);
+    int lock_fd = open(lock_path, O_RDWR | O_CREAT, 0666);
+    if (lock_fd < 0) return;
+    if (flock(lock_fd, LOCK_EX | LOCK_NB) != 0) {
+        close(lock_fd);
+        return;
+    }
+    t_cache_entry *entries;
+    long long bytes;
+    int count = list_entries(cache->dir, &entries, &bytes);
+    if (count > 0 && bytes > cache->limit) {
+        qsort(entries, count, sizeof(t_cache_entry), compare_entries);
+        int dir_fd = open(cache->dir, O_RDONLY | O_DIRECTORY);
+        for (int i = 0; dir_fd >= 0 && i < count && bytes > cache->limit; i++) {
+            if (unlinkat(dir_fd, entries[i].name, 0) == 0) bytes -= entries[i].size;
+        }
+        if (dir_fd >= 0) close(dir_fd);
+    }
+    free(entries);
+    flock(lock_fd, LOCK_UN);
+    close(lock_fd);
+}
+
+int cache_store(t_result_cache *cache, const char *key, const char *outputPath) {
+    if (!cache || !key || !outputPath) return -1;
+    char path[4096], temp[4096];
+    entry_path(cache, key, outputPath, path, sizeof(path));
+    snprintf(temp, sizeof(temp), "%s/%s.tmpXXXXXX", cache->dir, key);
+    int fd = mkstemp(temp);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot create a temporary file in %s.\n", cache->dir);
+        return -1;
+    }
+    int result_fd = open(outputPath, O_RDONLY);
+    int status = (result_fd >= 0) ? copy_fd(result_fd, fd) : -1;
+    if (result_fd >= 0) close(result_fd);
+    if (close(fd) != 0) status = -1;
+    // Readers only ever see complete entries
+    if (status == 0 && rename(temp, path) != 0) status = -1;
+    if (status != 0) {
+        unlink(temp);
+        fprintf(stderr, "Error: Failed to store %s in the cache.\n", outputPath);
+        return -1;
+    }
+    evict(cache);
+    return 0;
+}
+
+int cache_stats(const t_result_cache *cache, t_cache_stats *stats) {
+    if (!cache || !stats) return -1;
+    memset(stats, 0, sizeof(*stats));
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/stats", cache->dir);
+    FILE *file = fopen(path, "r");
+    if (file) {
+        if (fscanf(file, "hits %llu misses %llu", &stats->hits, &stats->misses) != 2) stats->hits = stats->misses = 0;
+        fclose(file);
+    }
+    t_cache_entry *entries;
+    int count = list_entries(cache->dir, &entries, &stats->bytes);
+    free(entries);
+    if (count < 0) return -1;
+    stats->entries = count;
+    return 0;
+}
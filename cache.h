@@ -0,0 +1,52 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <pthread.h>
+#include "pipeline.h"
+
+// Hex digits of a key plus the terminating NUL
+#define CACHE_KEY_LENGTH 33
+
+// Size bound used by the CLI when none is given
+#define CACHE_DEFAULT_LIMIT (512LL * 1024 * 1024)
+
+// Bump whenever an operation changes its output, so that stale results are never served
+#define CACHE_VERSION 4
+
+// On-disk cache of pipeline results, one file per result in a directory, named <key>.bmp or
+// <key>.qoi after the format it holds. Keys hash the whole input file (header and pixels) and a
+// canonical encoding of the op chain, so spellings that optimize to the same plan share results.
+// Entries are written to a temporary file and renamed, and every hit refreshes the entry's mtime,
+// which is what the LRU eviction orders by. Several processes and threads can share one directory.
+typedef struct {
+    char *dir;
+    long long limit;            // Total size of the entries kept after each store, in bytes
+    pthread_mutex_t lock;       // Guards the counters below
+    unsigned long hits;         // This handle only; cache_stats also reports the totals
+    unsigned long misses;
+} t_result_cache;
+
+typedef struct {
+    unsigned long long hits;    // Totals over every process that used the directory
+    unsigned long long misses;
+    int entries;
+    long long bytes;
+} t_cache_stats;
+
+// Creates the directory if needed and removes temporary files older than an hour. Returns NULL
+// on error.
+t_result_cache *cache_open(const char *dir, long long limit);
+void cache_close(t_result_cache *cache);
+
+// Key of running pipeline on the file at inputPath and saving to outputPath, whose name picks the
+// file format. Returns 0 on success, -1 on read error.
+int cache_key(const char *inputPath, const t_pipeline *pipeline, const char *outputPath, char key[CACHE_KEY_LENGTH]);
+// Copies the stored result to outputPath. Returns 1 on a hit, 0 on a miss, -1 on error.
+int cache_fetch(t_result_cache *cache, const char *key, const char *outputPath);
+// Stores a copy of the result at outputPath, then evicts least recently used entries until the
+// cache fits its limit. Returns 0 on success, -1 on error.
+int cache_store(t_result_cache *cache, const char *key, const char *outputPath);
+// Returns 0 on success, -1 on error
+int cache_stats(const t_result_cache *cache, t_cache_stats *stats);
+
+#endif // CACHE_H
@@ -0,0 +1,350 @@
+#include "catalog.h"
+#include "probe.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#pragma pack(push, 1)
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t namesSize;
+    int64_t scanSec;            // When the scan that wrote the catalog started
+    uint32_t scanNsec;
+} t_catalog_file_header;
+
+#pragma pack(pop)
+
+// Relative paths found by the directory walk, packed in one growing buffer
+typedef struct {
+    char *names;
+    size_t size;
+    size_t capacity;
+    size_t *offsets;
+    int count;
+    int capacity_offsets;
+} t_name_list;
+
+static int has_bmp_extension(const char *name) {
+    size_t length = strlen(name);
+    return length > 4 && strcasecmp(name + length - 4, ".bmp") == 0;
+}
+
+static int list_push(t_name_list *list, const char *prefix, const char *name) {
+    size_t prefix_length = prefix ? strlen(prefix) + 1 : 0;
+    size_t length = prefix_length + strlen(name) + 1;
+    if (list->size + length > list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 64 * 1024;
+        while (capacity < list->size + length) capacity *= 2;
+        char *grown = (char *)realloc(list->names, capacity);
+        if (!grown) return -1;
+        list->names = grown;
+        list->capacity = capacity;
+    }
+    if (list->count == list->capacity_offsets) {
+        int capacity = list->capacity_offsets ? list->capacity_offsets * 2 : 1024;
+        size_t *grown = (size_t *)realloc(list->offsets, capacity * sizeof(size_t));
+        if (!grown) return -1;
+        list->offsets = grown;
+        list->capacity_offsets = capacity;
+    }
+    char *dst = list->names + list->size;
+    if (prefix) dst += sprintf(dst, "%s/", prefix);
+    strcpy(dst, name);
+    list->offsets[list->count++] = list->size;
+    list->size += length;
+    return 0;
+}
+
+// Collects the .bmp files below relative (NULL for the root itself). Hidden entries are
+// skipped, which also keeps a catalog stored inside the directory out of it, and symbolic
+// links to directories are not followed so a loop cannot trap the walk.
+static int walk(int root_fd, const char *relative, t_name_list *list) {
+    int fd = openat(root_fd, relative ? relative : ".", O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+    if (fd < 0) return relative ? 0 : -1;   // An unreadable subdirectory is left out
+    DIR *d = fdopendir(fd);
+    if (!d) {
+        close(fd);
+        return -1;
+    }
+    int status = 0;
+    struct dirent *item;
+    while (status == 0 && (item = readdir(d)) != NULL) {
+        if (item->d_name[0] == '.') continue;
+        int type = item->d_type;
+        if (type == DT_UNKNOWN) {
+            struct stat st;
+            if (fstatat(dirfd(d), item->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) continue;
+            type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISLNK(st.st_mode) ? DT_LNK : DT_REG;
+        }
+        if (type == DT_DIR) {
+            char child[4096];
+            int length = relative ? snprintf(child, sizeof(child), "%s/%s", relative, item->d_name)
+                                  : snprintf(child, sizeof(child), "%s", item->d_name);
+            if (length >= (int)sizeof(child)) continue;
+            status = walk(root_fd, child, list);
+        } else if ((type == DT_REG || type == DT_LNK) && has_bmp_extension(item->d_name)) {
+            status = list_push(list, relative, item->d_name);
+        }
+    }
+    closedir(d);
+    return status;
+}
+
+static int compare_paths(const void *a, const void *b) {
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+// Reads the headers of one file into record, leaving it marked as not a BMP if that fails
+static void probe_record(int root_fd, const char *path, t_catalog_record *record) {
+    int fd = openat(root_fd, path, O_RDONLY);
+    if (fd < 0) return;
+    unsigned char header[PROBE_HEADER_SIZE];
+    t_bmp_probe probe;
+    if (pread(fd, header, sizeof(header), 0) == (ssize_t)sizeof(header) && bmp_probeHeader(header, &probe) == 0) {
+        record->width = (uint32_t)probe.width;
+        record->height = (uint32_t)probe.height;
+        record->depth = (uint16_t)probe.depth;
+        record->compression = (uint8_t)(probe.compression > 255 ? 255 : probe.compression);
+        record->flags = CATALOG_BMP | (probe.topDown ? CATALOG_TOP_DOWN : 0);
+    }
+    close(fd);
+}
+
+// A file modified in the same clock tick as the previous scan may have changed after it was
+// probed without its mtime showing it, so such records are never trusted
+static int record_unchanged(const t_catalog_record *old, const struct stat *st, const t_catalog *previous) {
+    if (old->mtimeSec != (int64_t)st->st_mtim.tv_sec || old->mtimeNsec != (uint32_t)st->st_mtim.tv_nsec) return 0;
+    if (old->fileSize != (uint64_t)st->st_size) return 0;
+    if (old->mtimeSec > previous->scanSec) return 0;
+    return !(old->mtimeSec == previous->scanSec && old->mtimeNsec >= previous->scanNsec);
+}
+
+// Takes the records with a nonzero state, in order, into a new catalog
+static t_catalog *build_catalog(const t_catalog_record *records, char **paths, const uint8_t *state, int count) {
+    int kept = 0;
+    size_t names_size = 0;
+    for (int i = 0; i < count; i++) {
+        if (!state[i]) continue;
+        kept++;
+        names_size += strlen(paths[i]) + 1;
+    }
+    t_catalog *catalog = (t_catalog *)calloc(1, sizeof(t_catalog));
+    char *block = (char *)malloc((size_t)kept * sizeof(t_catalog_record) + names_size + 1);
+    if (!catalog || !block) {
+        free(catalog);
+        free(block);
+        return NULL;
+    }
+    catalog->block = block;
+    catalog->count = kept;
+    catalog->records = (t_catalog_record *)block;
+    catalog->names = block + (size_t)kept * sizeof(t_catalog_record);
+    catalog->namesSize = names_size;
+    size_t offset = 0;
+    for (int i = 0, j = 0; i < count; i++) {
+        if (!state[i]) continue;
+        catalog->records[j] = records[i];
+        catalog->records[j].nameOffset = (uint32_t)offset;
+        strcpy(catalog->names + offset, paths[i]);
+        offset += strlen(paths[i]) + 1;
+        j++;
+    }
+    return catalog;
+}
+
+t_catalog *catalog_scan(const char *dir, const char *catalogPath, t_catalog_scan_stats *stats) {
+    struct timespec started;
+    clock_gettime(CLOCK_REALTIME, &started);
+    int root_fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (root_fd < 0) {
+        fprintf(stderr, "Error: Cannot open directory %s.\n", dir);
+        return NULL;
+    }
+    t_name_list list = {0};
+    if (walk(root_fd, NULL, &list) != 0) {
+        fprintf(stderr, "Error: Failed to list %s.\n", dir);
+        free(list.names);
+        free(list.offsets);
+        close(root_fd);
+        return NULL;
+    }
+
+    int count = list.count;
+    char **paths = (char **)malloc((count + 1) * sizeof(char *));
+    t_catalog_record *records = (t_catalog_record *)calloc(count + 1, sizeof(t_catalog_record));
+    uint8_t *state = (uint8_t *)calloc(count + 1, 1);
+    t_catalog *catalog = NULL;
+    if (!paths || !records || !state) {
+        fprintf(stderr, "Error: Failed to allocate memory for the catalog of %s.\n", dir);
+        goto done;
+    }
+    for (int i = 0; i < count; i++) paths[i] = list.names + list.offsets[i];
+    qsort(paths, count, sizeof(char *), compare_paths);
+
+    t_catalog *previous = catalogPath ? catalog_load(catalogPath) : NULL;
+    int probed = 0, unchanged = 0, invalid = 0, matched = 0;
+    // Stat and header reads dominate, and they are independent per file
+    #pragma omp parallel for schedule(dynamic, 64) reduction(+:probed, unchanged, invalid, matched)
+    for (int i = 0; i < count; i++) {
+        struct stat st;
+        if (fstatat(root_fd, paths[i], &st, 0) != 0 || !S_ISREG(st.st_mode)) continue;   // Gone meanwhile
+        t_catalog_record *record = &records[i];
+        record->mtimeSec = (int64_t)st.st_mtim.tv_sec;
+        record->mtimeNsec = (uint32_t)st.st_mtim.tv_nsec;
+        record->fileSize = (uint64_t)st.st_size;
+        const t_catalog_record *old = previous ? catalog_find(previous, paths[i]) : NULL;
+        if (old) matched++;
+        if (old && record_unchanged(old, &st, previous)) {
+            record->width = old->width;
+            record->height = old->height;
+            record->depth = old->depth;
+            record->compression = old->compression;
+            record->flags = old->flags;
+            unchanged++;
+        } else {
+            probe_record(root_fd, paths[i], record);
+            probed++;
+        }
+        if (!(record->flags & CATALOG_BMP)) invalid++;
+        state[i] = 1;
+    }
+
+    catalog = build_catalog(records, paths, state, count);
+    if (!catalog) {
+        fprintf(stderr, "Error: Failed to allocate memory for the catalog of %s.\n", dir);
+    } else {
+        catalog->scanSec = (int64_t)started.tv_sec;
+        catalog->scanNsec = (uint32_t)started.tv_nsec;
+        if (catalogPath && catalog_save(catalog, catalogPath) != 0) {
+            catalog_free(catalog);
+            catalog = NULL;
+        }
+    }
+    if (catalog && stats) {
+        stats->files = catalog->count;
+        stats->probed = probed;
+        stats->unchanged = unchanged;
+        stats->removed = previous ? previous->count - matched : 0;
+        stats->invalid = invalid;
+    }
+    catalog_free(previous);
+
+done:
+    free(paths);
+    free(records);
+    free(state);
+    free(list.names);
+    free(list.offsets);
+    close(root_fd);
+    return catalog;
+}
+
+t_catalog *catalog_load(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return NULL;
+    t_catalog_file_header header;
+    t_catalog *catalog = NULL;
+    char *block = NULL;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, CATALOG_MAGIC, 4) != 0 ||
+        header.version != CATALOG_VERSION) {
+        goto fail;
+    }
+    size_t records_size = (size_t)header.count * sizeof(t_catalog_record);
+    catalog = (t_catalog *)calloc(1, sizeof(t_catalog));
+    block = (char *)malloc(records_size + header.namesSize + 1);
+    if (!catalog || !block || fread(block, 1, records_size + header.namesSize, file) != records_size + header.namesSize) {
+        goto fail;
+    }
+    fclose(file);
+    block[records_size + header.namesSize] = '\0';   // Bounds every name, even in a damaged file
+
+    catalog->block = block;
+    catalog->count = (int)header.count;
+    catalog->records = (t_catalog_record *)block;
+    catalog->names = block + records_size;
+    catalog->namesSize = header.namesSize;
+    catalog->scanSec = header.scanSec;
+    catalog->scanNsec = header.scanNsec;
+    for (int i = 0; i < catalog->count; i++) {
+        if (catalog->records[i].nameOffset >= header.namesSize) {
+            catalog_free(catalog);
+            return NULL;
+        }
+    }
+    return catalog;
+
+fail:
+    fclose(file);
+    free(catalog);
+    free(block);
+    return NULL;
+}
+
+static int write_all(int fd, const void *data, size_t size) {
+    const char *p = (const char *)data;
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n <= 0) return -1;
+        p += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+int catalog_save(const t_catalog *catalog, const char *path) {
+    if (!catalog || !path) return -1;
+    t_catalog_file_header header;
+    memcpy(header.magic, CATALOG_MAGIC, 4);
+    header.version = CATALOG_VERSION;
+    header.count = (uint32_t)catalog->count;
+    header.namesSize = (uint32_t)catalog->namesSize;
+    header.scanSec = catalog->scanSec;
+    header.scanNsec = catalog->scanNsec;
+
+    char temp[4096];
+    snprintf(temp, sizeof(temp), "%s.tmpXXXXXX", path);
+    int fd = mkstemp(temp);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot create a temporary file for %s.\n", path);
+        return -1;
+    }
+    int status = write_all(fd, &header, sizeof(header));
+    if (status == 0) status = write_all(fd, catalog->records, (size_t)catalog->count * sizeof(t_catalog_record));
+    if (status == 0) status = write_all(fd, catalog->names, catalog->namesSize);
+    fchmod(fd, 0644);
+    if (close(fd) != 0) status = -1;
+    if (status == 0 && rename(temp, path) != 0) status = -1;
+    if (status != 0) {
+        unlink(temp);
+        fprintf(stderr, "Error: Failed to write the catalog %s.\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+void catalog_free(t_catalog *catalog) {
+    if (!catalog) return;
+    free(catalog->block);
+    free(catalog);
+}
+
+const t_catalog_record *catalog_find(const t_catalog *catalog, const char *name) {
+    int low = 0, high = catalog->count - 1;
+    while (low <= high) {
+        int middle = low + (high - low) / 2;
+        int order = strcmp(catalog_name(catalog, &catalog->records[middle]), name);
+        if (order == 0) return &catalog->records[middle];
+        if (order < 0) low = middle + 1;
+        else high = middle - 1;
+    }
+    return NULL;
+}
@@ -0,0 +1,69 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Written at the start of every catalog file, followed by a format version
+#define CATALOG_MAGIC "BCAT"
+#define CATALOG_VERSION 1
+
+// Record flags
+#define CATALOG_BMP      0x01   // The file has a BMP header; the other fields are 0 otherwise
+#define CATALOG_TOP_DOWN 0x02
+
+#pragma pack(push, 1)
+
+// One file, as stored on disk: the records of a catalog are an array sorted by name, so a
+// catalog file is loaded with a single read and searched in place
+typedef struct {
+    int64_t mtimeSec;
+    uint32_t mtimeNsec;
+    uint64_t fileSize;
+    uint32_t nameOffset;        // Into the name table: NUL-terminated path relative to the root
+    uint32_t width;
+    uint32_t height;
+    uint16_t depth;
+    uint8_t compression;
+    uint8_t flags;
+} t_catalog_record;
+
+#pragma pack(pop)
+
+typedef struct {
+    int count;
+    t_catalog_record *records;
+    char *names;
+    size_t namesSize;
+    int64_t scanSec;            // When the scan that produced the catalog started
+    uint32_t scanNsec;
+    void *block;                // Owns records and names
+} t_catalog;
+
+typedef struct {
+    int files;                  // .bmp files found
+    int probed;                 // New or modified since the previous scan, headers read again
+    int unchanged;              // Same size and mtime, copied from the previous catalog
+    int removed;                // In the previous catalog but gone from the directory
+    int invalid;                // Named .bmp but without a BMP header
+} t_catalog_scan_stats;
+
+// Walks dir recursively for *.bmp files and probes their headers in parallel. When catalogPath
+// holds a catalog from a previous scan, files whose size and mtime did not change are taken
+// from it and only the others are opened. The result is written back to catalogPath, through
+// a temporary file so readers never see a partial catalog. stats may be NULL.
+// Returns NULL on error.
+t_catalog *catalog_scan(const char *dir, const char *catalogPath, t_catalog_scan_stats *stats);
+// Returns NULL if the file is missing or not a catalog of this version
+t_catalog *catalog_load(const char *path);
+// Returns 0 on success, -1 on error
+int catalog_save(const t_catalog *catalog, const char *path);
+void catalog_free(t_catalog *catalog);
+
+// Binary search by relative path. Returns NULL if the file is not in the catalog.
+const t_catalog_record *catalog_find(const t_catalog *catalog, const char *name);
+static inline const char *catalog_name(const t_catalog *catalog, const t_catalog_record *record) {
+    return catalog->names + record->nameOffset;
+}
+
+#endif // CATALOG_H
@@ -0,0 +1,192 @@
+#include "clahe.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// Interpolation between two neighbouring tiles along one axis, weight in 1/256 of the first
+typedef struct {
+    int first;
+    int second;
+    int weight;
+} t_tile_blend;
+
+static void clip_histogram(unsigned int *hist, unsigned int limit) {
+    unsigned int excess = 0;
+    for (int i = 0; i < 256; i++) {
+        if (hist[i] > limit) {
+            excess += hist[i] - limit;
+            hist[i] = limit;
+        }
+    }
+    unsigned int share = excess / 256;
+    unsigned int rest = excess % 256;
+    for (int i = 0; i < 256; i++) hist[i] += share;
+    // Remaining counts go to evenly spaced bins
+    if (rest > 0) {
+        unsigned int step = 256 / rest;
+        for (unsigned int i = 0; i < rest; i++) hist[i * step]++;
+    }
+}
+
+static double tile_centre(int t, int size, int tiles) {
+    return ((double)((long)t * size / tiles) + (double)((long)(t + 1) * size / tiles)) / 2.0;
+}
+
+// Tile t along an axis of length size covers [t * size / tiles, (t + 1) * size / tiles). Pixels
+// between two tile centres blend them; pixels before the first or after the last centre use
+// that tile alone.
+static t_tile_blend *tile_blends(int size, int tiles) {
+    t_tile_blend *blends = (t_tile_blend *)malloc(size * sizeof(t_tile_blend));
+    if (!blends) return NULL;
+    int t = 0;
+    for (int i = 0; i < size; i++) {
+        double pos = i + 0.5;
+        while (t + 1 < tiles && tile_centre(t + 1, size, tiles) <= pos) t++;
+        double centre = tile_centre(t, size, tiles);
+        if (pos <= centre || t + 1 == tiles) {
+            blends[i].first = blends[i].second = t;
+            blends[i].weight = 256;
+        } else {
+            double next = tile_centre(t + 1, size, tiles);
+            blends[i].first = t;
+            blends[i].second = t + 1;
+            blends[i].weight = (int)((next - pos) / (next - centre) * 256.0 + 0.5);
+        }
+    }
+    return blends;
+}
+
+// Builds one LUT per tile from the gray image, tiles in parallel
+static uint8_t *tile_luts(t_bmp8 *gray, int tilesX, int tilesY, float clipLimit) {
+    uint8_t *luts = (uint8_t *)malloc((size_t)tilesX * tilesY * 256);
+    if (!luts) return NULL;
+    int width = (int)gray->width, height = (int)gray->height;
+    int failed = 0;
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int t = 0; t < tilesX * tilesY; t++) {
+        int tx = t % tilesX, ty = t / tilesX;
+        t_rect tile;
+        tile.x = (int)((long)tx * width / tilesX);
+        tile.y = (int)((long)ty * height / tilesY);
+        tile.width = (int)((long)(tx + 1) * width / tilesX) - tile.x;
+        tile.height = (int)((long)(ty + 1) * height / tilesY) - tile.y;
+
+        unsigned int *hist = bmp8_computeHistogramRegion(gray, &tile);
+        unsigned int *map = NULL;
+        if (hist) {
+            if (clipLimit > 0.0f) {
+                float limit = clipLimit * (float)tile.width * (float)tile.height / 256.0f;
+                clip_histogram(hist, limit < 1.0f ? 1u : (unsigned int)limit);
+            }
+            map = bmp8_computeCDF(hist);
+        }
+        if (map) {
+            for (int i = 0; i < 256; i++) luts[(size_t)t * 256 + i] = (uint8_t)map[i];
+        } else {
+            #pragma omp atomic write
+            failed = 1;
+        }
+        free(hist);
+        free(map);
+    }
+    if (failed) {
+        free(luts);
+        return NULL;
+    }
+    return luts;
+}
+
+// Writes the equalized gray image into out_rows, indexed top-down
+static int clahe_remap(t_bmp8 *gray, int tilesX, int tilesY, float clipLimit, uint8_t **out_rows) {
+    int width = (int)gray->width, height = (int)gray->height;
+    if (tilesX < 1 || tilesY < 1 || tilesX > width || tilesY > height) {
+        fprintf(stderr, "Error: CLAHE needs between 1 and %d x %d tiles.\n", width, height);
+        return -1;
+    }
+    uint8_t *luts = tile_luts(gray, tilesX, tilesY, clipLimit);
+    t_tile_blend *cols = tile_blends(width, tilesX);
+    t_tile_blend *rows = tile_blends(height, tilesY);
+    if (!luts || !cols || !rows) {
+        fprintf(stderr, "Error: Failed to allocate memory for CLAHE.\n");
+        free(luts);
+        free(cols);
+        free(rows);
+        return -1;
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < height; y++) {
+        const uint8_t *src = gray->data + (size_t)(height - 1 - y) * width;
+        const uint8_t *top = luts + (size_t)rows[y].first * tilesX * 256;
+        const uint8_t *bottom = luts + (size_t)rows[y].second * tilesX * 256;
+        int wy = rows[y].weight;
+        for (int x = 0; x < width; x++) {
+            int v = src[x];
+            int wx = cols[x].weight;
+            int left = cols[x].first * 256 + v, right = cols[x].second * 256 + v;
+            int upper = top[left] * wx + top[right] * (256 - wx);
+            int lower = bottom[left] * wx + bottom[right] * (256 - wx);
+            out_rows[y][x] = (uint8_t)((upper * wy + lower * (256 - wy) + 32768) >> 16);
+        }
+    }
+    free(luts);
+    free(cols);
+    free(rows);
+    return 0;
+}
+
+int bmp8_clahe(t_bmp8 *img, int tilesX, int tilesY, float clipLimit) {
+    if (!img || !img->data) return -1;
+    uint8_t *result = (uint8_t *)malloc(img->dataSize);
+    uint8_t **rows = (uint8_t **)malloc(img->height * sizeof(uint8_t *));
+    if (!result || !rows) {
+        fprintf(stderr, "Error: Failed to allocate memory for CLAHE.\n");
+        free(result);
+        free(rows);
+        return -1;
+    }
+    // Rows are handed out top-down, t_bmp8 stores them bottom-up
+    for (unsigned int y = 0; y < img->height; y++) rows[y] = result + (size_t)(img->height - 1 - y) * img->width;
+    int status = clahe_remap(img, tilesX, tilesY, clipLimit, rows);
+    if (status == 0) memcpy(img->data, result, img->dataSize);
+    free(result);
+    free(rows);
+    return status;
+}
+
+int bmp24_clahe(t_bmp24 *img, int tilesX, int tilesY, float clipLimit) {
+    if (!img || !img->data) return -1;
+    t_bmp8 *luma = bmp24_toGray8(img, LUMA_BT601);
+    uint8_t *result = (uint8_t *)malloc((size_t)img->width * img->height);
+    uint8_t **rows = (uint8_t **)malloc(img->height * sizeof(uint8_t *));
+    if (!luma || !result || !rows) {
+        fprintf(stderr, "Error: Failed to allocate memory for CLAHE.\n");
+        bmp8_free(luma);
+        free(result);
+        free(rows);
+        return -1;
+    }
+    for (int y = 0; y < img->height; y++) rows[y] = result + (size_t)y * img->width;
+
+    int status = clahe_remap(luma, tilesX, tilesY, clipLimit, rows);
+    if (status == 0) {
+        #pragma omp parallel for schedule(static)
+        for (int y = 0; y < img->height; y++) {
+            const uint8_t *old_luma = luma->data + (size_t)(img->height - 1 - y) * img->width;
+            uint8_t *p = (uint8_t *)img->data[y];
+            for (int x = 0; x < img->width; x++) {
+                int delta = rows[y][x] - old_luma[x];
+                for (int c = 0; c < 3; c++) {
+                    int v = p[3 * x + c] + delta;
+                    p[3 * x + c] = (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+                }
+            }
+        }
+    }
+    bmp8_free(luma);
+    free(result);
+    free(rows);
+    return status;
+}
@@ -0,0 +1,21 @@
+#ifndef CLAHE_H
+#define CLAHE_H
+
+#include "bmp8.h"
+#include "bmp24.h"
+
+#define CLAHE_DEFAULT_TILES 8
+#define CLAHE_DEFAULT_CLIP 2.0f
+
+// Contrast limited adaptive histogram equalization. The image is split into tilesX x tilesY
+// tiles; each tile's histogram is clipped at clipLimit times the average bin count (the excess
+// is spread over all bins) and turned into an equalization LUT by bmp8_computeCDF. Every pixel
+// is then remapped by bilinear interpolation between the LUTs of the four nearest tile centres.
+// clipLimit <= 0 disables clipping (plain adaptive equalization).
+// bmp24 equalizes the BT.601 luma and shifts the three channels by the luma change, which
+// keeps the chroma differences.
+// Return 0 on success, -1 on error (bad tile counts, allocation failure), leaving img untouched.
+int bmp8_clahe(t_bmp8 *img, int tilesX, int tilesY, float clipLimit);
+int bmp24_clahe(t_bmp24 *img, int tilesX, int tilesY, float clipLimit);
+
+#endif // CLAHE_H
@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "server.h"
+
+// Client for the image_processing_in_c_final daemon (see server.h).
+//   image_processing_client <socket> <input.bmp> <output.bmp> <ops>
+//   image_processing_client <socket> bench <input.bmp> <output.bmp> <ops> [count] [program]
+// bench sends count requests over one connection, then runs "program run ..." count times as
+// separate processes, and compares the per-request latency of both.
+
+extern char **environ;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int connect_server(const char *socketPath) {
+    struct sockaddr_un addr;
+    if (strlen(socketPath) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: Socket path %s is too long.\n", socketPath);
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socketPath);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror("connect");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Sends one RUN request and waits for its answer line. Returns 0 if the server answered OK.
+static int send_request(int fd, FILE *in, const char *input, const char *output, const char *ops) {
+    char request[SERVER_MAX_REQUEST];
+    int len = snprintf(request, sizeof(request), "RUN\t%s\t%s\t%s\n", input, output, ops);
+    if (len <= 0 || len >= (int)sizeof(request)) {
+        fprintf(stderr, "Error: Request too long.\n");
+        return -1;
+    }
+    for (int sent = 0; sent < len;) {
+        ssize_t n = write(fd, request + sent, len - sent);
+        if (n <= 0) {
+            perror("write");
+            return -1;
+        }
+        sent += (int)n;
+    }
+    char answer[256];
+    if (!fgets(answer, sizeof(answer), in)) {
+        fprintf(stderr, "Error: Server closed the connection.\n");
+        return -1;
+    }
+    if (strncmp(answer, "OK", 2) != 0) {
+        fprintf(stderr, "Server: %s", answer);
+        return -1;
+    }
+    return 0;
+}
+
+static int run_one_shot(const char *program, const char *input, const char *output, const char *ops) {
+    char *args[] = {(char *)program, "run", (char *)input, (char *)output, (char *)ops, NULL};
+    pid_t pid;
+    if (posix_spawnp(&pid, program, NULL, NULL, args, environ) != 0) {
+        perror("posix_spawnp");
+        return -1;
+    }
+    int status;
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) return -1;
+    return 0;
+}
+
+static int run_benchmark(int fd, FILE *in, char **argv, int argc) {
+    const char *input = argv[3], *output = argv[4], *ops = argv[5];
+    int count = argc > 6 ? atoi(argv[6]) : 20;
+    const char *program = argc > 7 ? argv[7] : "./image_processing_in_c_final";
+    if (count <= 0) count = 1;
+
+    // The first request parses the chain and sizes the worker's buffers
+    if (send_request(fd, in, input, output, ops) != 0) return 1;
+    double best = 1e30, start = now_seconds();
+    for (int i = 0; i < count; i++) {
+        double t = now_seconds();
+        if (send_request(fd, in, input, output, ops) != 0) return 1;
+        t = now_seconds() - t;
+        if (t < best) best = t;
+    }
+    double daemon_mean = (now_seconds() - start) / count;
+    double daemon_best = best;
+
+    best = 1e30;
+    start = now_seconds();
+    for (int i = 0; i < count; i++) {
+        double t = now_seconds();
+        if (run_one_shot(program, input, output, ops) != 0) {
+            fprintf(stderr, "Error: %s run failed.\n", program);
+            return 1;
+        }
+        t = now_seconds() - t;
+        if (t < best) best = t;
+    }
+    double shot_mean = (now_seconds() - start) / count;
+
+    printf("%d requests, ops: %s\n", count, ops);
+    printf("%-10s %12s %12s\n", "mode", "mean (ms)", "best (ms)");
+    printf("%-10s %12.2f %12.2f\n", "daemon", daemon_mean * 1000.0, daemon_best * 1000.0);
+    printf("%-10s %12.2f %12.2f\n", "one-shot", shot_mean * 1000.0, best * 1000.0);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int bench = argc >= 6 && strcmp(argv[2], "bench") == 0;
+    if (!bench && argc != 5) {
+        printf("Usage:\n");
+        printf("  %s <socket> <input.bmp> <output.bmp> <ops>\n", argv[0]);
+        printf("  %s <socket> bench <input.bmp> <output.bmp> <ops> [count] [program]\n", argv[0]);
+        return 1;
+    }
+    int fd = connect_server(argv[1]);
+    if (fd < 0) return 1;
+    FILE *in = fdopen(dup(fd), "r");
+    if (!in) {
+        close(fd);
+        return 1;
+    }
+    int status = bench ? run_benchmark(fd, in, argv, argc) : (send_request(fd, in, argv[2], argv[3], argv[4]) != 0);
+    fclose(in);
+    close(fd);
+    return status;
+}
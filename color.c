@@ -0,0 +1,312 @@
+#include "color.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define COLOR_SHIFT 13
+#define COLOR_ROUND (1 << (COLOR_SHIFT - 1))
+
+// Linear colour spaces as 3x3 matrices in 1/8192 units, small enough for 16-bit multiplies
+// (SSE2 has no 32-bit one). Offsets fold in the rounding and the +16 / +128 biases of the
+// forward direction, or their removal in the inverse direction.
+typedef struct {
+    int16_t forward[3][3];      // c0, c1, c2 from R, G, B
+    int32_t forward_offset[3];
+    int16_t inverse[3][3];      // R, G, B from c0, c1, c2
+    int32_t inverse_offset[3];
+} t_color_matrix;
+
+static const t_color_matrix ycbcr_matrix = {
+    {{2449, 4809, 934}, {-1382, -2714, 4096}, {4096, -3430, -666}},
+    {COLOR_ROUND, (128 << COLOR_SHIFT) + COLOR_ROUND, (128 << COLOR_SHIFT) + COLOR_ROUND},
+    {{8192, 0, 11485}, {8192, -2819, -5850}, {8192, 14516, 0}},
+    {COLOR_ROUND - 11485 * 128, COLOR_ROUND + (2819 + 5850) * 128, COLOR_ROUND - 14516 * 128}
+};
+
+static const t_color_matrix yuv_matrix = {
+    {{2104, 4130, 802}, {-1214, -2384, 3598}, {3598, -3013, -585}},
+    {(16 << COLOR_SHIFT) + COLOR_ROUND, (128 << COLOR_SHIFT) + COLOR_ROUND, (128 << COLOR_SHIFT) + COLOR_ROUND},
+    {{9539, 0, 13075}, {9539, -3209, -6660}, {9539, 16525, 0}},
+    {COLOR_ROUND - 9539 * 16 - 13075 * 128, COLOR_ROUND - 9539 * 16 + (3209 + 6660) * 128,
+     COLOR_ROUND - 9539 * 16 - 16525 * 128}
+};
+
+// HSV tables, 12-bit fixed point: hue_scale[d] = (128 / 3) / d turns hue sectors into 1/256
+// turns, saturation_scale[m] = 255 / m
+#define HSV_SHIFT 12
+static int32_t hue_scale[256];
+static int32_t saturation_scale[256];
+static pthread_once_t hsv_once = PTHREAD_ONCE_INIT;
+
+static void hsv_init(void) {
+    hue_scale[0] = saturation_scale[0] = 0;
+    for (int i = 1; i < 256; i++) {
+        hue_scale[i] = (int32_t)(((128 << HSV_SHIFT) + (3 * i) / 2) / (3 * i));
+        saturation_scale[i] = (int32_t)(((255 << HSV_SHIFT) + i / 2) / i);
+    }
+}
+
+static inline uint8_t clamp_byte(int32_t v) {
+    return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+// BT.601 weights of the fine luma, in 1/65536
+#define LUMA_FINE_SHIFT 16
+#define LUMA_FINE_ROUND (1 << (LUMA_FINE_SHIFT - 1))
+
+static inline int32_t luma_fine(const uint8_t *bgr) {
+    return 7471 * bgr[0] + 38470 * bgr[1] + 19595 * bgr[2];
+}
+
+static void matrix_block(const int16_t m[3][3], const int32_t offset[3],
+                         const uint8_t *restrict a, const uint8_t *restrict b, const uint8_t *restrict c,
+                         uint8_t *restrict o0, uint8_t *restrict o1, uint8_t *restrict o2) {
+    for (int k = 0; k < COLOR_LANES; k++) {
+        int16_t x = a[k], y = b[k], z = c[k];
+        o0[k] = clamp_byte((m[0][0] * x + m[0][1] * y + m[0][2] * z + offset[0]) >> COLOR_SHIFT);
+        o1[k] = clamp_byte((m[1][0] * x + m[1][1] * y + m[1][2] * z + offset[1]) >> COLOR_SHIFT);
+        o2[k] = clamp_byte((m[2][0] * x + m[2][1] * y + m[2][2] * z + offset[2]) >> COLOR_SHIFT);
+    }
+}
+
+// Hue from the sector of the largest channel: (G - B) / delta around red, 2 + (B - R) / delta
+// around green, 4 + (R - G) / delta around blue, in sixths of a turn
+static void hsv_block(const uint8_t *restrict r, const uint8_t *restrict g, const uint8_t *restrict b,
+                      uint8_t *restrict h, uint8_t *restrict s, uint8_t *restrict v) {
+    for (int k = 0; k < COLOR_LANES; k++) {
+        int32_t max = r[k] > g[k] ? r[k] : g[k];
+        max = max > b[k] ? max : b[k];
+        int32_t min = r[k] < g[k] ? r[k] : g[k];
+        min = min < b[k] ? min : b[k];
+        int32_t delta = max - min;
+        int32_t sixths;
+        if (max == r[k]) sixths = g[k] - b[k];
+        else if (max == g[k]) sixths = 2 * delta + b[k] - r[k];
+        else sixths = 4 * delta + r[k] - g[k];
+        h[k] = (uint8_t)((sixths * hue_scale[delta] + (1 << (HSV_SHIFT - 1))) >> HSV_SHIFT);
+        s[k] = (uint8_t)((delta * saturation_scale[max] + (1 << (HSV_SHIFT - 1))) >> HSV_SHIFT);
+        v[k] = (uint8_t)max;
+    }
+}
+
+static void hsv_inverse_block(const uint8_t *restrict h, const uint8_t *restrict s, const uint8_t *restrict v,
+                              uint8_t *restrict r, uint8_t *restrict g, uint8_t *restrict b) {
+    for (int k = 0; k < COLOR_LANES; k++) {
+        int32_t turn = h[k] * 6;
+        int32_t sector = turn >> 8, fraction = turn & 255;
+        int32_t value = v[k], sat = s[k];
+        int32_t p = color_div255(value * (255 - sat));
+        int32_t q = color_div255(value * (255 - ((sat * fraction + 128) >> 8)));
+        int32_t t = color_div255(value * (255 - ((sat * (256 - fraction) + 128) >> 8)));
+        r[k] = (uint8_t)((sector == 0 || sector == 5) ? value : (sector == 1 ? q : (sector == 4 ? t : p)));
+        g[k] = (uint8_t)((sector == 1 || sector == 2) ? value : (sector == 0 ? t : (sector == 3 ? q : p)));
+        b[k] = (uint8_t)((sector == 3 || sector == 4) ? value : (sector == 2 ? t : (sector == 5 ? q : p)));
+    }
+}
+
+static const t_color_matrix *space_matrix(t_color_space space) {
+    return (space == COLOR_YUV) ? &yuv_matrix : &ycbcr_matrix;
+}
+
+static void forward_block(t_color_space space, const uint8_t *r, const uint8_t *g, const uint8_t *b,
+                          uint8_t *c0, uint8_t *c1, uint8_t *c2) {
+    if (space == COLOR_HSV) {
+        hsv_block(r, g, b, c0, c1, c2);
+    } else {
+        const t_color_matrix *m = space_matrix(space);
+        matrix_block(m->forward, m->forward_offset, r, g, b, c0, c1, c2);
+    }
+}
+
+static void inverse_block(t_color_space space, const uint8_t *c0, const uint8_t *c1, const uint8_t *c2,
+                          uint8_t *r, uint8_t *g, uint8_t *b) {
+    if (space == COLOR_HSV) {
+        hsv_inverse_block(c0, c1, c2, r, g, b);
+    } else {
+        const t_color_matrix *m = space_matrix(space);
+        matrix_block(m->inverse, m->inverse_offset, c0, c1, c2, r, g, b);
+    }
+}
+
+// Fixed-length splits and merges of packed BGR, so the compiler unrolls and vectorizes them
+static void split_block(const uint8_t *restrict p, uint8_t *restrict a, uint8_t *restrict b, uint8_t *restrict c) {
+    for (int k = 0; k < COLOR_LANES; k++) {
+        a[k] = p[3 * k];
+        b[k] = p[3 * k + 1];
+        c[k] = p[3 * k + 2];
+    }
+}
+
+static void merge_block(const uint8_t *restrict a, const uint8_t *restrict b, const uint8_t *restrict c,
+                        uint8_t *restrict p) {
+    for (int k = 0; k < COLOR_LANES; k++) {
+        p[3 * k] = a[k];
+        p[3 * k + 1] = b[k];
+        p[3 * k + 2] = c[k];
+    }
+}
+
+// Every kernel goes through blocks of COLOR_LANES pixels: split into local planes, convert,
+// merge back. The last partial block is staged through a zero padded buffer, which also keeps
+// the in-place variants from reading past the row.
+void color_fromBgrRow(t_color_space space, const uint8_t *bgr, uint8_t *c0, uint8_t *c1, uint8_t *c2, int width) {
+    if (space == COLOR_HSV) pthread_once(&hsv_once, hsv_init);
+    uint8_t r[COLOR_LANES], g[COLOR_LANES], b[COLOR_LANES];
+    uint8_t o0[COLOR_LANES], o1[COLOR_LANES], o2[COLOR_LANES];
+    uint8_t tail[3 * COLOR_LANES] = {0};
+    for (int x0 = 0; x0 < width; x0 += COLOR_LANES) {
+        int n = (width - x0 < COLOR_LANES) ? width - x0 : COLOR_LANES;
+        const uint8_t *p = bgr + 3 * (size_t)x0;
+        if (n < COLOR_LANES) p = memcpy(tail, p, 3 * (size_t)n);
+        split_block(p, b, g, r);
+        forward_block(space, r, g, b, o0, o1, o2);
+        memcpy(c0 + x0, o0, n);
+        memcpy(c1 + x0, o1, n);
+        memcpy(c2 + x0, o2, n);
+    }
+}
+
+void color_toBgrRow(t_color_space space, const uint8_t *c0, const uint8_t *c1, const uint8_t *c2, uint8_t *bgr,
+                    int width) {
+    uint8_t i0[COLOR_LANES] = {0}, i1[COLOR_LANES] = {0}, i2[COLOR_LANES] = {0};
+    uint8_t r[COLOR_LANES], g[COLOR_LANES], b[COLOR_LANES];
+    uint8_t tail[3 * COLOR_LANES];
+    for (int x0 = 0; x0 < width; x0 += COLOR_LANES) {
+        int n = (width - x0 < COLOR_LANES) ? width - x0 : COLOR_LANES;
+        memcpy(i0, c0 + x0, n);
+        memcpy(i1, c1 + x0, n);
+        memcpy(i2, c2 + x0, n);
+        inverse_block(space, i0, i1, i2, r, g, b);
+        uint8_t *p = bgr + 3 * (size_t)x0;
+        if (n == COLOR_LANES) {
+            merge_block(b, g, r, p);
+        } else {
+            merge_block(b, g, r, tail);
+            memcpy(p, tail, 3 * (size_t)n);
+        }
+    }
+}
+
+void color_fromBgrInPlace(t_color_space space, uint8_t *pixels, int width) {
+    if (space == COLOR_HSV) pthread_once(&hsv_once, hsv_init);
+    uint8_t r[COLOR_LANES], g[COLOR_LANES], b[COLOR_LANES];
+    uint8_t o0[COLOR_LANES], o1[COLOR_LANES], o2[COLOR_LANES];
+    uint8_t tail[3 * COLOR_LANES] = {0};
+    for (int x0 = 0; x0 < width; x0 += COLOR_LANES) {
+        int n = (width - x0 < COLOR_LANES) ? width - x0 : COLOR_LANES;
+        uint8_t *p = pixels + 3 * (size_t)x0;
+        uint8_t *block = (n == COLOR_LANES) ? p : memcpy(tail, p, 3 * (size_t)n);
+        split_block(block, b, g, r);
+        forward_block(space, r, g, b, o0, o1, o2);
+        merge_block(o0, o1, o2, block);
+        if (block == tail) memcpy(p, tail, 3 * (size_t)n);
+    }
+}
+
+void color_toBgrInPlace(t_color_space space, uint8_t *pixels, int width) {
+    uint8_t i0[COLOR_LANES], i1[COLOR_LANES], i2[COLOR_LANES];
+    uint8_t r[COLOR_LANES], g[COLOR_LANES], b[COLOR_LANES];
+    uint8_t tail[3 * COLOR_LANES] = {0};
+    for (int x0 = 0; x0 < width; x0 += COLOR_LANES) {
+        int n = (width - x0 < COLOR_LANES) ? width - x0 : COLOR_LANES;
+        uint8_t *p = pixels + 3 * (size_t)x0;
+        uint8_t *block = (n == COLOR_LANES) ? p : memcpy(tail, p, 3 * (size_t)n);
+        split_block(block, i0, i1, i2);
+        inverse_block(space, i0, i1, i2, r, g, b);
+        merge_block(b, g, r, block);
+        if (block == tail) memcpy(p, tail, 3 * (size_t)n);
+    }
+}
+
+// The weights of each mode sum to 256, so a white pixel stays 255; the mean uses
+// (s + 1) / 3 == roundf(s / 3.0f) written as a multiply and shift.
+// Plain loops over bytes so the compiler can vectorize them.
+void color_lumaRow(const uint8_t *bgr, uint8_t *gray, int width, t_luma_mode mode) {
+    if (mode == LUMA_MEAN) {
+        for (int x = 0; x < width; x++) {
+            unsigned int sum = bgr[3 * x] + bgr[3 * x + 1] + bgr[3 * x + 2] + 1u;
+            gray[x] = (uint8_t)((sum * 43691u) >> 17);
+        }
+        return;
+    }
+    unsigned int wr = (mode == LUMA_BT709) ? 54u : 77u;
+    unsigned int wg = (mode == LUMA_BT709) ? 183u : 150u;
+    unsigned int wb = (mode == LUMA_BT709) ? 19u : 29u;
+    for (int x = 0; x < width; x++) {
+        unsigned int luma = wb * bgr[3 * x] + wg * bgr[3 * x + 1] + wr * bgr[3 * x + 2] + 128u;
+        gray[x] = (uint8_t)(luma >> 8);
+    }
+}
+
+void color_fineLumaRow(const uint8_t *bgr, uint8_t *luma, int width) {
+    for (int x = 0; x < width; x++) luma[x] = clamp_byte((luma_fine(bgr + 3 * x) + LUMA_FINE_ROUND) >> LUMA_FINE_SHIFT);
+}
+
+void color_shiftLumaRow(uint8_t *bgr, const uint8_t *luma, const uint8_t map[256], int width) {
+    for (int x = 0; x < width; x++) {
+        uint8_t *p = bgr + 3 * x;
+        int32_t shift = ((int32_t)map[luma[x]] << LUMA_FINE_SHIFT) - luma_fine(p) + LUMA_FINE_ROUND;
+        for (int c = 0; c < 3; c++) p[c] = clamp_byte((((int32_t)p[c] << LUMA_FINE_SHIFT) + shift) >> LUMA_FINE_SHIFT);
+    }
+}
+
+void bmp24_toColorSpace(t_bmp24 *img, t_color_space space) {
+    if (!img || !img->data) return;
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < img->height; y++) color_fromBgrInPlace(space, (uint8_t *)img->data[y], img->width);
+}
+
+void bmp24_fromColorSpace(t_bmp24 *img, t_color_space space) {
+    if (!img || !img->data) return;
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < img->height; y++) color_toBgrInPlace(space, (uint8_t *)img->data[y], img->width);
+}
+
+t_planar_image *bmp24_toPlanar(const t_bmp24 *img, t_color_space space) {
+    if (!img || !img->data) return NULL;
+    t_planar_image *planar = (t_planar_image *)calloc(1, sizeof(t_planar_image));
+    if (!planar) {
+        fprintf(stderr, "Error: Failed to allocate memory for the planar image.\n");
+        return NULL;
+    }
+    size_t size = (size_t)img->width * img->height;
+    planar->width = img->width;
+    planar->height = img->height;
+    planar->space = space;
+    for (int c = 0; c < 3; c++) {
+        planar->planes[c] = (uint8_t *)malloc(size);
+        if (!planar->planes[c]) {
+            fprintf(stderr, "Error: Failed to allocate memory for the planar image.\n");
+            planar_free(planar);
+            return NULL;
+        }
+    }
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < img->height; y++) {
+        size_t offset = (size_t)y * img->width;
+        color_fromBgrRow(space, (const uint8_t *)img->data[y], planar->planes[0] + offset,
+                         planar->planes[1] + offset, planar->planes[2] + offset, img->width);
+    }
+    return planar;
+}
+
+int bmp24_fromPlanar(t_bmp24 *img, const t_planar_image *planar) {
+    if (!img || !img->data || !planar || img->width != planar->width || img->height != planar->height) {
+        fprintf(stderr, "Error: Planar image does not match the destination image.\n");
+        return -1;
+    }
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < img->height; y++) {
+        size_t offset = (size_t)y * img->width;
+        color_toBgrRow(planar->space, planar->planes[0] + offset, planar->planes[1] + offset,
+                       planar->planes[2] + offset, (uint8_t *)img->data[y], img->width);
+    }
+    return 0;
+}
+
+void planar_free(t_planar_image *planar) {
+    if (!planar) return;
+    for (int c = 0; c < 3; c++) free(planar->planes[c]);
+    free(planar);
+}
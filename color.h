@@ -0,0 +1,59 @@
+#ifndef COLOR_H
+#define COLOR_H
+
+#include <stdint.h>
+#include "bmp24.h"
+
+// Pixels converted together by the row kernels; the inner loops run over fixed blocks of this
+// many samples so the compiler turns them into SIMD code
+#define COLOR_LANES 16
+
+// round(x / 255) for 0 <= x <= 65535 + 127, without a division
+static inline unsigned int color_div255(unsigned int x) {
+    return (x + 128 + ((x + 128) >> 8)) >> 8;
+}
+
+// 8-bit colour spaces, channels listed in storage order
+typedef enum {
+    COLOR_YCBCR,    // Y, Cb, Cr: BT.601 full range (JPEG), chroma centred on 128
+    COLOR_YUV,      // Y, U, V: BT.601 studio range as used by video, Y in 16-235, U and V in 16-240
+    COLOR_HSV       // H, S, V: hue in 1/256 turns (0 red, ~85 green, ~171 blue), saturation, value
+} t_color_space;
+
+// A colour image split into three full resolution planes of width * height samples, top-down
+typedef struct {
+    int width;
+    int height;
+    t_color_space space;
+    uint8_t *planes[3];
+} t_planar_image;
+
+// Streaming row kernels: width packed BGR pixels to or from three planes. The matrix spaces use
+// 13-bit fixed point with rounding, HSV uses reciprocal tables instead of divisions. Round trips
+// stay within 1 level for YCbCr, 2 for YUV and 4 for HSV, whose hue only has 256 steps.
+void color_fromBgrRow(t_color_space space, const uint8_t *bgr, uint8_t *c0, uint8_t *c1, uint8_t *c2, int width);
+void color_toBgrRow(t_color_space space, const uint8_t *c0, const uint8_t *c1, const uint8_t *c2, uint8_t *bgr,
+                    int width);
+// Interleaved variants, in place: each pixel's three bytes become c0, c1, c2 and back
+void color_fromBgrInPlace(t_color_space space, uint8_t *pixels, int width);
+void color_toBgrInPlace(t_color_space space, uint8_t *pixels, int width);
+// Luma of width packed BGR pixels, the row kernel behind grayscale and bmp24_toGray8
+void color_lumaRow(const uint8_t *bgr, uint8_t *gray, int width, t_luma_mode mode);
+// BT.601 luma from 16-bit weights, which sum to 1 << 16 so grays keep their level; the levels
+// bmp24_equalize bins pixels by
+void color_fineLumaRow(const uint8_t *bgr, uint8_t *luma, int width);
+// Moves the three channels of each pixel by map[luma[x]] minus its 16-bit luma, rounding once,
+// so a luma remapping keeps the chroma at full precision
+void color_shiftLumaRow(uint8_t *bgr, const uint8_t *luma, const uint8_t map[256], int width);
+
+// Whole images, rows in parallel. bmp24_toColorSpace leaves the converted channels in the
+// pixels (blue, green, red hold c0, c1, c2) until bmp24_fromColorSpace turns them back.
+void bmp24_toColorSpace(t_bmp24 *img, t_color_space space);
+void bmp24_fromColorSpace(t_bmp24 *img, t_color_space space);
+// Returns NULL on allocation failure
+t_planar_image *bmp24_toPlanar(const t_bmp24 *img, t_color_space space);
+// img must have the size of the planar image. Returns 0 on success, -1 on error.
+int bmp24_fromPlanar(t_bmp24 *img, const t_planar_image *planar);
+void planar_free(t_planar_image *planar);
+
+#endif // COLOR_H
@@ -0,0 +1,172 @@
+#include "edge.h"
+#include "color.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+// Fills dst[1..width] with top-down row y, dst[0] and dst[width + 1] replicate the edge pixels
+typedef void (*t_row_source)(const void *img, int y, uint8_t *dst);
+
+static void bmp8_row(const void *img, int y, uint8_t *dst) {
+    const t_bmp8 *gray = (const t_bmp8 *)img;
+    memcpy(dst + 1, gray->data + (size_t)(gray->height - 1 - y) * gray->width, gray->width);
+}
+
+static void bmp24_row(const void *img, int y, uint8_t *dst) {
+    const t_bmp24 *color = (const t_bmp24 *)img;
+    color_lumaRow((const uint8_t *)color->data[y], dst + 1, color->width, LUMA_BT601);
+}
+
+// Gx and Gy of one row from the padded rows above, at and below it. Both operators are
+// [a b a] smoothing times [-1 0 1] differences. Rows are processed in blocks of EDGE_LANES
+// samples, with every buffer padded to whole blocks, so the fixed-length inner loops vectorize.
+static void row_gradients(const uint8_t *restrict up, const uint8_t *restrict mid, const uint8_t *restrict down,
+                          int16_t *restrict gx, int16_t *restrict gy, int span, int a, int b) {
+    for (int x0 = 0; x0 < span; x0 += EDGE_LANES) {
+        for (int k = 0; k < EDGE_LANES; k++) {
+            int x = x0 + k;
+            gx[x] = (int16_t)(a * (up[x + 2] - up[x]) + b * (mid[x + 2] - mid[x]) + a * (down[x + 2] - down[x]));
+            gy[x] = (int16_t)(a * (down[x] - up[x]) + b * (down[x + 1] - up[x + 1]) + a * (down[x + 2] - up[x + 2]));
+        }
+    }
+}
+
+// |v| without a branch or an abs instruction, which SSE2 lacks for 16-bit lanes
+static inline int abs16(int16_t v) {
+    int sign = v >> 15;
+    return (v ^ sign) - sign;
+}
+
+static void row_magnitude(const int16_t *restrict gx, const int16_t *restrict gy, uint8_t *restrict out,
+                          int span, t_magnitude_mode mode, int shift) {
+    int round = (1 << shift) >> 1;
+    if (mode == MAGNITUDE_EXACT) {
+        // Not vectorized: sqrtf may set errno unless built with -fno-math-errno
+        float scale = 1.0f / (float)(1 << shift);
+        for (int x = 0; x < span; x++) {
+            float m = sqrtf((float)(gx[x] * gx[x] + gy[x] * gy[x])) * scale + 0.5f;
+            out[x] = (uint8_t)(m > 255.0f ? 255.0f : m);
+        }
+        return;
+    }
+    for (int x0 = 0; x0 < span; x0 += EDGE_LANES) {
+        for (int k = 0; k < EDGE_LANES; k++) {
+            int ax = abs16(gx[x0 + k]), ay = abs16(gy[x0 + k]);
+            int m;
+            if (mode == MAGNITUDE_APPROX) {
+                int hi = ax > ay ? ax : ay, lo = ax > ay ? ay : ax;
+                m = (((30 * hi + 15 * lo + 16) >> 5) + round) >> shift;
+            } else {
+                m = (ax + ay + round) >> shift;
+            }
+            out[x0 + k] = (uint8_t)(m > 255 ? 255 : m);
+        }
+    }
+}
+
+// Sector of the gradient angle, boundaries at 22.5 and 67.5 degrees: tan(22.5) ~ 106/256 and
+// tan(67.5) ~ 618/256
+static void row_direction(const int16_t *restrict gx, const int16_t *restrict gy, uint8_t *restrict out, int span) {
+    for (int x0 = 0; x0 < span; x0 += EDGE_LANES) {
+        for (int k = 0; k < EDGE_LANES; k++) {
+            int vx = gx[x0 + k], vy = gy[x0 + k];
+            int ax = abs16(gx[x0 + k]), ay = abs16(gy[x0 + k]) * 256;
+            int diagonal = ((vx ^ vy) >= 0) ? DIRECTION_DIAGONAL : DIRECTION_ANTIDIAGONAL;
+            int d = (ay >= ax * 618) ? DIRECTION_VERTICAL : diagonal;
+            out[x0 + k] = (uint8_t)((ay <= ax * 106) ? DIRECTION_HORIZONTAL : d);
+        }
+    }
+}
+
+// Each band keeps a ring of three padded source rows, so every source row is read (and for
+// bmp24 converted to luma) once per band plus the two rows it shares with its neighbours
+static t_bmp8 *gradient(const void *img, t_row_source source, int width, int height, t_edge_operator op,
+                        t_magnitude_mode mode, t_bmp8 **direction) {
+    if (direction) *direction = NULL;
+    int a = (op == EDGE_SCHARR) ? 3 : 1;
+    int b = (op == EDGE_SCHARR) ? 10 : 2;
+    int shift = (op == EDGE_SCHARR) ? 2 : 0;
+
+    t_bmp8 *magnitude = bmp8_allocate((unsigned int)width, (unsigned int)height);
+    t_bmp8 *sectors = direction ? bmp8_allocate((unsigned int)width, (unsigned int)height) : NULL;
+    if (!magnitude || (direction && !sectors)) {
+        bmp8_free(magnitude);
+        bmp8_free(sectors);
+        return NULL;
+    }
+
+    int bands = (height + EDGE_BAND_ROWS - 1) / EDGE_BAND_ROWS;
+    int failed = 0;
+    #pragma omp parallel for schedule(dynamic)
+    for (int band = 0; band < bands; band++) {
+        int span = (width + EDGE_LANES - 1) / EDGE_LANES * EDGE_LANES;
+        size_t padded = (size_t)span + 2;
+        // Zeroed so that the padding past the row end holds defined values
+        uint8_t *ring = (uint8_t *)calloc(3 * padded, 1);
+        int16_t *gx = (int16_t *)malloc(span * sizeof(int16_t));
+        int16_t *gy = (int16_t *)malloc(span * sizeof(int16_t));
+        uint8_t *line = (uint8_t *)malloc(span);
+        if (!ring || !gx || !gy || !line) {
+            #pragma omp atomic write
+            failed = 1;
+            free(ring);
+            free(gx);
+            free(gy);
+            free(line);
+            continue;
+        }
+        int y0 = band * EDGE_BAND_ROWS;
+        int y1 = (y0 + EDGE_BAND_ROWS < height) ? y0 + EDGE_BAND_ROWS : height;
+        // Ring slot of source row y is (y - y0 + 1) % 3, rows outside of the image are clamped
+        for (int y = y0 - 1; y <= y1; y++) {
+            int src = y < 0 ? 0 : (y >= height ? height - 1 : y);
+            uint8_t *row = ring + (size_t)((y - y0 + 1) % 3) * padded;
+            source(img, src, row);
+            row[0] = row[1];
+            row[width + 1] = row[width];
+            if (y < y0 + 1) continue;
+
+            int out = y - 1;
+            const uint8_t *up = ring + (size_t)((out - y0) % 3) * padded;
+            const uint8_t *mid = ring + (size_t)((out - y0 + 1) % 3) * padded;
+            row_gradients(up, mid, row, gx, gy, span, a, b);
+            size_t offset = (size_t)(height - 1 - out) * width;
+            row_magnitude(gx, gy, line, span, mode, shift);
+            memcpy(magnitude->data + offset, line, width);
+            if (sectors) {
+                row_direction(gx, gy, line, span);
+                memcpy(sectors->data + offset, line, width);
+            }
+        }
+        free(line);
+        free(ring);
+        free(gx);
+        free(gy);
+    }
+    if (failed) {
+        fprintf(stderr, "Error: Failed to allocate memory for the gradient.\n");
+        bmp8_free(magnitude);
+        bmp8_free(sectors);
+        return NULL;
+    }
+    if (direction) *direction = sectors;
+    return magnitude;
+}
+
+t_bmp8 *bmp8_gradient(const t_bmp8 *img, t_edge_operator op, t_magnitude_mode mode, t_bmp8 **direction) {
+    if (!img || !img->data) {
+        fprintf(stderr, "Error: Cannot compute the gradient of a NULL image.\n");
+        return NULL;
+    }
+    return gradient(img, bmp8_row, (int)img->width, (int)img->height, op, mode, direction);
+}
+
+t_bmp8 *bmp24_gradient(const t_bmp24 *img, t_edge_operator op, t_magnitude_mode mode, t_bmp8 **direction) {
+    if (!img || !img->data) {
+        fprintf(stderr, "Error: Cannot compute the gradient of a NULL image.\n");
+        return NULL;
+    }
+    return gradient(img, bmp24_row, img->width, img->height, op, mode, direction);
+}
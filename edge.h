@@ -0,0 +1,41 @@
+#ifndef EDGE_H
+#define EDGE_H
+
+#include "bmp8.h"
+#include "bmp24.h"
+
+// Rows handled by one parallel work item
+#define EDGE_BAND_ROWS 64
+
+// Samples per block of the row loops
+#define EDGE_LANES 16
+
+typedef enum {
+    EDGE_SOBEL,     // [1 2 1] smoothing
+    EDGE_SCHARR     // [3 10 3] smoothing, more rotation invariant
+} t_edge_operator;
+
+typedef enum {
+    MAGNITUDE_L1,       // |Gx| + |Gy|
+    MAGNITUDE_APPROX,   // 15/16 max + 15/32 min of |Gx|, |Gy|, within -6.3% / +4.8% of the exact value
+    MAGNITUDE_EXACT     // sqrt(Gx^2 + Gy^2), rounded
+} t_magnitude_mode;
+
+// Quantized gradient directions written to the direction image, with y pointing down
+typedef enum {
+    DIRECTION_HORIZONTAL = 0,   // Gradient along x (vertical edge), also used where it is zero
+    DIRECTION_DIAGONAL = 1,     // Gradient towards bottom-right or top-left
+    DIRECTION_VERTICAL = 2,     // Gradient along y (horizontal edge)
+    DIRECTION_ANTIDIAGONAL = 3  // Gradient towards bottom-left or top-right
+} t_gradient_direction;
+
+// Gradient magnitude of an 8-bit image as a new image, computing Gx and Gy in the same sweep
+// over three rows at a time instead of two filter passes. Edges are replicated. Scharr results
+// are divided by 4 so that a step edge gives the same magnitude with either operator; values
+// above 255 saturate. When direction is not NULL it receives a new image of
+// t_gradient_direction values (0-3), or NULL on failure. Returns NULL on error.
+t_bmp8 *bmp8_gradient(const t_bmp8 *img, t_edge_operator op, t_magnitude_mode mode, t_bmp8 **direction);
+// Same on the BT.601 luma of a colour image, converted a row at a time as the sweep needs it
+t_bmp8 *bmp24_gradient(const t_bmp24 *img, t_edge_operator op, t_magnitude_mode mode, t_bmp8 **direction);
+
+#endif // EDGE_H
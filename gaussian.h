@@ -0,0 +1,21 @@
+#ifndef GAUSSIAN_H
+#define GAUSSIAN_H
+
+#include "bmp8.h"
+#include "bmp24.h"
+
+// Smallest sigma the recursive approximation is designed for
+#define GAUSSIAN_MIN_SIGMA 0.5f
+
+// Columns handled together by the vertical pass
+#define GAUSSIAN_STRIP 64
+
+// Gaussian blur of any sigma at a fixed cost per pixel: Young-van Vliet third order recursive
+// filter, run causally then anticausally along rows, then down columns. Borders are treated as
+// a constant extension of the edge pixels, with the anticausal pass started from the exact
+// steady state (Triggs-Sdika) so edges are not darkened or smeared. bmp24 is filtered per
+// channel. Returns 0 on success, -1 on invalid sigma or allocation failure.
+int bmp8_gaussianBlur(t_bmp8 *img, float sigma);
+int bmp24_gaussianBlur(t_bmp24 *img, float sigma);
+
+#endif // GAUSSIAN_H
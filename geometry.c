@@ -0,0 +1,336 @@
+#include "geometry.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Rows of a transpose as seen by the traversal: dst[x][y] = src[y][x], every element size
+// bytes. Rotations reverse one of the two row tables, which turns them into plain transposes.
+typedef struct {
+    uint8_t *const *src;
+    uint8_t *const *dst;
+    int width;          // Of the source
+    int height;
+    int size;           // Bytes per pixel: 1 or 3
+} t_transpose;
+
+// 8x8 bytes at (x, y) of the source, as eight 64-bit rows moved through SSE2 unpacks
+static void tile8_bytes(const t_transpose *t, int x, int y) {
+#ifdef __SSE2__
+    __m128i r0 = _mm_loadl_epi64((const __m128i *)(t->src[y] + x));
+    __m128i r1 = _mm_loadl_epi64((const __m128i *)(t->src[y + 1] + x));
+    __m128i r2 = _mm_loadl_epi64((const __m128i *)(t->src[y + 2] + x));
+    __m128i r3 = _mm_loadl_epi64((const __m128i *)(t->src[y + 3] + x));
+    __m128i r4 = _mm_loadl_epi64((const __m128i *)(t->src[y + 4] + x));
+    __m128i r5 = _mm_loadl_epi64((const __m128i *)(t->src[y + 5] + x));
+    __m128i r6 = _mm_loadl_epi64((const __m128i *)(t->src[y + 6] + x));
+    __m128i r7 = _mm_loadl_epi64((const __m128i *)(t->src[y + 7] + x));
+    __m128i a0 = _mm_unpacklo_epi8(r0, r1);
+    __m128i a1 = _mm_unpacklo_epi8(r2, r3);
+    __m128i a2 = _mm_unpacklo_epi8(r4, r5);
+    __m128i a3 = _mm_unpacklo_epi8(r6, r7);
+    __m128i b0 = _mm_unpacklo_epi16(a0, a1);    // Columns 0-3 of rows 0-3
+    __m128i b1 = _mm_unpackhi_epi16(a0, a1);    // Columns 4-7 of rows 0-3
+    __m128i b2 = _mm_unpacklo_epi16(a2, a3);
+    __m128i b3 = _mm_unpackhi_epi16(a2, a3);
+    __m128i c0 = _mm_unpacklo_epi32(b0, b2);    // Columns 0 and 1
+    __m128i c1 = _mm_unpackhi_epi32(b0, b2);
+    __m128i c2 = _mm_unpacklo_epi32(b1, b3);
+    __m128i c3 = _mm_unpackhi_epi32(b1, b3);
+    _mm_storel_epi64((__m128i *)(t->dst[x] + y), c0);
+    _mm_storel_epi64((__m128i *)(t->dst[x + 1] + y), _mm_unpackhi_epi64(c0, c0));
+    _mm_storel_epi64((__m128i *)(t->dst[x + 2] + y), c1);
+    _mm_storel_epi64((__m128i *)(t->dst[x + 3] + y), _mm_unpackhi_epi64(c1, c1));
+    _mm_storel_epi64((__m128i *)(t->dst[x + 4] + y), c2);
+    _mm_storel_epi64((__m128i *)(t->dst[x + 5] + y), _mm_unpackhi_epi64(c2, c2));
+    _mm_storel_epi64((__m128i *)(t->dst[x + 6] + y), c3);
+    _mm_storel_epi64((__m128i *)(t->dst[x + 7] + y), _mm_unpackhi_epi64(c3, c3));
+#else
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 8; j++) t->dst[x + i][y + j] = t->src[y + j][x + i];
+    }
+#endif
+}
+
+// 8x8 pixels of 3 bytes. Each source row segment is read as three 64-bit words and its pixels
+// are shifted out of them; each pixel is then written as a 32-bit word. Rows are visited in
+// order, so along a destination row the fourth byte of every store is overwritten by the next
+// one, and the last row stores exactly 3 bytes so nothing outside the tile is touched.
+static void tile8_pixels(const t_transpose *t, int x, int y) {
+    uint8_t *dst[8];
+    for (int i = 0; i < 8; i++) dst[i] = t->dst[x + i] + (size_t)y * 3;
+    for (int j = 0; j < 8; j++) {
+        const uint8_t *src = t->src[y + j] + (size_t)x * 3;
+        uint64_t a, b, c;
+        memcpy(&a, src, 8);
+        memcpy(&b, src + 8, 8);
+        memcpy(&c, src + 16, 8);
+        uint32_t p[8] = {
+            (uint32_t)a, (uint32_t)(a >> 24), (uint32_t)((a >> 48) | (b << 16)), (uint32_t)(b >> 8),
+            (uint32_t)(b >> 32), (uint32_t)((b >> 56) | (c << 8)), (uint32_t)(c >> 16), (uint32_t)(c >> 40)
+        };
+        if (j < 7) {
+            for (int i = 0; i < 8; i++) memcpy(dst[i] + j * 3, &p[i], 4);
+        } else {
+            for (int i = 0; i < 8; i++) memcpy(dst[i] + 21, &p[i], 3);
+        }
+    }
+}
+
+// Block at (x0, y0) of the source; whole 8x8 tiles, then the ragged right and bottom edges
+static void transpose_leaf(const t_transpose *t, int x0, int y0, int w, int h) {
+    int tiled_w = w & ~7, tiled_h = h & ~7;
+    for (int y = y0; y < y0 + tiled_h; y += 8) {
+        for (int x = x0; x < x0 + tiled_w; x += 8) {
+            if (t->size == 1) tile8_bytes(t, x, y);
+            else tile8_pixels(t, x, y);
+        }
+    }
+    for (int y = y0; y < y0 + h; y++) {
+        int x_start = (y < y0 + tiled_h) ? x0 + tiled_w : x0;
+        for (int x = x_start; x < x0 + w; x++) {
+            memcpy(t->dst[x] + (size_t)y * t->size, t->src[y] + (size_t)x * t->size, t->size);
+        }
+    }
+}
+
+// Cache-oblivious: halves the longer side, cutting on a multiple of 8 so tiles stay whole
+static void transpose_block(const t_transpose *t, int x0, int y0, int w, int h) {
+    if (w <= GEOMETRY_LEAF && h <= GEOMETRY_LEAF) {
+        transpose_leaf(t, x0, y0, w, h);
+    } else if (w >= h) {
+        int half = ((w / 2) + 7) & ~7;
+        transpose_block(t, x0, y0, half, h);
+        transpose_block(t, x0 + half, y0, w - half, h);
+    } else {
+        int half = ((h / 2) + 7) & ~7;
+        transpose_block(t, x0, y0, w, half);
+        transpose_block(t, x0, y0 + half, w, h - half);
+    }
+}
+
+// Bands of source rows write disjoint column ranges of the destination
+static void transpose_rows(const t_transpose *t) {
+    int bands = (t->height + GEOMETRY_BAND_ROWS - 1) / GEOMETRY_BAND_ROWS;
+    #pragma omp parallel for schedule(dynamic)
+    for (int b = 0; b < bands; b++) {
+        int y0 = b * GEOMETRY_BAND_ROWS;
+        int h = (t->height - y0 < GEOMETRY_BAND_ROWS) ? t->height - y0 : GEOMETRY_BAND_ROWS;
+        transpose_block(t, 0, y0, t->width, h);
+    }
+}
+
+// dst[i] = src[count - 1 - i] for count bytes; dst and src must not overlap
+static void reverse_bytes(uint8_t *restrict dst, const uint8_t *restrict src, int count) {
+    int i = 0;
+#ifdef __SSE2__
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + count - i - 16));
+        v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128((__m128i *)(dst + i), v);
+    }
+#endif
+    for (; i < count; i++) dst[i] = src[count - 1 - i];
+}
+
+static void reverse_pixels(t_pixel *restrict dst, const t_pixel *restrict src, int count) {
+    for (int i = 0; i < count; i++) dst[i] = src[count - 1 - i];
+}
+
+// In place, through a scratch copy of each half so the copies above can run on whole blocks
+static void reverse_row_in_place(uint8_t *row, int count, int size, uint8_t *scratch) {
+    size_t bytes = (size_t)count * size;
+    memcpy(scratch, row, bytes);
+    if (size == 1) reverse_bytes(row, scratch, count);
+    else reverse_pixels((t_pixel *)row, (const t_pixel *)scratch, count);
+}
+
+static void flip_rows_horizontal(uint8_t **rows, int width, int height, int size) {
+    #pragma omp parallel
+    {
+        uint8_t *scratch = (uint8_t *)malloc((size_t)width * size);
+        #pragma omp for schedule(static)
+        for (int y = 0; y < height; y++) {
+            if (scratch) {
+                reverse_row_in_place(rows[y], width, size, scratch);
+            } else {
+                for (int a = 0, b = width - 1; a < b; a++, b--) {
+                    uint8_t tmp[3];
+                    memcpy(tmp, rows[y] + (size_t)a * size, size);
+                    memcpy(rows[y] + (size_t)a * size, rows[y] + (size_t)b * size, size);
+                    memcpy(rows[y] + (size_t)b * size, tmp, size);
+                }
+            }
+        }
+        free(scratch);
+    }
+}
+
+// Swaps the contents of rows y and height - 1 - y
+static void flip_rows_vertical(uint8_t **rows, int width, int height, int size) {
+    size_t bytes = (size_t)width * size;
+    #pragma omp parallel
+    {
+        uint8_t tmp[4096];
+        #pragma omp for schedule(static)
+        for (int y = 0; y < height / 2; y++) {
+            uint8_t *a = rows[y], *b = rows[height - 1 - y];
+            for (size_t i = 0; i < bytes; i += sizeof(tmp)) {
+                size_t n = (bytes - i < sizeof(tmp)) ? bytes - i : sizeof(tmp);
+                memcpy(tmp, a + i, n);
+                memcpy(a + i, b + i, n);
+                memcpy(b + i, tmp, n);
+            }
+        }
+    }
+}
+
+// Row tables of a bmp8 image in top-down order; reversed gives them bottom-up
+static uint8_t **bmp8_rowTable(const t_bmp8 *img, int reversed) {
+    uint8_t **rows = (uint8_t **)malloc(img->height * sizeof(uint8_t *));
+    if (!rows) return NULL;
+    for (unsigned int y = 0; y < img->height; y++) {
+        unsigned int memory_row = reversed ? y : img->height - 1 - y;
+        rows[y] = img->data + (size_t)memory_row * img->width;
+    }
+    return rows;
+}
+
+// Transposes img into out, with the source or destination row table reversed
+static t_bmp8 *bmp8_transform(const t_bmp8 *img, int reverse_src, int reverse_dst) {
+    if (!img || !img->data) return NULL;
+    t_bmp8 *out = bmp8_allocate(img->height, img->width);
+    if (!out) return NULL;
+    memcpy(out->colorTable, img->colorTable, sizeof(img->colorTable));
+    uint8_t **src = bmp8_rowTable(img, reverse_src);
+    uint8_t **dst = bmp8_rowTable(out, reverse_dst);
+    if (!src || !dst) {
+        fprintf(stderr, "Error: Failed to allocate memory for row tables.\n");
+        free(src);
+        free(dst);
+        bmp8_free(out);
+        return NULL;
+    }
+    t_transpose t = {src, dst, (int)img->width, (int)img->height, 1};
+    transpose_rows(&t);
+    free(src);
+    free(dst);
+    return out;
+}
+
+static t_bmp24 *bmp24_transform(const t_bmp24 *img, int reverse_src, int reverse_dst) {
+    if (!img || !img->data) return NULL;
+    t_bmp24 *out = bmp24_allocate(img->height, img->width, DEFAULT_DEPTH);
+    if (!out) return NULL;
+    uint8_t **src = (uint8_t **)malloc(img->height * sizeof(uint8_t *));
+    uint8_t **dst = (uint8_t **)malloc(out->height * sizeof(uint8_t *));
+    if (!src || !dst) {
+        fprintf(stderr, "Error: Failed to allocate memory for row tables.\n");
+        free(src);
+        free(dst);
+        bmp24_free(out);
+        return NULL;
+    }
+    for (int y = 0; y < img->height; y++) src[y] = (uint8_t *)img->data[reverse_src ? img->height - 1 - y : y];
+    for (int y = 0; y < out->height; y++) dst[y] = (uint8_t *)out->data[reverse_dst ? out->height - 1 - y : y];
+    t_transpose t = {src, dst, img->width, img->height, 3};
+    transpose_rows(&t);
+    free(src);
+    free(dst);
+    return out;
+}
+
+t_bmp8 *bmp8_transpose(const t_bmp8 *img) {
+    return bmp8_transform(img, 0, 0);
+}
+
+t_bmp24 *bmp24_transpose(const t_bmp24 *img) {
+    return bmp24_transform(img, 0, 0);
+}
+
+// Turning 90 degrees clockwise sends source row y to destination column height - 1 - y, which
+// is a transpose of the rows taken bottom to top. 270 degrees reverses the destination instead.
+t_bmp8 *bmp8_rotate(const t_bmp8 *img, int degrees) {
+    if (!img || !img->data) return NULL;
+    if (degrees == 90) return bmp8_transform(img, 1, 0);
+    if (degrees == 270) return bmp8_transform(img, 0, 1);
+    if (degrees != 180) {
+        fprintf(stderr, "Error: Rotation must be 90, 180 or 270 degrees, not %d.\n", degrees);
+        return NULL;
+    }
+    t_bmp8 *out = bmp8_allocate(img->width, img->height);
+    if (!out) return NULL;
+    memcpy(out->colorTable, img->colorTable, sizeof(img->colorTable));
+    // Half a turn reverses the whole pixel array
+    int width = (int)img->width, height = (int)img->height;
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < height; y++) {
+        reverse_bytes(out->data + (size_t)y * width, img->data + (size_t)(height - 1 - y) * width, width);
+    }
+    return out;
+}
+
+t_bmp24 *bmp24_rotate(const t_bmp24 *img, int degrees) {
+    if (!img || !img->data) return NULL;
+    if (degrees == 90) return bmp24_transform(img, 1, 0);
+    if (degrees == 270) return bmp24_transform(img, 0, 1);
+    if (degrees != 180) {
+        fprintf(stderr, "Error: Rotation must be 90, 180 or 270 degrees, not %d.\n", degrees);
+        return NULL;
+    }
+    t_bmp24 *out = bmp24_allocate(img->width, img->height, DEFAULT_DEPTH);
+    if (!out) return NULL;
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < img->height; y++) {
+        reverse_pixels(out->data[y], img->data[img->height - 1 - y], img->width);
+    }
+    return out;
+}
+
+void bmp8_flipHorizontal(t_bmp8 *img) {
+    if (!img || !img->data) return;
+    uint8_t **rows = bmp8_rowTable(img, 0);
+    if (!rows) {
+        fprintf(stderr, "Error: Failed to allocate memory for row tables.\n");
+        return;
+    }
+    flip_rows_horizontal(rows, (int)img->width, (int)img->height, 1);
+    free(rows);
+}
+
+void bmp8_flipVertical(t_bmp8 *img) {
+    if (!img || !img->data) return;
+    uint8_t **rows = bmp8_rowTable(img, 0);
+    if (!rows) {
+        fprintf(stderr, "Error: Failed to allocate memory for row tables.\n");
+        return;
+    }
+    flip_rows_vertical(rows, (int)img->width, (int)img->height, 1);
+    free(rows);
+}
+
+void bmp24_flipHorizontal(t_bmp24 *img) {
+    if (!img || !img->data) return;
+    flip_rows_horizontal((uint8_t **)img->data, img->width, img->height, 3);
+}
+
+void bmp24_flipVertical(t_bmp24 *img) {
+    if (!img || !img->data) return;
+    if (img->view) {
+        // The rows belong to a buffer that must end up flipped too
+        flip_rows_vertical((uint8_t **)img->data, img->width, img->height, 3);
+        return;
+    }
+    // Each row is its own allocation, so swapping the pointers is enough
+    for (int a = 0, b = img->height - 1; a < b; a++, b--) {
+        t_pixel *tmp = img->data[a];
+        img->data[a] = img->data[b];
+        img->data[b] = tmp;
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include "bmp8.h"
+#include "bmp24.h"
+
+// Source rows handed to one thread by the rotations and transposes
+#define GEOMETRY_BAND_ROWS 256
+
+// Largest block (in pixels each way) the recursive traversal splits down to before copying
+// 8x8 tiles; small enough that the source and destination rows of a block stay in L1
+#define GEOMETRY_LEAF 32
+
+// Rotations and transposes build a new image, WxH becoming HxW for 90, 270 and the transpose.
+// The traversal halves the longer side of the block until it reaches GEOMETRY_LEAF, so each
+// cache level is used well without knowing its size, and moves 8x8 pixel tiles through SIMD
+// registers. degrees is clockwise and must be 90, 180 or 270. Return NULL on error.
+t_bmp8 *bmp8_rotate(const t_bmp8 *img, int degrees);
+t_bmp8 *bmp8_transpose(const t_bmp8 *img);
+t_bmp24 *bmp24_rotate(const t_bmp24 *img, int degrees);
+t_bmp24 *bmp24_transpose(const t_bmp24 *img);
+
+// Mirror the image in place: horizontal swaps left and right, vertical swaps top and bottom
+void bmp8_flipHorizontal(t_bmp8 *img);
+void bmp8_flipVertical(t_bmp8 *img);
+void bmp24_flipHorizontal(t_bmp24 *img);
+void bmp24_flipVertical(t_bmp24 *img);
+
+#endif // GEOMETRY_H
@@ -0,0 +1,368 @@
+#include "histogram.h"
+#include "color.h"
+#include "probe.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Gray values of width pixels of row y from column x, either in place or written to scratch,
+// which holds 6 * width bytes. Returns NULL if they cannot be read.
+typedef const uint8_t *(*t_fetch_gray)(const void *source, int y, int x, int width, uint8_t *scratch);
+
+typedef struct {
+    int fd;
+    t_bmp_probe probe;
+    size_t pitch;
+} t_file_source;
+
+static const uint8_t *fetch_bmp8(const void *source, int y, int x, int width, uint8_t *scratch) {
+    (void)width;
+    (void)scratch;
+    const t_bmp8 *img = (const t_bmp8 *)source;
+    return img->data + (size_t)(img->height - 1 - y) * img->width + x;
+}
+
+static const uint8_t *fetch_bmp24(const void *source, int y, int x, int width, uint8_t *scratch) {
+    const t_bmp24 *img = (const t_bmp24 *)source;
+    color_fineLumaRow((const uint8_t *)(img->data[y] + x), scratch, width);
+    return scratch;
+}
+
+static const uint8_t *fetch_file(const void *source, int y, int x, int width, uint8_t *scratch) {
+    const t_file_source *file = (const t_file_source *)source;
+    int bytes = file->probe.depth / 8;
+    int row = file->probe.topDown ? y : file->probe.height - 1 - y;
+    off_t position = (off_t)file->probe.dataOffset + (off_t)row * file->pitch + (off_t)x * bytes;
+    uint8_t *raw = bytes == 1 ? scratch : scratch + 3 * width;
+    if (pread(file->fd, raw, (size_t)width * bytes, position) != (ssize_t)width * bytes) return NULL;
+    if (bytes == 1) return raw;
+    color_fineLumaRow(raw, scratch, width);
+    return scratch;
+}
+
+// Scrambles a band or row number into the random start of its sample
+static uint32_t mix(uint32_t value) {
+    value ^= value >> 16;
+    value *= 0x7feb352du;
+    value ^= value >> 15;
+    value *= 0x846ca68bu;
+    value ^= value >> 16;
+    return value;
+}
+
+// Largest difference between two CDFs given as weighted counts
+static double cdf_distance(const double *a, const double *b) {
+    double totalA = 0.0, totalB = 0.0;
+    for (int v = 0; v < 256; v++) {
+        totalA += a[v];
+        totalB += b[v];
+    }
+    if (totalA <= 0.0 || totalB <= 0.0) return 0.0;
+    double cumA = 0.0, cumB = 0.0, distance = 0.0;
+    for (int v = 0; v < 256; v++) {
+        cumA += a[v];
+        cumB += b[v];
+        double d = fabs(cumA / totalA - cumB / totalB);
+        if (d > distance) distance = d;
+    }
+    return distance;
+}
+
+// Bands are sampled in parallel. Each band's counts are weighted by the pixels it stands for, so
+// the partial rows and blocks at the edges are not under-represented, and kept apart by the
+// parity of the band for the split-half error estimate.
+static unsigned int *sample_histogram(t_fetch_gray fetch, const void *source, int width, int height,
+                                      const t_rect *roi, double rate, t_sample_info *info) {
+    if (!(rate > 0.0 && rate <= 1.0)) {
+        fprintf(stderr, "Error: The sample rate must be above 0 and at most 1.\n");
+        return NULL;
+    }
+    unsigned int *hist = (unsigned int *)calloc(256, sizeof(unsigned int));
+    if (!hist) {
+        fprintf(stderr, "Error: Failed to allocate memory for histogram.\n");
+        return NULL;
+    }
+    t_sample_info summary = {0, 0, 0.0};
+    t_rect r;
+    if (!rect_clip(roi, width, height, &r)) {
+        if (info) *info = summary;
+        return hist;
+    }
+
+    double perBand = rate * HISTOGRAM_BAND;
+    int rowsPerBand = perBand >= 1.0 ? (int)(perBand + 0.5) : 1;
+    int blockStride = perBand >= 1.0 ? 1 : (int)(1.0 / perBand + 0.5);
+    int bands = (r.height + HISTOGRAM_BAND - 1) / HISTOGRAM_BAND;
+    int blocks = (r.width + HISTOGRAM_BLOCK - 1) / HISTOGRAM_BLOCK;
+
+    double halves[2][256] = {{0}};
+    unsigned long long sampled = 0;
+    int failed = 0;
+    #pragma omp parallel
+    {
+        double local[2][256] = {{0}};
+        unsigned long long localSampled = 0;
+        uint8_t *scratch = (uint8_t *)malloc((size_t)r.width * 6);
+        if (!scratch) {
+            #pragma omp atomic write
+            failed = 1;
+        }
+        #pragma omp for schedule(dynamic)
+        for (int band = 0; band < bands; band++) {
+            if (!scratch || failed) continue;
+            int y0 = r.y + band * HISTOGRAM_BAND;
+            int bandHeight = r.y + r.height - y0 < HISTOGRAM_BAND ? r.y + r.height - y0 : HISTOGRAM_BAND;
+            int rows = rowsPerBand < bandHeight ? rowsPerBand : bandHeight;
+            double start = (mix((uint32_t)band) & 0xffff) / 65536.0;
+            unsigned int counts[256] = {0};
+            unsigned long long bandSampled = 0;
+            for (int k = 0; k < rows && !failed; k++) {
+                int y = y0 + (int)((k + start) * bandHeight / rows);
+                if (blockStride == 1) {
+                    const uint8_t *gray = fetch(source, y, r.x, r.width, scratch);
+                    if (!gray) {
+                        #pragma omp atomic write
+                        failed = 1;
+                        break;
+                    }
+                    for (int x = 0; x < r.width; x++) counts[gray[x]]++;
+                    bandSampled += (unsigned long long)r.width;
+                    continue;
+                }
+                int phase = (int)(mix((uint32_t)y ^ 0x9e3779b9u) % (uint32_t)blockStride) % blocks;
+                for (int block = phase; block < blocks; block += blockStride) {
+                    int x = r.x + block * HISTOGRAM_BLOCK;
+                    int span = r.x + r.width - x < HISTOGRAM_BLOCK ? r.x + r.width - x : HISTOGRAM_BLOCK;
+                    const uint8_t *gray = fetch(source, y, x, span, scratch);
+                    if (!gray) {
+                        #pragma omp atomic write
+                        failed = 1;
+                        break;
+                    }
+                    for (int i = 0; i < span; i++) counts[gray[i]]++;
+                    bandSampled += (unsigned long long)span;
+                }
+            }
+            if (bandSampled == 0) continue;
+            double weight = (double)bandHeight * r.width / (double)bandSampled;
+            for (int v = 0; v < 256; v++) local[band & 1][v] += counts[v] * weight;
+            localSampled += bandSampled;
+        }
+        #pragma omp critical
+        {
+            for (int v = 0; v < 256; v++) {
+                halves[0][v] += local[0][v];
+                halves[1][v] += local[1][v];
+            }
+            sampled += localSampled;
+        }
+        free(scratch);
+    }
+    if (failed) {
+        fprintf(stderr, "Error: Failed to read the pixels of the histogram sample.\n");
+        free(hist);
+        return NULL;
+    }
+
+    for (int v = 0; v < 256; v++) hist[v] = (unsigned int)(halves[0][v] + halves[1][v] + 0.5);
+    summary.sampled = sampled;
+    summary.total = (unsigned long long)r.width * r.height;
+    if (sampled < summary.total) {
+        summary.errorBound = sqrt(log(2.0 / 0.05) / (2.0 * (double)sampled));
+        double split = bands > 1 ? cdf_distance(halves[0], halves[1]) / 2.0 : 0.0;
+        if (split > summary.errorBound) summary.errorBound = split;
+    }
+    if (info) *info = summary;
+    return hist;
+}
+
+unsigned int *bmp8_sampleHistogram(const t_bmp8 *img, const t_rect *roi, double rate, t_sample_info *info) {
+    if (!img || !img->data) return NULL;
+    return sample_histogram(fetch_bmp8, img, (int)img->width, (int)img->height, roi, rate, info);
+}
+
+unsigned int *bmp24_sampleLumaHistogram(const t_bmp24 *img, const t_rect *roi, double rate, t_sample_info *info) {
+    if (!img || !img->data) return NULL;
+    return sample_histogram(fetch_bmp24, img, img->width, img->height, roi, rate, info);
+}
+
+unsigned int *histogram_sampleFile(const char *filename, double rate, t_sample_info *info) {
+    t_file_source file;
+    if (bmp_probe(filename, &file.probe) != 0 || file.probe.format != IMAGE_FORMAT_BMP ||
+        file.probe.compression != 0 || (file.probe.depth != 8 && file.probe.depth != 24)) {
+        fprintf(stderr, "Error: %s is not an uncompressed 8-bit or 24-bit BMP file.\n", filename);
+        return NULL;
+    }
+    file.pitch = ((size_t)file.probe.width * (file.probe.depth / 8) + 3) & ~(size_t)3;
+    if ((long long)file.probe.dataOffset + (long long)file.pitch * file.probe.height > file.probe.fileSize) {
+        fprintf(stderr, "Error: %s is truncated.\n", filename);
+        return NULL;
+    }
+    file.fd = open(filename, O_RDONLY);
+    if (file.fd < 0) {
+        fprintf(stderr, "Error: Cannot open %s for reading.\n", filename);
+        return NULL;
+    }
+    unsigned int *hist = sample_histogram(fetch_file, &file, file.probe.width, file.probe.height, NULL, rate, info);
+    close(file.fd);
+    return hist;
+}
+
+double histogram_cdfError(const unsigned int *approx, const unsigned int *exact) {
+    if (!approx || !exact) return 1.0;
+    double a[256], b[256];
+    for (int v = 0; v < 256; v++) {
+        a[v] = approx[v];
+        b[v] = exact[v];
+    }
+    return cdf_distance(a, b);
+}
+
+// Derives everything but the histogram itself, which the caller has filled in
+static void finish_stats(t_channel_stats *stats) {
+    stats->count = 0;
+    stats->min = stats->max = 0;
+    double sum = 0.0, squares = 0.0;
+    for (int v = 0; v < 256; v++) {
+        unsigned long long n = stats->histogram[v];
+        if (n == 0) continue;
+        if (stats->count == 0) stats->min = v;
+        stats->max = v;
+        stats->count += n;
+        sum += (double)n * v;
+        squares += (double)n * v * v;
+    }
+    stats->mean = stats->count ? sum / stats->count : 0.0;
+    stats->variance = stats->count ? squares / stats->count - stats->mean * stats->mean : 0.0;
+    if (stats->variance < 0.0) stats->variance = 0.0;
+}
+
+void stats_fromHistogram(const unsigned int *hist, t_channel_stats *stats) {
+    for (int v = 0; v < 256; v++) stats->histogram[v] = hist ? hist[v] : 0;
+    finish_stats(stats);
+}
+
+int stats_percentile(const t_channel_stats *stats, double fraction) {
+    if (stats->count == 0) return 0;
+    if (fraction <= 0.0) return stats->min;
+    double target = fraction * (double)stats->count;
+    unsigned long long seen = 0;
+    for (int v = 0; v < 256; v++) {
+        seen += stats->histogram[v];
+        if ((double)seen >= target) return v;
+    }
+    return stats->max;
+}
+
+int bmp8_computeStats(const t_bmp8 *img, const t_rect *roi, t_image_stats *stats) {
+    if (!img || !img->data || !stats) return -1;
+    memset(stats, 0, sizeof(*stats));
+    stats->channels = 1;
+    t_rect r;
+    if (!rect_clip(roi, (int)img->width, (int)img->height, &r)) return 0;
+
+    #pragma omp parallel
+    {
+        unsigned long long local[256] = {0};
+        #pragma omp for schedule(static)
+        for (int y = r.y; y < r.y + r.height; y++) {
+            const uint8_t *row = img->data + (size_t)(img->height - 1 - y) * img->width + r.x;
+            for (int x = 0; x < r.width; x++) local[row[x]]++;
+        }
+        #pragma omp critical
+        for (int v = 0; v < 256; v++) stats->channel[0].histogram[v] += local[v];
+    }
+    finish_stats(&stats->channel[0]);
+    return 0;
+}
+
+int bmp24_computeStats(const t_bmp24 *img, const t_rect *roi, t_image_stats *stats) {
+    if (!img || !img->data || !stats) return -1;
+    memset(stats, 0, sizeof(*stats));
+    stats->channels = 3;
+    t_rect r;
+    if (!rect_clip(roi, img->width, img->height, &r)) return 0;
+
+    #pragma omp parallel
+    {
+        unsigned long long local[3][256] = {{0}};
+        #pragma omp for schedule(static)
+        for (int y = r.y; y < r.y + r.height; y++) {
+            const t_pixel *row = img->data[y] + r.x;
+            for (int x = 0; x < r.width; x++) {
+                local[0][row[x].blue]++;
+                local[1][row[x].green]++;
+                local[2][row[x].red]++;
+            }
+        }
+        #pragma omp critical
+        for (int c = 0; c < 3; c++)
+            for (int v = 0; v < 256; v++) stats->channel[c].histogram[v] += local[c][v];
+    }
+    for (int c = 0; c < 3; c++) finish_stats(&stats->channel[c]);
+    return 0;
+}
+
+// Stretch of [low, high] to [0, 255]; a channel with a single level is left as it is
+static void stretch_lut(int low, int high, uint8_t lut[256]) {
+    for (int v = 0; v < 256; v++) {
+        if (high <= low) {
+            lut[v] = (uint8_t)v;
+            continue;
+        }
+        int mapped = ((v - low) * 255 + (high - low) / 2) / (high - low);
+        if (v < low) mapped = 0;
+        lut[v] = (uint8_t)(mapped > 255 ? 255 : mapped);
+    }
+}
+
+static int check_clip(double clip) {
+    if (clip >= 0.0 && clip < 0.5) return 0;
+    fprintf(stderr, "Error: The auto-levels clip must be at least 0 and below 0.5.\n");
+    return -1;
+}
+
+int bmp8_autoLevels(t_bmp8 *img, double clip) {
+    t_image_stats stats;
+    if (check_clip(clip) != 0 || bmp8_computeStats(img, NULL, &stats) != 0) return -1;
+    uint8_t lut[256];
+    stretch_lut(stats_percentile(&stats.channel[0], clip), stats_percentile(&stats.channel[0], 1.0 - clip), lut);
+    size_t size = (size_t)img->width * img->height;
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < size; i++) img->data[i] = lut[img->data[i]];
+    return 0;
+}
+
+int bmp24_autoLevels(t_bmp24 *img, double clip, t_levels_mode mode) {
+    t_image_stats stats;
+    if (check_clip(clip) != 0 || bmp24_computeStats(img, NULL, &stats) != 0) return -1;
+    int low[3], high[3];
+    for (int c = 0; c < 3; c++) {
+        low[c] = stats_percentile(&stats.channel[c], clip);
+        high[c] = stats_percentile(&stats.channel[c], 1.0 - clip);
+    }
+    if (mode == LEVELS_LINKED) {
+        for (int c = 1; c < 3; c++) {
+            if (low[c] < low[0]) low[0] = low[c];
+            if (high[c] > high[0]) high[0] = high[c];
+        }
+        low[1] = low[2] = low[0];
+        high[1] = high[2] = high[0];
+    }
+    uint8_t lut[3][256];
+    for (int c = 0; c < 3; c++) stretch_lut(low[c], high[c], lut[c]);
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < img->height; y++) {
+        t_pixel *row = img->data[y];
+        for (int x = 0; x < img->width; x++) {
+            row[x].blue = lut[0][row[x].blue];
+            row[x].green = lut[1][row[x].green];
+            row[x].red = lut[2][row[x].red];
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include "bmp8.h"
+#include "bmp24.h"
+#include "rect.h"
+
+// Strata of the sampled histograms: bands of HISTOGRAM_BAND rows, whose sampled rows are read
+// in blocks of HISTOGRAM_BLOCK pixels
+#define HISTOGRAM_BAND 64
+#define HISTOGRAM_BLOCK 64
+
+// How far a sampled histogram can be trusted
+typedef struct {
+    unsigned long long sampled;     // Pixels read
+    unsigned long long total;       // Pixels of the image or region
+    // Estimated largest difference between the sampled and the exact CDF, as a fraction of the
+    // pixels: the larger of the 95% Dvoretzky-Kiefer-Wolfowitz bound for the sample size and half
+    // the distance between the CDFs of the even and the odd bands. 0 when every pixel was read.
+    double errorBound;
+} t_sample_info;
+
+// Approximate histograms from a stratified sample, scaled to the pixel count so they feed
+// bmp8_computeCDF, bmp8_equalize and bmp24_equalizeHistogram like exact ones. Every band of
+// HISTOGRAM_BAND rows contributes rate * HISTOGRAM_BAND evenly spaced rows from a random start;
+// below one row per band, each sampled row also skips blocks, so only about rate of the pixels is
+// read. rate is in (0, 1], and 1 reads every pixel and gives the exact histogram. The sample is
+// the same from run to run. roi is in top-left coordinates, NULL for the whole image; info may be
+// NULL. Return 256 counts to free(), or NULL on error.
+unsigned int *bmp8_sampleHistogram(const t_bmp8 *img, const t_rect *roi, double rate, t_sample_info *info);
+// Of the luma bmp24_equalize bins pixels by (color_fineLumaRow)
+unsigned int *bmp24_sampleLumaHistogram(const t_bmp24 *img, const t_rect *roi, double rate, t_sample_info *info);
+// Straight from an uncompressed 8-bit (colour indices) or 24-bit (luma) BMP file, reading only
+// the sampled blocks, so most of a huge file is never touched
+unsigned int *histogram_sampleFile(const char *filename, double rate, t_sample_info *info);
+
+// Largest difference between the CDFs of two histograms, as a fraction of their pixels: the
+// error of an approximate histogram against the exact one
+double histogram_cdfError(const unsigned int *approx, const unsigned int *exact);
+
+// Statistics of one channel, all derived from its exact histogram
+typedef struct {
+    unsigned long long histogram[256];
+    unsigned long long count;
+    int min;                // Both 0 when the channel is empty
+    int max;
+    double mean;
+    double variance;        // Of the population
+} t_channel_stats;
+
+// Per channel: gray levels or colour indices for 8-bit images, blue, green and red for 24-bit ones
+typedef struct {
+    int channels;
+    t_channel_stats channel[3];
+} t_image_stats;
+
+// How auto-levels stretches a colour image
+typedef enum {
+    LEVELS_PER_CHANNEL,     // Each channel on its own, which also corrects a colour cast
+    LEVELS_LINKED           // One stretch for all three, which keeps the hues
+} t_levels_mode;
+
+// Statistics of roi (NULL: the whole image) in one parallel pass over the pixels, which only
+// fills per-thread histograms. Return 0 on success, -1 on error.
+int bmp8_computeStats(const t_bmp8 *img, const t_rect *roi, t_image_stats *stats);
+int bmp24_computeStats(const t_bmp24 *img, const t_rect *roi, t_image_stats *stats);
+// Statistics of a histogram from elsewhere, e.g. a sampled one
+void stats_fromHistogram(const unsigned int *hist, t_channel_stats *stats);
+// Smallest level with at least fraction of the pixels at or below it; 0 gives the minimum,
+// 1 the maximum
+int stats_percentile(const t_channel_stats *stats, double fraction);
+
+// Auto-contrast: the levels below the clip percentile and above 1 - clip become 0 and 255, and
+// those between are stretched linearly, as one lookup table pass. clip is a fraction in
+// [0, 0.5), e.g. 0.005 to ignore a few outliers. Return 0 on success, -1 on error.
+int bmp8_autoLevels(t_bmp8 *img, double clip);
+int bmp24_autoLevels(t_bmp24 *img, double clip, t_levels_mode mode);
+
+#endif // HISTOGRAM_H
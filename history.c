@@ -0,0 +1,305 @@
+#include "history.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Row y of the image counted from the top, whatever the row order of its storage
+static uint8_t *image_row(const t_history *history, int y) {
+    if (history->img8) return history->img8->data + (size_t)(history->height - 1 - y) * history->width;
+    return (uint8_t *)history->img24->data[y];
+}
+
+static void tile_area(const t_history *history, int index, int *x, int *y, int *width, int *height) {
+    *x = (index % history->tilesX) * HISTORY_TILE;
+    *y = (index / history->tilesX) * HISTORY_TILE;
+    *width = history->width - *x < HISTORY_TILE ? history->width - *x : HISTORY_TILE;
+    *height = history->height - *y < HISTORY_TILE ? history->height - *y : HISTORY_TILE;
+}
+
+// Copy of the tile's pixels as the image holds them now. Bytes are counted by the caller, so
+// tiles can be copied from several threads.
+static t_tile *copy_tile(const t_history *history, int index) {
+    int x, y, width, height;
+    tile_area(history, index, &x, &y, &width, &height);
+    size_t rowBytes = (size_t)width * history->channels;
+    t_tile *tile = (t_tile *)malloc(sizeof(t_tile) + rowBytes * height);
+    if (!tile) return NULL;
+    tile->size = rowBytes * height;
+    for (int row = 0; row < height; row++)
+        memcpy(tile->pixels + row * rowBytes, image_row(history, y + row) + (size_t)x * history->channels, rowBytes);
+    return tile;
+}
+
+// 1 if the image still holds the pixels of the tile's copy
+static int same_tile(const t_history *history, int index, const t_tile *tile) {
+    int x, y, width, height;
+    tile_area(history, index, &x, &y, &width, &height);
+    size_t rowBytes = (size_t)width * history->channels;
+    for (int row = 0; row < height; row++) {
+        const uint8_t *pixels = image_row(history, y + row) + (size_t)x * history->channels;
+        if (memcmp(tile->pixels + row * rowBytes, pixels, rowBytes) != 0) return 0;
+    }
+    return 1;
+}
+
+static void restore_tile(const t_history *history, int index, const t_tile *tile) {
+    int x, y, width, height;
+    tile_area(history, index, &x, &y, &width, &height);
+    size_t rowBytes = (size_t)width * history->channels;
+    for (int row = 0; row < height; row++)
+        memcpy(image_row(history, y + row) + (size_t)x * history->channels, tile->pixels + row * rowBytes, rowBytes);
+}
+
+// Exchanges the tile's copy with the image's pixels, so one copy serves both undo and redo
+static void swap_tile(const t_history *history, int index, t_tile *tile) {
+    int x, y, width, height;
+    tile_area(history, index, &x, &y, &width, &height);
+    size_t rowBytes = (size_t)width * history->channels;
+    uint8_t row_copy[HISTORY_TILE * 3];
+    for (int row = 0; row < height; row++) {
+        uint8_t *pixels = image_row(history, y + row) + (size_t)x * history->channels;
+        uint8_t *saved = tile->pixels + row * rowBytes;
+        memcpy(row_copy, pixels, rowBytes);
+        memcpy(pixels, saved, rowBytes);
+        memcpy(saved, row_copy, rowBytes);
+    }
+}
+
+// Records a tile the history rewrote in the dirty region of the image, if it keeps one
+static void mark_tile(const t_history *history, int index) {
+    t_rect r;
+    tile_area(history, index, &r.x, &r.y, &r.width, &r.height);
+    dirty_add(history->img8 ? history->img8->dirty : history->img24->dirty, &r);
+}
+
+static void free_tile(t_history *history, t_tile *tile) {
+    if (!tile) return;
+    history->bytes -= (long long)tile->size;
+    free(tile);
+}
+
+static void release_step(t_history *history, t_history_step *step) {
+    for (int i = 0; i < step->count; i++) free_tile(history, step->tiles[i]);
+    free(step->indices);
+    free(step->tiles);
+    memset(step, 0, sizeof(*step));
+}
+
+static t_history_step *step_at(t_history *history, int position) {
+    return &history->steps[(history->first + position) % HISTORY_MAX_STEPS];
+}
+
+static void drop_oldest(t_history *history) {
+    release_step(history, step_at(history, 0));
+    history->first = (history->first + 1) % HISTORY_MAX_STEPS;
+    history->count--;
+    history->cursor--;
+}
+
+// Forgets the tiles copied for the edit in progress. With restore, they are put back first,
+// abandoning an edit that was never committed.
+static void drop_pending(t_history *history, int restore) {
+    for (int i = 0; i < history->pendingCount; i++) {
+        int index = history->pending[i];
+        if (restore && history->pendingTiles[i]) {
+            restore_tile(history, index, history->pendingTiles[i]);
+            mark_tile(history, index);
+        }
+        free_tile(history, history->pendingTiles[i]);
+        history->pendingTiles[i] = NULL;
+        history->isPending[index] = 0;
+    }
+    history->pendingCount = 0;
+}
+
+static t_history *create(t_bmp8 *img8, t_bmp24 *img24, int width, int height, int channels, long long limit) {
+    if (width <= 0 || height <= 0) {
+        fprintf(stderr, "Error: Cannot keep the history of an empty image.\n");
+        return NULL;
+    }
+    t_history *history = (t_history *)calloc(1, sizeof(t_history));
+    if (!history) {
+        fprintf(stderr, "Error: Failed to allocate memory for the history.\n");
+        return NULL;
+    }
+    history->img8 = img8;
+    history->img24 = img24;
+    history->width = width;
+    history->height = height;
+    history->channels = channels;
+    history->tilesX = (width + HISTORY_TILE - 1) / HISTORY_TILE;
+    history->tilesY = (height + HISTORY_TILE - 1) / HISTORY_TILE;
+    history->limit = limit;
+    size_t tiles = (size_t)history->tilesX * history->tilesY;
+    history->pending = (int *)malloc(tiles * sizeof(int));
+    history->pendingTiles = (t_tile **)calloc(tiles, sizeof(t_tile *));
+    history->isPending = (uint8_t *)calloc(tiles, 1);
+    if (!history->pending || !history->pendingTiles || !history->isPending) {
+        fprintf(stderr, "Error: Failed to allocate memory for the history.\n");
+        history_free(history);
+        return NULL;
+    }
+    return history;
+}
+
+t_history *history_createBmp8(t_bmp8 *img, long long limit) {
+    if (!img || !img->data) return NULL;
+    return create(img, NULL, (int)img->width, (int)img->height, 1, limit);
+}
+
+t_history *history_createBmp24(t_bmp24 *img, long long limit) {
+    if (!img || !img->data) return NULL;
+    return create(NULL, img, img->width, img->height, 3, limit);
+}
+
+void history_free(t_history *history) {
+    if (!history) return;
+    for (int i = 0; i < history->count; i++) release_step(history, step_at(history, i));
+    if (history->pendingTiles) drop_pending(history, 0);
+    free(history->pending);
+    free(history->pendingTiles);
+    free(history->isPending);
+    free(history);
+}
+
+int history_begin(t_history *history, const t_rect *area) {
+    if (!history) return -1;
+    t_rect clipped;
+    if (!rect_clip(area, history->width, history->height, &clipped)) return 0;
+
+    // Tiles an earlier call of this edit copied keep their older pixels
+    int firstCopy = history->pendingCount;
+    for (int ty = clipped.y / HISTORY_TILE; ty <= (clipped.y + clipped.height - 1) / HISTORY_TILE; ty++) {
+        for (int tx = clipped.x / HISTORY_TILE; tx <= (clipped.x + clipped.width - 1) / HISTORY_TILE; tx++) {
+            int index = ty * history->tilesX + tx;
+            if (history->isPending[index]) continue;
+            history->isPending[index] = 1;
+            history->pending[history->pendingCount++] = index;
+        }
+    }
+
+    int failed = 0;
+    long long bytes = 0;
+    #pragma omp parallel for schedule(dynamic) reduction(+:bytes)
+    for (int i = firstCopy; i < history->pendingCount; i++) {
+        t_tile *tile = copy_tile(history, history->pending[i]);
+        history->pendingTiles[i] = tile;
+        if (!tile) {
+            #pragma omp atomic write
+            failed = 1;
+            continue;
+        }
+        bytes += (long long)tile->size;
+    }
+    history->bytes += bytes;
+    if (failed) {
+        // None of this call stays pending
+        fprintf(stderr, "Error: Failed to allocate memory for the history.\n");
+        for (int i = firstCopy; i < history->pendingCount; i++) {
+            free_tile(history, history->pendingTiles[i]);
+            history->pendingTiles[i] = NULL;
+            history->isPending[history->pending[i]] = 0;
+        }
+        history->pendingCount = firstCopy;
+        return -1;
+    }
+    return 0;
+}
+
+int history_commit(t_history *history, const char *label) {
+    if (!history) return -1;
+    int pendingCount = history->pendingCount;
+    if (pendingCount == 0) return 0;
+
+    // Copies of tiles the edit left as they were are freed at once
+    long long freed = 0;
+    #pragma omp parallel for schedule(dynamic) reduction(+:freed)
+    for (int i = 0; i < pendingCount; i++) {
+        t_tile *tile = history->pendingTiles[i];
+        if (!same_tile(history, history->pending[i], tile)) continue;
+        freed += (long long)tile->size;
+        free(tile);
+        history->pendingTiles[i] = NULL;
+    }
+    history->bytes -= freed;
+
+    int changed = 0;
+    for (int i = 0; i < pendingCount; i++) {
+        if (history->pendingTiles[i]) changed++;
+    }
+    if (changed == 0) {
+        drop_pending(history, 0);
+        return 0;
+    }
+
+    t_history_step step = {0};
+    step.indices = (int *)malloc(changed * sizeof(int));
+    step.tiles = (t_tile **)malloc(changed * sizeof(t_tile *));
+    if (!step.indices || !step.tiles) {
+        // The image keeps the edit, which cannot be undone
+        fprintf(stderr, "Error: Failed to allocate memory for the history.\n");
+        free(step.indices);
+        free(step.tiles);
+        drop_pending(history, 0);
+        return -1;
+    }
+    for (int i = 0; i < pendingCount; i++) {
+        int index = history->pending[i];
+        history->isPending[index] = 0;
+        if (!history->pendingTiles[i]) continue;
+        step.indices[step.count] = index;
+        step.tiles[step.count] = history->pendingTiles[i];
+        step.count++;
+        history->pendingTiles[i] = NULL;
+    }
+    history->pendingCount = 0;
+    snprintf(step.label, sizeof(step.label), "%s", label ? label : "");
+
+    while (history->count > history->cursor) {
+        release_step(history, step_at(history, history->count - 1));
+        history->count--;
+    }
+    if (history->count == HISTORY_MAX_STEPS) drop_oldest(history);
+    *step_at(history, history->count) = step;
+    history->count++;
+    history->cursor++;
+
+    // The newest step is always kept, even alone over the limit
+    while (history->bytes > history->limit && history->cursor > 1) drop_oldest(history);
+    return 1;
+}
+
+// Undoes an applied step or redoes an undone one: the same swap either way
+static void apply_step(t_history *history, t_history_step *step) {
+    #pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < step->count; i++) swap_tile(history, step->indices[i], step->tiles[i]);
+    for (int i = 0; i < step->count; i++) mark_tile(history, step->indices[i]);
+}
+
+int history_undo(t_history *history) {
+    if (!history) return 0;
+    drop_pending(history, 1);
+    if (history->cursor == 0) return 0;
+    apply_step(history, step_at(history, history->cursor - 1));
+    history->cursor--;
+    return 1;
+}
+
+int history_redo(t_history *history) {
+    if (!history) return 0;
+    drop_pending(history, 1);
+    if (history->cursor == history->count) return 0;
+    apply_step(history, step_at(history, history->cursor));
+    history->cursor++;
+    return 1;
+}
+
+const char *history_undoLabel(const t_history *history) {
+    if (!history || history->cursor == 0) return NULL;
+    return history->steps[(history->first + history->cursor - 1) % HISTORY_MAX_STEPS].label;
+}
+
+const char *history_redoLabel(const t_history *history) {
+    if (!history || history->cursor == history->count) return NULL;
+    return history->steps[(history->first + history->cursor) % HISTORY_MAX_STEPS].label;
+}
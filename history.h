@@ -0,0 +1,84 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "bmp8.h"
+#include "bmp24.h"
+#include "rect.h"
+
+// Side of the square tiles the history saves, in pixels
+#define HISTORY_TILE 128
+
+// Steps kept at most, whatever their size
+#define HISTORY_MAX_STEPS 256
+
+// Memory bound used by the interactive menus
+#define HISTORY_DEFAULT_LIMIT (256LL * 1024 * 1024)
+
+// Copy of one tile of the image
+typedef struct {
+    size_t size;
+    uint8_t pixels[];   // Rows of the tile, top first, channels bytes per pixel
+} t_tile;
+
+// Edit that can be undone: the tiles it changed, each holding the pixels the image does not
+// show, from before the edit while it is applied and from after it once undone
+typedef struct {
+    char label[32];
+    int count;
+    int *indices;
+    t_tile **tiles;
+} t_history_step;
+
+// Undo/redo history of one image, which edits in place. It holds copies of the changed tiles
+// only, never a mirror of the image: history_begin copies the tiles of the area an edit is about
+// to write, and history_commit compares them with the image, frees those left unchanged and keeps
+// the rest as a new step, so both cost the size of the area passed. Undo and redo swap a step's
+// copies with the image's pixels, and trimming frees the oldest steps; their cost is
+// proportional to the tiles one step changed, not to the image, but it is a copy of those
+// tiles and not constant time. Steps are kept in a ring; once the copies exceed the memory
+// limit the oldest steps are dropped.
+typedef struct {
+    t_bmp8 *img8;               // Exactly one of the two is set
+    t_bmp24 *img24;
+    int width;
+    int height;
+    int channels;
+    int tilesX;
+    int tilesY;
+    int *pending;               // Tiles copied by history_begin for the edit in progress
+    t_tile **pendingTiles;
+    int pendingCount;
+    uint8_t *isPending;
+    t_history_step steps[HISTORY_MAX_STEPS];
+    int first;                  // Ring slot of the oldest step
+    int count;                  // Steps held
+    int cursor;                 // Steps applied; the rest can be redone
+    long long bytes;            // Pixels of all tile copies
+    long long limit;
+} t_history;
+
+// History of an image; the image must keep its size for as long as the history is used.
+// Returns NULL on error.
+t_history *history_createBmp8(t_bmp8 *img, long long limit);
+t_history *history_createBmp24(t_bmp24 *img, long long limit);
+void history_free(t_history *history);
+
+// Copies the tiles of area before an edit changes them; callers pass the rectangle they will
+// write, NULL only for whole-image edits. May be called several times for one edit. Returns 0 on
+// success, -1 on error.
+int history_begin(t_history *history, const t_rect *area);
+// Records the edit since history_begin as one step and drops the steps that could be redone.
+// Returns 1 if a step was recorded, 0 if the edit changed nothing, -1 on error.
+int history_commit(t_history *history, const char *label);
+// Return 1 if a step was undone or redone, 0 if there was none. The tiles they restore are added
+// to the image's dirty region, as an edit's would be.
+int history_undo(t_history *history);
+int history_redo(t_history *history);
+
+// Label of the step history_undo or history_redo would apply, NULL if there is none
+const char *history_undoLabel(const t_history *history);
+const char *history_redoLabel(const t_history *history);
+
+#endif // HISTORY_H
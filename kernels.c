@@ -0,0 +1,94 @@
+#include "kernels.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+float **create_kernel(int size, const float *values) {
+    if (size <= 0 || size % 2 == 0) {
+        fprintf(stderr, "Kernel size must be positive and odd.\n");
+        return NULL;
+    }
+    float **kernel = (float **)malloc(size * sizeof(float *));
+    if (!kernel) {
+        fprintf(stderr, "Failed to allocate kernel rows.\n");
+        return NULL;
+    }
+    for (int i = 0; i < size; i++) {
+        kernel[i] = (float *)malloc(size * sizeof(float));
+        if (!kernel[i]) {
+            fprintf(stderr, "Failed to allocate kernel col for row %d.\n", i);
+            for (int j = 0; j < i; j++) free(kernel[j]);
+            free(kernel);
+            return NULL;
+        }
+        if (values) {
+            for (int j = 0; j < size; j++) {
+                kernel[i][j] = values[i * size + j];
+            }
+        }
+    }
+    return kernel;
+}
+
+void free_kernel(float **kernel, int size) {
+    if (!kernel || size <= 0) return;
+    for (int i = 0; i < size; i++) {
+        free(kernel[i]);
+    }
+    free(kernel);
+}
+
+// Kernel Definitions
+const float box_blur_values_3x3[] = {
+    1.0f/9.0f, 1.0f/9.0f, 1.0f/9.0f,
+    1.0f/9.0f, 1.0f/9.0f, 1.0f/9.0f,
+    1.0f/9.0f, 1.0f/9.0f, 1.0f/9.0f
+};
+
+// Gaussian Blur (3x3)
+const float gaussian_blur_values_3x3[] = {
+    1.0f/16.0f, 2.0f/16.0f, 1.0f/16.0f,
+    2.0f/16.0f, 4.0f/16.0f, 2.0f/16.0f,
+    1.0f/16.0f, 2.0f/16.0f, 1.0f/16.0f
+};
+
+// Outline (3x3)
+const float outline_values_3x3[] = {
+    -1.0f, -1.0f, -1.0f,
+    -1.0f,  8.0f, -1.0f,
+    -1.0f, -1.0f, -1.0f
+};
+
+// Emboss (3x3)
+const float emboss_values_3x3[] = {
+    -2.0f, -1.0f,  0.0f,
+    -1.0f,  1.0f,  1.0f,
+     0.0f,  1.0f,  2.0f
+};
+
+// Sharpen (3x3)
+const float sharpen_values_3x3[] = {
+     0.0f, -1.0f,  0.0f,
+    -1.0f,  5.0f, -1.0f,
+     0.0f, -1.0f,  0.0f
+};
+
+const float *find_kernel_values(const char *name, int *size) {
+    static const struct {
+        const char *name;
+        const float *values;
+    } named_kernels[] = {
+        {"box", box_blur_values_3x3},
+        {"gaussian", gaussian_blur_values_3x3},
+        {"outline", outline_values_3x3},
+        {"emboss", emboss_values_3x3},
+        {"sharpen", sharpen_values_3x3},
+    };
+    for (size_t i = 0; i < sizeof(named_kernels) / sizeof(named_kernels[0]); i++) {
+        if (strcmp(name, named_kernels[i].name) == 0) {
+            if (size) *size = 3;
+            return named_kernels[i].values;
+        }
+    }
+    return NULL;
+}
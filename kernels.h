@@ -0,0 +1,17 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+float **create_kernel(int size, const float *values);
+void free_kernel(float **kernel, int size);
+
+// Kernel Definitions (3x3, row-major)
+extern const float box_blur_values_3x3[];
+extern const float gaussian_blur_values_3x3[];
+extern const float outline_values_3x3[];
+extern const float emboss_values_3x3[];
+extern const float sharpen_values_3x3[];
+
+// Looks a kernel up by name (box, gaussian, outline, emboss, sharpen), NULL if unknown
+const float *find_kernel_values(const char *name, int *size);
+
+#endif // KERNELS_H
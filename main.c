@@ -1,79 +1,28 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include "bmp8.h"
 #include "bmp24.h"
-
-float **create_kernel(int size, const float *values) {
-    if (size <= 0 || size % 2 == 0) {
-        fprintf(stderr, "Kernel size must be positive and odd.\n");
-        return NULL;
-    }
-    float **kernel = (float **)malloc(size * sizeof(float *));
-    if (!kernel) {
-        fprintf(stderr, "Failed to allocate kernel rows.\n");
-        return NULL;
-    }
-    for (int i = 0; i < size; i++) {
-        kernel[i] = (float *)malloc(size * sizeof(float));
-        if (!kernel[i]) {
-            fprintf(stderr, "Failed to allocate kernel col for row %d.\n", i);
-            for (int j = 0; j < i; j++) free(kernel[j]);
-            free(kernel);
-            return NULL;
-        }
-        if (values) {
-            for (int j = 0; j < size; j++) {
-                kernel[i][j] = values[i * size + j];
-            }
-        }
-    }
-    return kernel;
-}
-
-void free_kernel(float **kernel, int size) {
-    if (!kernel || size <= 0) return;
-    for (int i = 0; i < size; i++) {
-        free(kernel[i]);
-    }
-    free(kernel);
-}
-
-// Kernel Definitions
-const float box_blur_values_3x3[] = {
-    1.0f/9.0f, 1.0f/9.0f, 1.0f/9.0f,
-    1.0f/9.0f, 1.0f/9.0f, 1.0f/9.0f,
-    1.0f/9.0f, 1.0f/9.0f, 1.0f/9.0f
-};
-
-// Gaussian Blur (3x3)
-const float gaussian_blur_values_3x3[] = {
-    1.0f/16.0f, 2.0f/16.0f, 1.0f/16.0f,
-    2.0f/16.0f, 4.0f/16.0f, 2.0f/16.0f,
-    1.0f/16.0f, 2.0f/16.0f, 1.0f/16.0f
-};
-
-// Outline (3x3)
-const float outline_values_3x3[] = {
-    -1.0f, -1.0f, -1.0f,
-    -1.0f,  8.0f, -1.0f,
-    -1.0f, -1.0f, -1.0f
-};
-
-// Emboss (3x3)
-const float emboss_values_3x3[] = {
-    -2.0f, -1.0f,  0.0f,
-    -1.0f,  1.0f,  1.0f,
-     0.0f,  1.0f,  2.0f
-};
-
-// Sharpen (3x3)
-const float sharpen_values_3x3[] = {
-     0.0f, -1.0f,  0.0f,
-    -1.0f,  5.0f, -1.0f,
-     0.0f, -1.0f,  0.0f
-};
-
+#include "kernels.h"
+#include "resize.h"
+#include "pyramid.h"
+#include "pipeline.h"
+#include "server.h"
+#include "median.h"
+#include "clahe.h"
+#include "morphology.h"
+#include "gaussian.h"
+#include "edge.h"
+#include "cache.h"
+#include "probe.h"
+#include "catalog.h"
+#include "buffer.h"
+#include "geometry.h"
+#include "quantize.h"
+#include "history.h"
+#include "histogram.h"
+#include "blend.h"
 
 // Menu Functions
 void display_main_menu() {
@@ -84,17 +33,17 @@ void display_main_menu() {
 
 void display_operation_menu(const char* image_type) {
     printf("\n--- %s Image Operations ---\n", image_type);
-    printf("1. Open an image\n2. Save an image\n3. Apply a filter\n4. Display image information\n5. Return to Main Menu\n");
+    printf("1. Open an image\n2. Save an image\n3. Apply a filter\n4. Display image information\n5. Undo\n6. Redo\n7. Preview an op chain\n8. Return to Main Menu\n");
     printf(">>> Your choice: ");
 }
 
 void display_filter_menu_bmp8() {
-    printf("\n--- BMP8 Filters/Operations ---\n1. Negative\n2. Brightness\n3. Threshold\n4. Box Blur\n5. Gaussian Blur\n6. Outline\n7. Emboss\n8. Sharpen\n9. Histogram Equalization\n10. Return to BMP8 Menu\n");
+    printf("\n--- BMP8 Filters/Operations ---\n1. Negative\n2. Brightness\n3. Threshold\n4. Box Blur\n5. Gaussian Blur\n6. Outline\n7. Emboss\n8. Sharpen\n9. Histogram Equalization\n10. Resize\n11. Return to BMP8 Menu\n");
     printf(">>> Your choice: ");
 }
 
 void display_filter_menu_bmp24() {
-    printf("\n--- BMP24 Filters/Operations ---\n1. Negative\n2. Grayscale\n3. Brightness\n4. Box Blur\n5. Gaussian Blur\n6. Outline\n7. Emboss\n8. Sharpen\n9. Histogram Equalization\n10. Return to BMP24 Menu\n");
+    printf("\n--- BMP24 Filters/Operations ---\n1. Negative\n2. Grayscale\n3. Brightness\n4. Box Blur\n5. Gaussian Blur\n6. Outline\n7. Emboss\n8. Sharpen\n9. Histogram Equalization\n10. Resize\n11. Return to BMP24 Menu\n");
     printf(">>> Your choice: ");
 }
 
@@ -110,6 +59,23 @@ int get_int_input() {
     return -1; // Indicate error
 }
 
+// Asks for target dimensions and a resampling filter, returns 0 if the input is unusable
+int get_resize_input(int *width, int *height, t_resize_filter *filter) {
+    printf("New width: ");
+    *width = get_int_input();
+    printf("New height: ");
+    *height = get_int_input();
+    printf("Filter (1. Box, 2. Bilinear, 3. Bicubic, 4. Lanczos3): ");
+    int filter_choice = get_int_input();
+    if (*width <= 0 || *height <= 0 || filter_choice < 1 || filter_choice > 4) {
+        printf("Invalid resize parameters.\n");
+        return 0;
+    }
+    const t_resize_filter filters[] = {RESIZE_BOX, RESIZE_BILINEAR, RESIZE_BICUBIC, RESIZE_LANCZOS3};
+    *filter = filters[filter_choice - 1];
+    return 1;
+}
+
 void get_string_input(const char* prompt, char* buffer, int size) {
     printf("%s", prompt);
     if (fgets(buffer, size, stdin)) {
@@ -121,8 +87,170 @@ void get_string_input(const char* prompt, char* buffer, int size) {
 }
 
 
+// Undo and redo entries of the operation menus
+static void undo_menu_step(t_history *history, int redo) {
+    const char *label = redo ? history_redoLabel(history) : history_undoLabel(history);
+    if (!label) {
+        printf("Nothing to %s.\n", redo ? "redo" : "undo");
+        return;
+    }
+    if (redo) history_redo(history);
+    else history_undo(history);
+    printf("%s: %s.\n", redo ? "Redone" : "Undone", label);
+}
+
+// Asks for the rectangle a filter applies to. Returns area, or NULL for the whole image.
+static const t_rect *get_area_input(t_rect *area) {
+    char buffer[100];
+    get_string_input("Area as x y width height (empty for the whole image): ", buffer, sizeof(buffer));
+    if (sscanf(buffer, "%d %d %d %d", &area->x, &area->y, &area->width, &area->height) == 4) return area;
+    if (buffer[0]) printf("Invalid area, using the whole image.\n");
+    return NULL;
+}
+
+// Result of an op chain on the image being edited, rewritten to a file after every change.
+// The image's ops and the undo history add what they change to dirty, and only the footprint
+// of those rectangles is recomputed.
+typedef struct {
+    t_pipeline *plan;
+    char path[256];
+    t_dirty_region dirty;
+    t_bmp8 *result8;
+    t_bmp24 *result24;
+} t_preview;
+
+// The plan run on a copy of the image, what the preview must match
+static t_bmp8 *preview_full8(const t_pipeline *plan, const t_bmp8 *img) {
+    t_bmp8 *result = bmp8_allocate(img->width, img->height);
+    if (!result) return NULL;
+    memcpy(result->header, img->header, sizeof(result->header));
+    memcpy(result->colorTable, img->colorTable, sizeof(result->colorTable));
+    memcpy(result->data, img->data, img->dataSize);
+    if (pipeline_executeTiledBmp8(plan, result, 0) != 0) {
+        bmp8_free(result);
+        return NULL;
+    }
+    return result;
+}
+
+static t_bmp24 *preview_full24(const t_pipeline *plan, const t_bmp24 *img) {
+    t_bmp24 *result = bmp24_allocate(img->width, img->height, 24);
+    if (!result) return NULL;
+    for (int y = 0; y < img->height; y++) memcpy(result->data[y], img->data[y], img->width * sizeof(t_pixel));
+    if (pipeline_executeTiledBmp24(plan, result, 0) != 0) {
+        bmp24_free(result);
+        return NULL;
+    }
+    return result;
+}
+
+static void preview_stop(t_preview *preview, t_bmp8 *img8, t_bmp24 *img24) {
+    pipeline_free(preview->plan);
+    bmp8_free(preview->result8);
+    bmp24_free(preview->result24);
+    preview->plan = NULL;
+    preview->result8 = NULL;
+    preview->result24 = NULL;
+    if (img8) img8->dirty = NULL;
+    if (img24) img24->dirty = NULL;
+}
+
+static void preview_save(const t_preview *preview) {
+    if (preview->result8) bmp8_saveImage(preview->path, preview->result8);
+    else bmp24_saveImage(preview->result24, preview->path);
+}
+
+// Computes the preview of a newly loaded or resized image in full and starts tracking its changes
+static void preview_rebuild(t_preview *preview, t_bmp8 *img8, t_bmp24 *img24) {
+    if (!preview->plan) return;
+    bmp8_free(preview->result8);
+    bmp24_free(preview->result24);
+    preview->result8 = img8 ? preview_full8(preview->plan, img8) : NULL;
+    preview->result24 = img24 ? preview_full24(preview->plan, img24) : NULL;
+    if (!preview->result8 && !preview->result24) {
+        printf("Preview stopped.\n");
+        preview_stop(preview, img8, img24);
+        return;
+    }
+    dirty_clear(&preview->dirty);
+    if (img8) img8->dirty = &preview->dirty;
+    else img24->dirty = &preview->dirty;
+    preview_save(preview);
+    printf("Preview written to %s.\n", preview->path);
+}
+
+// Brings the preview up to date with the changes recorded since it was last written
+static void preview_refresh(t_preview *preview, t_bmp8 *img8, t_bmp24 *img24) {
+    if (!preview->plan || preview->dirty.count == 0) return;
+    int status = img8 ? pipeline_updateBmp8(preview->plan, img8, preview->result8, &preview->dirty)
+                      : pipeline_updateBmp24(preview->plan, img24, preview->result24, &preview->dirty);
+    dirty_clear(&preview->dirty);
+    if (status != 0) {
+        printf("Failed to update the preview.\n");
+        preview_rebuild(preview, img8, img24);
+        return;
+    }
+    preview_save(preview);
+    printf("Preview updated in %s.\n", preview->path);
+}
+
+// Compares the incrementally updated preview with the plan run on the whole image
+static void preview_check(const t_preview *preview, const t_bmp8 *img8, const t_bmp24 *img24) {
+    int same = 0;
+    if (img8) {
+        t_bmp8 *full = preview_full8(preview->plan, img8);
+        if (!full) return;
+        same = memcmp(full->data, preview->result8->data, full->dataSize) == 0;
+        bmp8_free(full);
+    } else {
+        t_bmp24 *full = preview_full24(preview->plan, img24);
+        if (!full) return;
+        same = 1;
+        for (int y = 0; y < img24->height && same; y++)
+            same = memcmp(full->data[y], preview->result24->data[y], img24->width * sizeof(t_pixel)) == 0;
+        bmp24_free(full);
+    }
+    printf("The preview %s a full recompute.\n", same ? "matches" : "DIFFERS FROM");
+}
+
+// Preview entry of the operation menus: starts, replaces, checks or stops the preview
+static void preview_menu(t_preview *preview, t_bmp8 *img8, t_bmp24 *img24) {
+    if (preview->plan) {
+        printf("1. New op chain\n2. Check the preview against a full recompute\n3. Stop the preview\n");
+        printf(">>> Your choice: ");
+        int action = get_int_input();
+        if (action == 2) {
+            preview_check(preview, img8, img24);
+            return;
+        }
+        if (action == 3) {
+            preview_stop(preview, img8, img24);
+            printf("Preview stopped.\n");
+            return;
+        }
+        if (action != 1) {
+            printf("Invalid choice.\n");
+            return;
+        }
+    }
+    char spec[256];
+    get_string_input("Op chain, as for run (e.g. gaussian,sharpen): ", spec, sizeof(spec));
+    t_pipeline *plan = pipeline_parse(spec);
+    if (!plan) return;
+    pipeline_optimize(plan);
+    get_string_input("Preview file path: ", preview->path, sizeof(preview->path));
+    preview_stop(preview, img8, img24);
+    preview->plan = plan;
+    preview_rebuild(preview, img8, img24);
+}
+
 void process_bmp8_menu() {
     t_bmp8 *img8 = NULL;
+    t_history *history = NULL;
+    t_preview preview = {0};
+    t_rect area_input;
+    const char *filter_names[] = {"Negative", "Brightness", "Threshold", "Box Blur", "Gaussian Blur",
+                                  "Outline", "Emboss", "Sharpen", "Histogram Equalization"};
     char filename[256];
     int choice;
 
@@ -140,8 +268,12 @@ void process_bmp8_menu() {
         switch (choice) {
             case 1: // Open image
                 if (img8) bmp8_free(img8);
+                history_free(history);
                 get_string_input("File path: ", filename, sizeof(filename));
                 img8 = bmp8_loadImage(filename);
+                history = history_createBmp8(img8, HISTORY_DEFAULT_LIMIT);
+                if (img8) preview_rebuild(&preview, img8, NULL);
+                else preview_stop(&preview, NULL, NULL);
                 if (img8) printf("Image loaded successfully!\n");
                 else printf("Failed to load image.\n");
                 break;
@@ -162,31 +294,37 @@ void process_bmp8_menu() {
                 int filter_choice;
                 display_filter_menu_bmp8();
                 filter_choice = get_int_input("");
+                // Filters edit the image in place; the tiles they change become one undo step
+                const t_rect *area = NULL;
+                if (filter_choice >= 1 && filter_choice <= 9) {
+                    area = get_area_input(&area_input);
+                    history_begin(history, area);
+                }
                 switch (filter_choice) {
-                    case 1: bmp8_negative(img8); printf("Negative filter applied.\n"); break;
+                    case 1: bmp8_negativeRegion(img8, area); printf("Negative filter applied.\n"); break;
                     case 2: {
                         int bright_val = get_int_input("Enter brightness value (-255 to 255): ");
-                        if (bright_val != -1) bmp8_brightness(img8, bright_val);
+                        if (bright_val != -1) bmp8_brightnessRegion(img8, bright_val, area);
                         printf("Brightness adjusted.\n");
                         break;
                     }
                     case 3: {
                         int thresh_val = get_int_input("Enter threshold value (0 to 255): ");
-                        if (thresh_val != -1) bmp8_threshold(img8, thresh_val);
+                        if (thresh_val != -1) bmp8_thresholdRegion(img8, thresh_val, area);
                         printf("Threshold applied.\n");
                         break;
                     }
-                    case 4: if(kernel_box) bmp8_applyFilter(img8, kernel_box, 3); printf("Box Blur applied.\n"); break;
-                    case 5: if(kernel_gaussian) bmp8_applyFilter(img8, kernel_gaussian, 3); printf("Gaussian Blur applied.\n"); break;
-                    case 6: if(kernel_outline) bmp8_applyFilter(img8, kernel_outline, 3); printf("Outline filter applied.\n"); break;
-                    case 7: if(kernel_emboss) bmp8_applyFilter(img8, kernel_emboss, 3); printf("Emboss filter applied.\n"); break;
-                    case 8: if(kernel_sharpen) bmp8_applyFilter(img8, kernel_sharpen, 3); printf("Sharpen filter applied.\n"); break;
+                    case 4: if(kernel_box) bmp8_applyFilterRegion(img8, kernel_box, 3, area); printf("Box Blur applied.\n"); break;
+                    case 5: if(kernel_gaussian) bmp8_applyFilterRegion(img8, kernel_gaussian, 3, area); printf("Gaussian Blur applied.\n"); break;
+                    case 6: if(kernel_outline) bmp8_applyFilterRegion(img8, kernel_outline, 3, area); printf("Outline filter applied.\n"); break;
+                    case 7: if(kernel_emboss) bmp8_applyFilterRegion(img8, kernel_emboss, 3, area); printf("Emboss filter applied.\n"); break;
+                    case 8: if(kernel_sharpen) bmp8_applyFilterRegion(img8, kernel_sharpen, 3, area); printf("Sharpen filter applied.\n"); break;
                     case 9: {
-                        unsigned int *hist = bmp8_computeHistogram(img8);
+                        unsigned int *hist = bmp8_computeHistogramRegion(img8, area);
                         if (hist) {
                             unsigned int *cdf_map = bmp8_computeCDF(hist);
                             if (cdf_map) {
-                                bmp8_equalize(img8, cdf_map);
+                                bmp8_equalizeRegion(img8, cdf_map, area);
                                 printf("Histogram equalization applied.\n");
                                 free(cdf_map);
                             } else {
@@ -198,23 +336,60 @@ void process_bmp8_menu() {
                         }
                         break;
                     }
-                    case 10: printf("Returning to BMP8 menu.\n"); break;
+                    case 10: {
+                        int new_width, new_height;
+                        t_resize_filter filter;
+                        if (get_resize_input(&new_width, &new_height, &filter)) {
+                            t_bmp8 *resized = bmp8_resize(img8, (unsigned int)new_width, (unsigned int)new_height, filter);
+                            if (resized) {
+                                bmp8_free(img8);
+                                img8 = resized;
+                                history_free(history);
+                                history = history_createBmp8(img8, HISTORY_DEFAULT_LIMIT);
+                                preview_rebuild(&preview, img8, NULL);
+                                printf("Image resized to %d x %d (undo history cleared).\n", new_width, new_height);
+                            } else {
+                                printf("Failed to resize image.\n");
+                            }
+                        }
+                        break;
+                    }
+                    case 11: printf("Returning to BMP8 menu.\n"); break;
                     default: printf("Invalid filter choice.\n"); break;
                 }
+                if (filter_choice >= 1 && filter_choice <= 9) {
+                    history_commit(history, filter_names[filter_choice - 1]);
+                    preview_refresh(&preview, img8, NULL);
+                }
                 break;
             case 4: // Display info
                 if (img8) bmp8_printInfo(img8);
                 else printf("No image loaded.\n");
                 break;
-            case 5: // Return to main menu
+            case 5: // Undo
+            case 6: // Redo
+                if (img8) {
+                    undo_menu_step(history, choice == 6);
+                    preview_refresh(&preview, img8, NULL);
+                } else {
+                    printf("No image loaded.\n");
+                }
+                break;
+            case 7: // Preview an op chain
+                if (img8) preview_menu(&preview, img8, NULL);
+                else printf("No image loaded.\n");
+                break;
+            case 8: // Return to main menu
                 printf("Returning to Main Menu...\n");
                 break;
             default:
                 printf("Invalid choice. Please try again.\n");
                 break;
         }
-    } while (choice != 5);
+    } while (choice != 8);
 
+    preview_stop(&preview, NULL, NULL);
+    history_free(history);
     if (img8) bmp8_free(img8);
     free_kernel(kernel_box, 3);
     free_kernel(kernel_gaussian, 3);
@@ -226,6 +401,11 @@ void process_bmp8_menu() {
 
 void process_bmp24_menu() {
     t_bmp24 *img24 = NULL;
+    t_history *history = NULL;
+    t_preview preview = {0};
+    t_rect area_input;
+    const char *filter_names[] = {"Negative", "Grayscale", "Brightness", "Box Blur", "Gaussian Blur",
+                                  "Outline", "Emboss", "Sharpen", "Histogram Equalization"};
     char filename[256];
     int choice;
 
@@ -235,9 +415,6 @@ void process_bmp24_menu() {
     float **kernel_emboss = create_kernel(3, emboss_values_3x3);
     float **kernel_sharpen = create_kernel(3, sharpen_values_3x3);
 
-    // Temporary image for convolution results
-    t_bmp24 *temp_img_for_conv = NULL;
-
     do {
         display_operation_menu("24-bit Color (BMP24)");
         choice = get_int_input("");
@@ -245,23 +422,14 @@ void process_bmp24_menu() {
         switch (choice) {
             case 1: // Open image
                 if (img24) bmp24_free(img24);
-                if (temp_img_for_conv) bmp24_free(temp_img_for_conv); temp_img_for_conv = NULL;
-
+                history_free(history);
                 get_string_input("File path: ", filename, sizeof(filename));
                 img24 = bmp24_loadImage(filename);
-                if (img24) {
-                    printf("Image loaded successfully!\n");
-                    // Allocate temp image for convolution
-                    temp_img_for_conv = bmp24_allocate(img24->width, img24->height, img24->colorDepth);
-                    if (!temp_img_for_conv) {
-                        printf("Warning: Could not allocate temporary image for convolution.\n");
-                    } else {
-                        temp_img_for_conv->header = img24->header;
-                        temp_img_for_conv->header_info = img24->header_info;
-                    }
-                } else {
-                    printf("Failed to load image.\n");
-                }
+                history = history_createBmp24(img24, HISTORY_DEFAULT_LIMIT);
+                if (img24) preview_rebuild(&preview, NULL, img24);
+                else preview_stop(&preview, NULL, NULL);
+                if (img24) printf("Image loaded successfully!\n");
+                else printf("Failed to load image.\n");
                 break;
             case 2: // Save image
                 if (!img24) {
@@ -280,12 +448,17 @@ void process_bmp24_menu() {
                 int filter_choice;
                 display_filter_menu_bmp24();
                 filter_choice = get_int_input("");
+                const t_rect *area = NULL;
+                if (filter_choice >= 1 && filter_choice <= 9) {
+                    area = get_area_input(&area_input);
+                    history_begin(history, area);
+                }
                 switch (filter_choice) {
-                    case 1: bmp24_negative(img24); printf("Negative filter applied.\n"); break;
-                    case 2: bmp24_grayscale(img24); printf("Grayscale conversion applied.\n"); break;
+                    case 1: bmp24_negativeRegion(img24, area); printf("Negative filter applied.\n"); break;
+                    case 2: bmp24_grayscaleRegion(img24, area); printf("Grayscale conversion applied.\n"); break;
                     case 3: {
                         int bright_val = get_int_input("Enter brightness value (-255 to 255): ");
-                        if (bright_val != -1) bmp24_brightness(img24, bright_val);
+                        if (bright_val != -1) bmp24_brightnessRegion(img24, bright_val, area);
                         printf("Brightness adjusted.\n");
                         break;
                     }
@@ -303,32 +476,43 @@ void process_bmp24_menu() {
                             else if (filter_choice == 7) { selected_kernel = kernel_emboss; filter_name = "Emboss"; }
                             else if (filter_choice == 8) { selected_kernel = kernel_sharpen; filter_name = "Sharpen"; }
 
-                            if (selected_kernel && temp_img_for_conv) {
-                                // Apply convolution
-                                int n = 3 / 2; // Kernel half-size for 3x3
-                                for (int y = n; y < img24->height - n; y++) {
-                                    for (int x = n; x < img24->width - n; x++) {
-                                        temp_img_for_conv->data[y][x] = bmp24_convolution(img24, x, y, selected_kernel, 3);
-                                    }
-                                }
-                                for (int y = n; y < img24->height - n; y++) {
-                                    for (int x = n; x < img24->width - n; x++) {
-                                        img24->data[y][x] = temp_img_for_conv->data[y][x];
-                                    }
-                                }
+                            if (selected_kernel) {
+                                bmp24_applyFilterRegion(img24, selected_kernel, 3, area);
                                 printf("%s filter applied.\n", filter_name);
                             } else {
-                                printf("Kernel or temporary image not available for convolution.\n");
+                                printf("Kernel not available for convolution.\n");
                             }
                         }
                         break;
                     case 9: // Histogram Equalization
-                        bmp24_equalize(img24);
+                        bmp24_equalizeRegion(img24, area);
                         printf("Histogram equalization (Y component) applied.\n");
                         break;
-                    case 10: printf("Returning to BMP24 menu.\n"); break;
+                    case 10: {
+                        int new_width, new_height;
+                        t_resize_filter filter;
+                        if (get_resize_input(&new_width, &new_height, &filter)) {
+                            t_bmp24 *resized = bmp24_resize(img24, new_width, new_height, filter);
+                            if (resized) {
+                                bmp24_free(img24);
+                                img24 = resized;
+                                history_free(history);
+                                history = history_createBmp24(img24, HISTORY_DEFAULT_LIMIT);
+                                preview_rebuild(&preview, NULL, img24);
+                                printf("Image resized to %d x %d (undo history cleared).\n", new_width, new_height);
+                            } else {
+                                printf("Failed to resize image.\n");
+                            }
+                        }
+                        break;
+                    }
+                    case 11: printf("Returning to BMP24 menu.\n"); break;
                     default: printf("Invalid filter choice.\n"); break;
                 }
+                if (filter_choice >= 1 && filter_choice <= 9) {
+                    history_commit(history, filter_names[filter_choice - 1]);
+                    preview_refresh(&preview, NULL, img24);
+                }
                 break;
             case 4: // Display info
                 if (img24) {
@@ -343,17 +527,31 @@ void process_bmp24_menu() {
                     printf("No image loaded.\n");
                 }
                 break;
-            case 5: // Return to main menu
+            case 5: // Undo
+            case 6: // Redo
+                if (img24) {
+                    undo_menu_step(history, choice == 6);
+                    preview_refresh(&preview, NULL, img24);
+                } else {
+                    printf("No image loaded.\n");
+                }
+                break;
+            case 7: // Preview an op chain
+                if (img24) preview_menu(&preview, NULL, img24);
+                else printf("No image loaded.\n");
+                break;
+            case 8: // Return to main menu
                 printf("Returning to Main Menu...\n");
                 break;
             default:
                 printf("Invalid choice. Please try again.\n");
                 break;
         }
-    } while (choice != 5);
+    } while (choice != 8);
 
+    preview_stop(&preview, NULL, NULL);
+    history_free(history);
     if (img24) bmp24_free(img24);
-    if (temp_img_for_conv) bmp24_free(temp_img_for_conv);
 
     free_kernel(kernel_box, 3);
     free_kernel(kernel_gaussian, 3);
@@ -363,7 +561,493 @@ void process_bmp24_menu() {
 }
 
 
-int main() {
+// Reads the bits-per-pixel field of a BMP header, returns -1 if the file is not a readable BMP
+int read_bmp_depth(const char *filename) {
+    t_bmp_probe probe;
+    return bmp_probe(filename, &probe) == 0 ? probe.depth : -1;
+}
+
+// A command's input image, of either depth. "-" reads the file from stdin into memory and
+// works on a view of that buffer, so the pixels are not copied a second time.
+typedef struct {
+    t_bmp8 *img8;
+    t_bmp24 *img24;
+    t_byte_buffer input;
+} t_cli_image;
+
+static void free_cli_image(t_cli_image *image) {
+    bmp8_free(image->img8);
+    bmp24_free(image->img24);
+    buffer_free(&image->input);
+}
+
+// Returns 0 on success, -1 on error
+static int load_cli_image(const char *path, t_cli_image *image) {
+    image->img8 = NULL;
+    image->img24 = NULL;
+    buffer_init(&image->input);
+    int depth;
+    if (strcmp(path, "-") == 0) {
+        t_bmp_probe probe;
+        if (buffer_readFile(&image->input, stdin) != 0) {
+            fprintf(stderr, "Error: Failed to read the image from stdin.\n");
+            return -1;
+        }
+        depth = bmp_probeMemory(image->input.data, image->input.size, &probe) == 0 ? probe.depth : -1;
+        if (depth == 8) image->img8 = bmp8_viewMemory(image->input.data, image->input.size);
+        else if (depth == 24) image->img24 = bmp24_viewMemory(image->input.data, image->input.size);
+    } else {
+        depth = read_bmp_depth(path);
+        if (depth == 8) image->img8 = bmp8_loadImage(path);
+        else if (depth == 24) image->img24 = bmp24_loadImage(path);
+    }
+    if (depth != 8 && depth != 24) fprintf(stderr, "Error: %s is not an 8-bit or 24-bit BMP or a QOI file.\n", path);
+    if (!image->img8 && !image->img24) {
+        free_cli_image(image);
+        return -1;
+    }
+    return 0;
+}
+
+// "-" writes the file to stdout. Returns 0 on success, -1 on error.
+static int save_cli_bmp8(const char *path, t_bmp8 *img) {
+    if (strcmp(path, "-") != 0) {
+        bmp8_saveImage(path, img);
+        return 0;
+    }
+    t_byte_buffer out;
+    buffer_init(&out);
+    int status = (bmp8_encodeMemory(img, &out) == 0 && buffer_writeFile(&out, stdout) == 0) ? 0 : -1;
+    buffer_free(&out);
+    return status;
+}
+
+static int save_cli_bmp24(const char *path, t_bmp24 *img) {
+    if (strcmp(path, "-") != 0) {
+        bmp24_saveImage(img, path);
+        return 0;
+    }
+    t_byte_buffer out;
+    buffer_init(&out);
+    int status = (bmp24_encodeMemory(img, &out) == 0 && buffer_writeFile(&out, stdout) == 0) ? 0 : -1;
+    buffer_free(&out);
+    return status;
+}
+
+static int save_cli_image(const char *path, t_cli_image *image) {
+    return image->img8 ? save_cli_bmp8(path, image->img8) : save_cli_bmp24(path, image->img24);
+}
+
+void print_usage(const char *program) {
+    printf("Usage:\n");
+    printf("  %s                                   Interactive menu\n", program);
+    printf("  %s pyramid <input.bmp> <prefix> [tile]  Write tiled mip pyramid\n", program);
+    printf("  %s run <input.bmp> <output.bmp> <ops> [cacheDir]  Apply a comma separated op chain\n", program);
+    printf("  %s cache <cacheDir>                      Result cache size and hit statistics\n", program);
+    printf("  %s gray8 <input.bmp> <output.bmp> [mean|bt601|bt709]  24-bit to 8-bit grayscale\n", program);
+    printf("  %s quantize <input.bmp> <output.bmp> [colours] [mediancut|octree] [dither|none]  24-bit to 8-bit indexed colour\n", program);
+    printf("  %s median <input.bmp> <output.bmp> <radius> [percentile]  Median/percentile filter\n", program);
+    printf("  %s clahe <input.bmp> <output.bmp> [tiles] [clip]  Adaptive histogram equalization\n", program);
+    printf("  %s morph <erode|dilate|open|close> <input.bmp> <output.bmp> <width> [height]  8-bit morphology\n", program);
+    printf("  %s blur <input.bmp> <output.bmp> <sigma>  Gaussian blur of any sigma\n", program);
+    printf("  %s rotate <90|180|270> <input.bmp> <output.bmp>  Rotate clockwise\n", program);
+    printf("  %s transpose <input.bmp> <output.bmp>   Swap rows and columns\n", program);
+    printf("  %s flip <h|v> <input.bmp> <output.bmp>  Mirror left-right or top-bottom\n", program);
+    printf("  %s edges <input.bmp> <output.bmp> [sobel|scharr] [l1|approx|exact] [direction.bmp]  Gradient magnitude\n", program);
+    printf("  %s blend <base.bmp> <overlay.bmp> <output.bmp> [over|add|multiply|screen|difference] [x] [y] [opacity] [mask.bmp]\n", program);
+    printf("      Blend a 24-bit overlay onto the base; with output = base, only the covered rows of the file are rewritten\n");
+    printf("  %s stats <input.bmp>                     Per-channel min, max, mean, deviation and percentiles\n", program);
+    printf("  %s levels <input.bmp> <output.bmp> [clip%%] [channels|linked]  Auto-levels contrast stretch\n", program);
+    printf("  %s histogram <input.bmp> [rate]        Gray or luma histogram from a sample of the file\n", program);
+    printf("  %s probe <file.bmp>...                   Size and depth from the headers only\n", program);
+    printf("  %s catalog scan <dir> [catalogFile]      Index every BMP below dir, re-probing changed files only\n", program);
+    printf("  %s catalog list <catalogFile>            Print the records of a catalog\n", program);
+    printf("  %s serve <socket> [workers]              Run as a daemon on a Unix domain socket\n", program);
+    printf("      <input.bmp> and <output.bmp> may be - for stdin and stdout, except for pyramid and gray8\n");
+    printf("      ops: negative, brightness=N, threshold=N, gray, equalize, box, gaussian, outline, emboss, sharpen\n");
+    printf("      merge in ops merges consecutive kernels into one, faster but off by a few levels\n");
+}
+
+// Loads the input, runs the optimized op chain once and saves the result. With a cache
+// directory, a result stored by an earlier run of the same input and plan is copied instead.
+int run_pipeline_command(const char *input, const char *output, const char *spec, const char *cacheDir) {
+    t_pipeline *pipeline = pipeline_parse(spec);
+    if (!pipeline) return 1;
+    pipeline_optimize(pipeline);
+
+    t_result_cache *cache = NULL;
+    char key[CACHE_KEY_LENGTH];
+    // Piped inputs and outputs bypass the cache, which works on files
+    if (cacheDir && strcmp(input, "-") != 0 && strcmp(output, "-") != 0) {
+        cache = cache_open(cacheDir, CACHE_DEFAULT_LIMIT);
+        if (cache && cache_key(input, pipeline, output, key) != 0) {
+            cache_close(cache);
+            cache = NULL;
+        }
+        if (cache && cache_fetch(cache, key, output) == 1) {
+            cache_close(cache);
+            pipeline_free(pipeline);
+            return 0;
+        }
+    }
+
+    int status = 1;
+    t_cli_image image;
+    if (load_cli_image(input, &image) == 0) {
+        int executed = image.img8 ? pipeline_executeTiledBmp8(pipeline, image.img8, 0)
+                                  : pipeline_executeTiledBmp24(pipeline, image.img24, 0);
+        if (executed == 0 && save_cli_image(output, &image) == 0) status = 0;
+        free_cli_image(&image);
+    }
+    if (cache && status == 0) cache_store(cache, key, output);
+    cache_close(cache);
+    pipeline_free(pipeline);
+    return status;
+}
+
+// Non-interactive entry points for batch jobs
+int run_command(int argc, char **argv) {
+    if (strcmp(argv[1], "pyramid") == 0 && (argc == 4 || argc == 5)) {
+        int tile_size = (argc == 5) ? atoi(argv[4]) : PYRAMID_DEFAULT_TILE_SIZE;
+        int depth = read_bmp_depth(argv[2]);
+        int levels;
+        if (depth == 8) levels = bmp8_buildPyramid(argv[2], argv[3], tile_size);
+        else if (depth == 24) levels = bmp24_buildPyramid(argv[2], argv[3], tile_size);
+        else {
+            fprintf(stderr, "Error: %s is not an 8-bit or 24-bit BMP.\n", argv[2]);
+            return 1;
+        }
+        if (levels < 0) return 1;
+        printf("Wrote %d pyramid levels with prefix %s.\n", levels, argv[3]);
+        return 0;
+    }
+    if (strcmp(argv[1], "gray8") == 0 && (argc == 4 || argc == 5)) {
+        t_luma_mode mode = LUMA_BT601;
+        if (argc == 5) {
+            if (strcmp(argv[4], "mean") == 0) mode = LUMA_MEAN;
+            else if (strcmp(argv[4], "bt601") == 0) mode = LUMA_BT601;
+            else if (strcmp(argv[4], "bt709") == 0) mode = LUMA_BT709;
+            else {
+                fprintf(stderr, "Error: Unknown luma mode %s.\n", argv[4]);
+                return 1;
+            }
+        }
+        return bmp24_convertFileToGray8(argv[2], argv[3], mode) == 0 ? 0 : 1;
+    }
+    if (strcmp(argv[1], "median") == 0 && (argc == 5 || argc == 6)) {
+        int radius = atoi(argv[4]);
+        float percentile = (argc == 6) ? (float)atof(argv[5]) : 50.0f;
+        t_cli_image image;
+        if (load_cli_image(argv[2], &image) != 0) return 1;
+        if (image.img8) bmp8_percentileFilter(image.img8, radius, percentile);
+        else bmp24_percentileFilter(image.img24, radius, percentile);
+        int status = save_cli_image(argv[3], &image);
+        free_cli_image(&image);
+        return status == 0 ? 0 : 1;
+    }
+    if (strcmp(argv[1], "clahe") == 0 && argc >= 4 && argc <= 6) {
+        int tiles = (argc >= 5) ? atoi(argv[4]) : CLAHE_DEFAULT_TILES;
+        float clip = (argc == 6) ? (float)atof(argv[5]) : CLAHE_DEFAULT_CLIP;
+        t_cli_image image;
+        if (load_cli_image(argv[2], &image) != 0) return 1;
+        int status = image.img8 ? bmp8_clahe(image.img8, tiles, tiles, clip)
+                                : bmp24_clahe(image.img24, tiles, tiles, clip);
+        if (status == 0) status = save_cli_image(argv[3], &image);
+        free_cli_image(&image);
+        return status == 0 ? 0 : 1;
+    }
+    if (strcmp(argv[1], "morph") == 0 && (argc == 6 || argc == 7)) {
+        int se_width = atoi(argv[5]);
+        int se_height = (argc == 7) ? atoi(argv[6]) : se_width;
+        void (*operation)(t_bmp8 *, int, int) = NULL;
+        if (strcmp(argv[2], "erode") == 0) operation = bmp8_erode;
+        else if (strcmp(argv[2], "dilate") == 0) operation = bmp8_dilate;
+        else if (strcmp(argv[2], "open") == 0) operation = bmp8_open;
+        else if (strcmp(argv[2], "close") == 0) operation = bmp8_close;
+        if (!operation) {
+            fprintf(stderr, "Error: Unknown morphology operation %s.\n", argv[2]);
+            return 1;
+        }
+        t_cli_image image;
+        if (load_cli_image(argv[3], &image) != 0) return 1;
+        if (!image.img8) {
+            fprintf(stderr, "Error: Morphology needs an 8-bit image.\n");
+            free_cli_image(&image);
+            return 1;
+        }
+        operation(image.img8, se_width, se_height);
+        int status = save_cli_bmp8(argv[4], image.img8);
+        free_cli_image(&image);
+        return status == 0 ? 0 : 1;
+    }
+    if (strcmp(argv[1], "blur") == 0 && argc == 5) {
+        float sigma = (float)atof(argv[4]);
+        t_cli_image image;
+        if (load_cli_image(argv[2], &image) != 0) return 1;
+        int status = image.img8 ? bmp8_gaussianBlur(image.img8, sigma) : bmp24_gaussianBlur(image.img24, sigma);
+        if (status == 0) status = save_cli_image(argv[3], &image);
+        free_cli_image(&image);
+        return status == 0 ? 0 : 1;
+    }
+    if (strcmp(argv[1], "quantize") == 0 && argc >= 4 && argc <= 7) {
+        int colors = (argc >= 5) ? atoi(argv[4]) : 256;
+        t_quantize_method method = QUANTIZE_MEDIAN_CUT;
+        t_dither_mode dither = DITHER_FLOYD_STEINBERG;
+        if (argc >= 6) {
+            if (strcmp(argv[5], "octree") == 0) method = QUANTIZE_OCTREE;
+            else if (strcmp(argv[5], "mediancut") != 0) {
+                fprintf(stderr, "Error: Unknown quantization method %s.\n", argv[5]);
+                return 1;
+            }
+        }
+        if (argc == 7) {
+            if (strcmp(argv[6], "none") == 0) dither = DITHER_NONE;
+            else if (strcmp(argv[6], "dither") != 0) {
+                fprintf(stderr, "Error: Unknown dither mode %s.\n", argv[6]);
+                return 1;
+            }
+        }
+        t_cli_image image;
+        if (load_cli_image(argv[2], &image) != 0) return 1;
+        if (!image.img24) {
+            fprintf(stderr, "Error: Quantization needs a 24-bit image.\n");
+            free_cli_image(&image);
+            return 1;
+        }
+        t_bmp8 *indexed = bmp24_quantize(image.img24, colors, method, dither);
+        free_cli_image(&image);
+        if (!indexed) return 1;
+        int status = save_cli_bmp8(argv[3], indexed);
+        bmp8_free(indexed);
+        return status == 0 ? 0 : 1;
+    }
+    if ((strcmp(argv[1], "rotate") == 0 && argc == 5) || (strcmp(argv[1], "transpose") == 0 && argc == 4)) {
+        int degrees = (argc == 5) ? atoi(argv[2]) : 0;
+        if (argc == 5 && degrees != 90 && degrees != 180 && degrees != 270) {
+            fprintf(stderr, "Error: Rotation must be 90, 180 or 270 degrees.\n");
+            return 1;
+        }
+        const char *input = argv[argc - 2], *output = argv[argc - 1];
+        t_cli_image image;
+        if (load_cli_image(input, &image) != 0) return 1;
+        t_cli_image result = {NULL, NULL, {0}};
+        if (image.img8) result.img8 = degrees ? bmp8_rotate(image.img8, degrees) : bmp8_transpose(image.img8);
+        else result.img24 = degrees ? bmp24_rotate(image.img24, degrees) : bmp24_transpose(image.img24);
+        free_cli_image(&image);
+        if (!result.img8 && !result.img24) return 1;
+        int status = save_cli_image(output, &result);
+        free_cli_image(&result);
+        return status == 0 ? 0 : 1;
+    }
+    if (strcmp(argv[1], "flip") == 0 && argc == 5) {
+        int horizontal = strcmp(argv[2], "h") == 0;
+        if (!horizontal && strcmp(argv[2], "v") != 0) {
+            fprintf(stderr, "Error: Flip direction must be h or v.\n");
+            return 1;
+        }
+        t_cli_image image;
+        if (load_cli_image(argv[3], &image) != 0) return 1;
+        if (image.img8) {
+            if (horizontal) bmp8_flipHorizontal(image.img8);
+            else bmp8_flipVertical(image.img8);
+        } else {
+            if (horizontal) bmp24_flipHorizontal(image.img24);
+            else bmp24_flipVertical(image.img24);
+        }
+        int status = save_cli_image(argv[4], &image);
+        free_cli_image(&image);
+        return status == 0 ? 0 : 1;
+    }
+    if (strcmp(argv[1], "edges") == 0 && argc >= 4 && argc <= 7) {
+        t_edge_operator op = EDGE_SOBEL;
+        t_magnitude_mode mode = MAGNITUDE_L1;
+        if (argc >= 5) {
+            if (strcmp(argv[4], "scharr") == 0) op = EDGE_SCHARR;
+            else if (strcmp(argv[4], "sobel") != 0) {
+                fprintf(stderr, "Error: Unknown edge operator %s.\n", argv[4]);
+                return 1;
+            }
+        }
+        if (argc >= 6) {
+            if (strcmp(argv[5], "approx") == 0) mode = MAGNITUDE_APPROX;
+            else if (strcmp(argv[5], "exact") == 0) mode = MAGNITUDE_EXACT;
+            else if (strcmp(argv[5], "l1") != 0) {
+                fprintf(stderr, "Error: Unknown magnitude mode %s.\n", argv[5]);
+                return 1;
+            }
+        }
+        t_bmp8 *direction = NULL;
+        t_bmp8 **want_direction = (argc == 7) ? &direction : NULL;
+        t_cli_image image;
+        if (load_cli_image(argv[2], &image) != 0) return 1;
+        t_bmp8 *magnitude = image.img8 ? bmp8_gradient(image.img8, op, mode, want_direction)
+                                       : bmp24_gradient(image.img24, op, mode, want_direction);
+        free_cli_image(&image);
+        if (!magnitude) return 1;
+        int status = save_cli_bmp8(argv[3], magnitude);
+        if (direction) {
+            // Spread the four sectors over the gray range so the file can be viewed
+            for (unsigned int i = 0; i < direction->dataSize; i++) direction->data[i] = (uint8_t)(direction->data[i] * 85);
+            bmp8_saveImage(argv[6], direction);
+        }
+        bmp8_free(magnitude);
+        bmp8_free(direction);
+        return status == 0 ? 0 : 1;
+    }
+    if (strcmp(argv[1], "serve") == 0 && (argc == 3 || argc == 4)) {
+        int workers = (argc == 4) ? atoi(argv[3]) : SERVER_DEFAULT_WORKERS;
+        return server_run(argv[2], workers) == 0 ? 0 : 1;
+    }
+    if (strcmp(argv[1], "run") == 0 && (argc == 5 || argc == 6)) {
+        return run_pipeline_command(argv[2], argv[3], argv[4], (argc == 6) ? argv[5] : NULL);
+    }
+    if (strcmp(argv[1], "cache") == 0 && argc == 3) {
+        t_result_cache *cache = cache_open(argv[2], CACHE_DEFAULT_LIMIT);
+        t_cache_stats stats;
+        if (!cache || cache_stats(cache, &stats) != 0) {
+            cache_close(cache);
+            return 1;
+        }
+        unsigned long long lookups = stats.hits + stats.misses;
+        printf("Entries: %d (%.1f MB)\n", stats.entries, stats.bytes / (1024.0 * 1024.0));
+        printf("Hits: %llu, misses: %llu, hit rate: %.1f%%\n", stats.hits, stats.misses,
+               lookups ? 100.0 * stats.hits / lookups : 0.0);
+        cache_close(cache);
+        return 0;
+    }
+    if (strcmp(argv[1], "blend") == 0 && argc >= 5 && argc <= 10) {
+        t_blend_mode mode = BLEND_OVER;
+        if (argc >= 6 && blend_parseMode(argv[5], &mode) != 0) {
+            fprintf(stderr, "Error: Unknown blend mode %s.\n", argv[5]);
+            return 1;
+        }
+        int x = (argc >= 7) ? atoi(argv[6]) : 0;
+        int y = (argc >= 8) ? atoi(argv[7]) : 0;
+        int opacity = (argc >= 9) ? atoi(argv[8]) : 255;
+        t_cli_image overlay;
+        if (load_cli_image(argv[3], &overlay) != 0) return 1;
+        t_bmp8 *mask = (argc == 10) ? bmp8_loadImage(argv[9]) : NULL;
+        int status = -1;
+        if (!overlay.img24) {
+            fprintf(stderr, "Error: The overlay must be a 24-bit image.\n");
+        } else if (argc == 10 && !mask) {
+            fprintf(stderr, "Error: Cannot load the mask %s.\n", argv[9]);
+        } else if (strcmp(argv[2], argv[4]) == 0 && strcmp(argv[2], "-") != 0) {
+            // Blending onto the base file itself rewrites only the rows the overlay covers
+            status = bmp24_blendFile(argv[2], overlay.img24, mask, x, y, mode, opacity);
+        } else {
+            t_cli_image base;
+            if (load_cli_image(argv[2], &base) == 0) {
+                if (!base.img24) fprintf(stderr, "Error: The base must be a 24-bit image.\n");
+                else if (bmp24_blend(base.img24, overlay.img24, mask, x, y, mode, opacity) == 0)
+                    status = save_cli_image(argv[4], &base);
+                free_cli_image(&base);
+            }
+        }
+        bmp8_free(mask);
+        free_cli_image(&overlay);
+        return status == 0 ? 0 : 1;
+    }
+    if (strcmp(argv[1], "stats") == 0 && argc == 3) {
+        t_cli_image image;
+        if (load_cli_image(argv[2], &image) != 0) return 1;
+        t_image_stats stats;
+        int status = image.img8 ? bmp8_computeStats(image.img8, NULL, &stats)
+                                : bmp24_computeStats(image.img24, NULL, &stats);
+        free_cli_image(&image);
+        if (status != 0) return 1;
+        const char *names[] = {"blue", "green", "red"};
+        printf("%-8s %5s %5s %8s %8s %5s %5s %5s\n", "channel", "min", "max", "mean", "stddev", "p1", "p50", "p99");
+        for (int c = 0; c < stats.channels; c++) {
+            const t_channel_stats *channel = &stats.channel[c];
+            printf("%-8s %5d %5d %8.2f %8.2f %5d %5d %5d\n", stats.channels == 1 ? "gray" : names[c], channel->min,
+                   channel->max, channel->mean, sqrt(channel->variance), stats_percentile(channel, 0.01),
+                   stats_percentile(channel, 0.5), stats_percentile(channel, 0.99));
+        }
+        return 0;
+    }
+    if (strcmp(argv[1], "levels") == 0 && argc >= 4 && argc <= 6) {
+        double clip = (argc >= 5) ? atof(argv[4]) / 100.0 : 0.005;
+        t_levels_mode mode = LEVELS_PER_CHANNEL;
+        if (argc == 6) {
+            if (strcmp(argv[5], "linked") == 0) mode = LEVELS_LINKED;
+            else if (strcmp(argv[5], "channels") != 0) {
+                fprintf(stderr, "Error: Unknown levels mode %s.\n", argv[5]);
+                return 1;
+            }
+        }
+        t_cli_image image;
+        if (load_cli_image(argv[2], &image) != 0) return 1;
+        int status = image.img8 ? bmp8_autoLevels(image.img8, clip) : bmp24_autoLevels(image.img24, clip, mode);
+        if (status == 0) status = save_cli_image(argv[3], &image);
+        free_cli_image(&image);
+        return status == 0 ? 0 : 1;
+    }
+    if (strcmp(argv[1], "histogram") == 0 && (argc == 3 || argc == 4)) {
+        double rate = (argc == 4) ? atof(argv[3]) : 1.0;
+        t_sample_info info;
+        unsigned int *hist = histogram_sampleFile(argv[2], rate, &info);
+        if (!hist) return 1;
+        printf("# %llu of %llu pixels read, CDF within %.5f of the exact one\n", info.sampled, info.total,
+               info.errorBound);
+        for (int v = 0; v < 256; v++) printf("%d %u\n", v, hist[v]);
+        free(hist);
+        return 0;
+    }
+    if (strcmp(argv[1], "probe") == 0 && argc >= 3) {
+        int status = 0;
+        for (int i = 2; i < argc; i++) {
+            t_bmp_probe probe;
+            if (bmp_probe(argv[i], &probe) != 0) {
+                fprintf(stderr, "Error: %s is not a readable BMP or QOI file.\n", argv[i]);
+                status = 1;
+                continue;
+            }
+            printf("%s: %s%dx%d, %d bits%s%s, %lld bytes\n", argv[i], probe.format == IMAGE_FORMAT_QOI ? "QOI, " : "",
+                   probe.width, probe.height, probe.depth, probe.topDown ? ", top-down" : "",
+                   probe.compression ? ", compressed" : "", probe.fileSize);
+        }
+        return status;
+    }
+    if (strcmp(argv[1], "catalog") == 0 && argc >= 4 && argc <= 5 && strcmp(argv[2], "scan") == 0) {
+        char path[4096];
+        if (argc == 5) snprintf(path, sizeof(path), "%s", argv[4]);
+        else snprintf(path, sizeof(path), "%s/.catalog", argv[3]);
+        t_catalog_scan_stats stats;
+        t_catalog *catalog = catalog_scan(argv[3], path, &stats);
+        if (!catalog) return 1;
+        printf("%d files (%d probed, %d unchanged, %d removed, %d not BMP) -> %s\n", stats.files, stats.probed,
+               stats.unchanged, stats.removed, stats.invalid, path);
+        catalog_free(catalog);
+        return 0;
+    }
+    if (strcmp(argv[1], "catalog") == 0 && argc == 4 && strcmp(argv[2], "list") == 0) {
+        t_catalog *catalog = catalog_load(argv[3]);
+        if (!catalog) {
+            fprintf(stderr, "Error: %s is not a catalog.\n", argv[3]);
+            return 1;
+        }
+        for (int i = 0; i < catalog->count; i++) {
+            const t_catalog_record *record = &catalog->records[i];
+            if (record->flags & CATALOG_BMP) {
+                printf("%s\t%u\t%u\t%u\t%llu\n", catalog_name(catalog, record), record->width, record->height,
+                       record->depth, (unsigned long long)record->fileSize);
+            } else {
+                printf("%s\t-\t-\t-\t%llu\n", catalog_name(catalog, record), (unsigned long long)record->fileSize);
+            }
+        }
+        catalog_free(catalog);
+        return 0;
+    }
+    print_usage(argv[0]);
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        return run_command(argc, argv);
+    }
+
     int main_choice;
     do {
         display_main_menu();
@@ -0,0 +1,260 @@
+#include "median.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+// One channel of an image seen as rows of interleaved samples
+typedef struct {
+    uint8_t *const *src;    // Snapshot of the input
+    uint8_t *const *dst;
+    int width;
+    int height;
+    int channels;
+    int channel;
+} t_plane;
+
+// Compare-exchange pairs {a, b}, a receiving the minimum, that leave the median in slot
+// NETWORK9_MEDIAN / NETWORK25_MEDIAN. The 3x3 one is the classic 19 exchange network; the 5x5
+// one is Batcher's odd-even merge sort on 32 inputs, with the 7 padding inputs propagated as
+// constants and every exchange that cannot reach the median removed.
+static const uint8_t network9[][2] = {
+    {1, 2}, {4, 5}, {7, 8}, {0, 1}, {3, 4}, {6, 7}, {1, 2}, {4, 5}, {7, 8}, {0, 3},
+    {5, 8}, {4, 7}, {3, 6}, {1, 4}, {2, 5}, {4, 7}, {4, 2}, {6, 4}, {4, 2}
+};
+#define NETWORK9_MEDIAN 4
+
+static const uint8_t network25[][2] = {
+    {0, 1}, {2, 3}, {4, 5}, {6, 7}, {8, 9}, {10, 11}, {12, 13}, {14, 15}, {16, 17}, {18, 19},
+    {20, 21}, {22, 23}, {0, 2}, {1, 3}, {4, 6}, {5, 7}, {8, 10}, {9, 11}, {12, 14}, {13, 15},
+    {16, 18}, {17, 19}, {20, 22}, {21, 23}, {1, 2}, {5, 6}, {9, 10}, {13, 14}, {17, 18}, {21, 22},
+    {0, 4}, {1, 5}, {2, 6}, {3, 7}, {8, 12}, {9, 13}, {10, 14}, {11, 15}, {16, 20}, {17, 21},
+    {18, 22}, {19, 23}, {2, 4}, {3, 5}, {10, 12}, {11, 13}, {18, 20}, {19, 21}, {1, 2}, {3, 4},
+    {5, 6}, {9, 10}, {11, 12}, {13, 14}, {17, 18}, {19, 20}, {21, 22}, {0, 8}, {1, 9}, {2, 10},
+    {3, 11}, {4, 12}, {5, 13}, {6, 14}, {7, 15}, {16, 24}, {4, 8}, {5, 9}, {6, 10}, {7, 11},
+    {20, 24}, {2, 4}, {3, 5}, {6, 8}, {7, 9}, {10, 12}, {11, 13}, {18, 20}, {19, 21}, {22, 24},
+    {1, 2}, {3, 4}, {5, 6}, {7, 8}, {9, 10}, {11, 12}, {13, 14}, {17, 18}, {19, 20}, {21, 22},
+    {23, 24}, {0, 16}, {1, 17}, {2, 18}, {3, 19}, {4, 20}, {5, 21}, {6, 22}, {7, 23}, {8, 24},
+    {8, 16}, {9, 17}, {10, 18}, {11, 19}, {12, 20}, {13, 21}, {6, 10}, {7, 11}, {12, 16}, {13, 17},
+    {10, 12}, {11, 13}, {11, 12}
+};
+#define NETWORK25_MEDIAN 12
+
+static int clamp_index(int i, int size) {
+    return i < 0 ? 0 : (i >= size ? size - 1 : i);
+}
+
+static uint8_t sample(const t_plane *p, int x, int y) {
+    return p->src[y][x * p->channels + p->channel];
+}
+
+static void exchange_lanes(uint8_t *restrict a, uint8_t *restrict b) {
+    for (int l = 0; l < MEDIAN_LANES; l++) {
+        uint8_t lo = a[l] < b[l] ? a[l] : b[l];
+        uint8_t hi = a[l] < b[l] ? b[l] : a[l];
+        a[l] = lo;
+        b[l] = hi;
+    }
+}
+
+// Runs a median network on MEDIAN_LANES pixels at once: each exchange is a min/max over whole
+// lane arrays, which the compiler turns into vector instructions
+static void network_rows(const t_plane *p, int y0, int y1, int radius, const int *columns) {
+    const uint8_t (*pairs)[2] = (radius == 1) ? network9 : network25;
+    int pair_count = (radius == 1) ? (int)(sizeof(network9) / sizeof(network9[0]))
+                                   : (int)(sizeof(network25) / sizeof(network25[0]));
+    int median = (radius == 1) ? NETWORK9_MEDIAN : NETWORK25_MEDIAN;
+    uint8_t lanes[25][MEDIAN_LANES];
+
+    for (int y = y0; y < y1; y++) {
+        for (int x0 = 0; x0 < p->width; x0 += MEDIAN_LANES) {
+            int count = (p->width - x0 < MEDIAN_LANES) ? p->width - x0 : MEDIAN_LANES;
+            int interior = (x0 >= radius && x0 + MEDIAN_LANES + radius <= p->width);
+            int k = 0;
+            for (int dy = -radius; dy <= radius; dy++) {
+                const uint8_t *row = p->src[clamp_index(y + dy, p->height)];
+                for (int dx = -radius; dx <= radius; dx++, k++) {
+                    if (interior) {
+                        const uint8_t *base = row + (size_t)(x0 + dx) * p->channels + p->channel;
+                        for (int l = 0; l < MEDIAN_LANES; l++) lanes[k][l] = base[l * p->channels];
+                    } else {
+                        // columns[] is shifted by radius so that x + dx never goes below 0
+                        const int *cols = columns + radius + x0 + dx;
+                        for (int l = 0; l < MEDIAN_LANES; l++) lanes[k][l] = row[cols[l] * p->channels + p->channel];
+                    }
+                }
+            }
+            for (int e = 0; e < pair_count; e++) exchange_lanes(lanes[pairs[e][0]], lanes[pairs[e][1]]);
+            uint8_t *out = p->dst[y] + (size_t)x0 * p->channels + p->channel;
+            for (int l = 0; l < count; l++) out[l * p->channels] = lanes[median][l];
+        }
+    }
+}
+
+static void add_histogram(uint16_t *restrict to, const uint16_t *restrict from, int bins) {
+    for (int i = 0; i < bins; i++) to[i] += from[i];
+}
+
+static void sub_histogram(uint16_t *restrict to, const uint16_t *restrict from, int bins) {
+    for (int i = 0; i < bins; i++) to[i] -= from[i];
+}
+
+// Histogram rank filter over rows [y0, y1). Every column keeps a 256 bin histogram of its
+// 2r+1 rows plus a 16 bin coarse one; moving down a row updates each column with one removal
+// and one insertion, and moving right along a row adds one column histogram to the window and
+// subtracts another. The coarse histogram finds the 16 value range holding the rank, and only
+// that range of the fine histogram is scanned.
+// fine holds width * 256 counts and coarse width * 16.
+static void histogram_rows(const t_plane *p, int y0, int y1, int radius, int rank,
+                           uint16_t *fine, uint16_t *coarse) {
+    int width = p->width, height = p->height;
+    memset(fine, 0, (size_t)width * 256 * sizeof(uint16_t));
+    memset(coarse, 0, (size_t)width * 16 * sizeof(uint16_t));
+    for (int dy = -radius; dy <= radius; dy++) {
+        int y = clamp_index(y0 + dy, height);
+        for (int x = 0; x < width; x++) {
+            uint8_t v = sample(p, x, y);
+            fine[(size_t)x * 256 + v]++;
+            coarse[(size_t)x * 16 + (v >> 4)]++;
+        }
+    }
+
+    uint16_t window[256];
+    uint16_t window_coarse[16];
+    for (int y = y0; y < y1; y++) {
+        if (y > y0) {
+            int out_row = clamp_index(y - radius - 1, height);
+            int in_row = clamp_index(y + radius, height);
+            for (int x = 0; x < width; x++) {
+                uint8_t v = sample(p, x, out_row);
+                uint8_t w = sample(p, x, in_row);
+                fine[(size_t)x * 256 + v]--;
+                coarse[(size_t)x * 16 + (v >> 4)]--;
+                fine[(size_t)x * 256 + w]++;
+                coarse[(size_t)x * 16 + (w >> 4)]++;
+            }
+        }
+
+        memset(window, 0, sizeof(window));
+        memset(window_coarse, 0, sizeof(window_coarse));
+        for (int dx = -radius; dx <= radius; dx++) {
+            int x = clamp_index(dx, width);
+            add_histogram(window, fine + (size_t)x * 256, 256);
+            add_histogram(window_coarse, coarse + (size_t)x * 16, 16);
+        }
+
+        uint8_t *out = p->dst[y] + p->channel;
+        for (int x = 0; x < width; x++) {
+            if (x > 0) {
+                int in_col = clamp_index(x + radius, width);
+                int out_col = clamp_index(x - radius - 1, width);
+                add_histogram(window, fine + (size_t)in_col * 256, 256);
+                sub_histogram(window, fine + (size_t)out_col * 256, 256);
+                add_histogram(window_coarse, coarse + (size_t)in_col * 16, 16);
+                sub_histogram(window_coarse, coarse + (size_t)out_col * 16, 16);
+            }
+            int seen = 0;
+            int bin = 0;
+            while (seen + window_coarse[bin] <= rank) seen += window_coarse[bin++];
+            int value = bin * 16;
+            while (seen + window[value] <= rank) seen += window[value++];
+            out[(size_t)x * p->channels] = (uint8_t)value;
+        }
+    }
+}
+
+// Filters every channel of the image whose rows are given top-down or bottom-up (a square
+// window does not care); the input is snapshotted first so results never feed back
+static void rank_filter(uint8_t **rows, int width, int height, int channels, int radius, float percentile) {
+    if (radius < 1 || radius > MEDIAN_MAX_RADIUS) {
+        fprintf(stderr, "Error: Median radius must be between 1 and %d.\n", MEDIAN_MAX_RADIUS);
+        return;
+    }
+    if (percentile < 0.0f || percentile > 100.0f) {
+        fprintf(stderr, "Error: Percentile must be between 0 and 100.\n");
+        return;
+    }
+
+    int window = (2 * radius + 1) * (2 * radius + 1);
+    int rank = (int)lroundf(percentile / 100.0f * (float)(window - 1));
+    int use_network = (radius <= 2 && rank == window / 2);
+    size_t row_len = (size_t)width * channels;
+
+    uint8_t *copy = (uint8_t *)malloc(row_len * height);
+    uint8_t **src = (uint8_t **)malloc(height * sizeof(uint8_t *));
+    int *columns = (int *)malloc((width + 2 * radius + MEDIAN_LANES) * sizeof(int));
+    if (!copy || !src || !columns) {
+        fprintf(stderr, "Error: Failed to allocate memory for median filter.\n");
+        free(copy);
+        free(src);
+        free(columns);
+        return;
+    }
+    for (int y = 0; y < height; y++) {
+        src[y] = copy + (size_t)y * row_len;
+        memcpy(src[y], rows[y], row_len);
+    }
+    // Replicated column index of x - radius, padded so the last lane block can read past the edge
+    for (int i = 0; i < width + 2 * radius + MEDIAN_LANES; i++) columns[i] = clamp_index(i - radius, width);
+
+    // Each band pays for building its column histograms over 2r+1 rows, so bands stay several
+    // times taller than the window
+    int band = 8 * (2 * radius + 1);
+    if (band < 32) band = 32;
+    int bands = (height + band - 1) / band;
+    int failed = 0;
+
+    #pragma omp parallel
+    {
+        uint16_t *fine = NULL, *coarse = NULL;
+        if (!use_network) {
+            fine = (uint16_t *)malloc((size_t)width * 256 * sizeof(uint16_t));
+            coarse = (uint16_t *)malloc((size_t)width * 16 * sizeof(uint16_t));
+            if (!fine || !coarse) {
+                #pragma omp atomic write
+                failed = 1;
+            }
+        }
+        #pragma omp for schedule(dynamic)
+        for (int b = 0; b < bands * channels; b++) {
+            t_plane plane = {src, rows, width, height, channels, b % channels};
+            int y0 = (b / channels) * band;
+            int y1 = (y0 + band < height) ? y0 + band : height;
+            if (use_network) network_rows(&plane, y0, y1, radius, columns);
+            else if (fine && coarse) histogram_rows(&plane, y0, y1, radius, rank, fine, coarse);
+        }
+        free(fine);
+        free(coarse);
+    }
+    if (failed) fprintf(stderr, "Error: Failed to allocate histograms for median filter.\n");
+
+    free(copy);
+    free(src);
+    free(columns);
+}
+
+void bmp8_medianFilter(t_bmp8 *img, int radius) {
+    bmp8_percentileFilter(img, radius, 50.0f);
+}
+
+void bmp8_percentileFilter(t_bmp8 *img, int radius, float percentile) {
+    if (!img || !img->data) return;
+    uint8_t **rows = (uint8_t **)malloc(img->height * sizeof(uint8_t *));
+    if (!rows) {
+        fprintf(stderr, "Error: Failed to allocate memory for median filter.\n");
+        return;
+    }
+    for (unsigned int y = 0; y < img->height; y++) rows[y] = img->data + (size_t)y * img->width;
+    rank_filter(rows, (int)img->width, (int)img->height, 1, radius, percentile);
+    free(rows);
+}
+
+void bmp24_medianFilter(t_bmp24 *img, int radius) {
+    bmp24_percentileFilter(img, radius, 50.0f);
+}
+
+void bmp24_percentileFilter(t_bmp24 *img, int radius, float percentile) {
+    if (!img || !img->data) return;
+    rank_filter((uint8_t **)img->data, img->width, img->height, 3, radius, percentile);
+}
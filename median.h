@@ -0,0 +1,23 @@
+#ifndef MEDIAN_H
+#define MEDIAN_H
+
+#include "bmp8.h"
+#include "bmp24.h"
+
+// Largest supported radius: a (2r+1)^2 window must fit the 16-bit histogram counts
+#define MEDIAN_MAX_RADIUS 127
+
+// Pixels processed together by the sorting networks used for 3x3 and 5x5 medians
+#define MEDIAN_LANES 32
+
+// Rank filters over a (2*radius+1)^2 square window, edges replicated so every pixel is filtered.
+// The general case keeps one histogram per column and slides a window histogram along each row,
+// which costs the same per pixel whatever the radius; rows are split into bands run in parallel.
+// 3x3 and 5x5 medians use branchless sorting networks instead. percentile goes from 0 (minimum)
+// to 100 (maximum); bmp24 images are filtered per channel.
+void bmp8_medianFilter(t_bmp8 *img, int radius);
+void bmp8_percentileFilter(t_bmp8 *img, int radius, float percentile);
+void bmp24_medianFilter(t_bmp24 *img, int radius);
+void bmp24_percentileFilter(t_bmp24 *img, int radius, float percentile);
+
+#endif // MEDIAN_H
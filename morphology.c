@@ -0,0 +1,161 @@
+#include "morphology.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+static inline uint8_t pick(uint8_t a, uint8_t b, int dilate) {
+    if (dilate) return a > b ? a : b;
+    return a < b ? a : b;
+}
+
+// Length of a line of n samples once padded with the window's overhang, rounded up to whole
+// blocks of size samples
+static int padded_length(int n, int size) {
+    return ((n + size - 1 + size - 1) / size) * size;
+}
+
+// Van Herk/Gil-Werman along one row. The padded line is cut into blocks of size samples; g runs
+// the min/max forward from each block start and h backward from each block end, so any window
+// [x, x + size - 1] of the padded line is op(h[x], g[x + size - 1]). Padded sample i is source
+// sample i - before, or the neutral value outside of the row.
+static void vhgw_row(const uint8_t *src, uint8_t *dst, int n, int size, int before, int dilate,
+                     uint8_t *g, uint8_t *h) {
+    uint8_t neutral = dilate ? 0 : 255;
+    int length = padded_length(n, size);
+    for (int i = 0; i < length; i++) {
+        int s = i - before;
+        uint8_t v = (s >= 0 && s < n) ? src[s] : neutral;
+        g[i] = (i % size == 0) ? v : pick(g[i - 1], v, dilate);
+        h[i] = v;
+    }
+    for (int i = length - 2; i >= 0; i--) {
+        if (i % size != size - 1) h[i] = pick(h[i + 1], h[i], dilate);
+    }
+    for (int x = 0; x < n; x++) dst[x] = pick(h[x], g[x + size - 1], dilate);
+}
+
+static void pick_rows(uint8_t *out, const uint8_t *a, const uint8_t *b, int count, int dilate) {
+    if (dilate) for (int c = 0; c < count; c++) out[c] = a[c] > b[c] ? a[c] : b[c];
+    else for (int c = 0; c < count; c++) out[c] = a[c] < b[c] ? a[c] : b[c];
+}
+
+// Same recurrences down a strip of columns: each step combines whole rows of the strip, so the
+// loops run over contiguous bytes. rows are top-down; g and h hold padded_length * strip bytes.
+static void vhgw_columns(uint8_t *const *rows, int x0, int count, int n, int size, int before,
+                         int dilate, uint8_t *g, uint8_t *h, uint8_t *neutral_row) {
+    int length = padded_length(n, size);
+    for (int i = 0; i < length; i++) {
+        int s = i - before;
+        const uint8_t *v = (s >= 0 && s < n) ? rows[s] + x0 : neutral_row;
+        uint8_t *gi = g + (size_t)i * MORPHOLOGY_STRIP;
+        if (i % size == 0) memcpy(gi, v, count);
+        else pick_rows(gi, gi - MORPHOLOGY_STRIP, v, count, dilate);
+        memcpy(h + (size_t)i * MORPHOLOGY_STRIP, v, count);
+    }
+    for (int i = length - 2; i >= 0; i--) {
+        if (i % size == size - 1) continue;
+        uint8_t *hi = h + (size_t)i * MORPHOLOGY_STRIP;
+        pick_rows(hi, hi + MORPHOLOGY_STRIP, hi, count, dilate);
+    }
+    for (int y = 0; y < n; y++) {
+        pick_rows(rows[y] + x0, h + (size_t)y * MORPHOLOGY_STRIP,
+                  g + (size_t)(y + size - 1) * MORPHOLOGY_STRIP, count, dilate);
+    }
+}
+
+// One erosion or dilation by a width x height rectangle, in place. The dilation window is the
+// reflection of the erosion one so that opening and closing stay idempotent for even sizes.
+static int morph_pass(t_bmp8 *img, int width, int height, int dilate) {
+    int w = (int)img->width, hgt = (int)img->height;
+    int before_x = dilate ? width / 2 : (width - 1) / 2;
+    int before_y = dilate ? height / 2 : (height - 1) / 2;
+    int failed = 0;
+
+    // t_bmp8 rows are bottom-up; the vertical pass works on top-down rows so that the anchor
+    // of even-sized elements means the same thing as horizontally
+    uint8_t **rows = (uint8_t **)malloc(hgt * sizeof(uint8_t *));
+    if (!rows) return -1;
+    for (int y = 0; y < hgt; y++) rows[y] = img->data + (size_t)(hgt - 1 - y) * w;
+
+    if (width > 1) {
+        #pragma omp parallel
+        {
+            int length = padded_length(w, width);
+            uint8_t *g = (uint8_t *)malloc(length);
+            uint8_t *h = (uint8_t *)malloc(length);
+            uint8_t *line = (uint8_t *)malloc(w);
+            if (!g || !h || !line) {
+                #pragma omp atomic write
+                failed = 1;
+            }
+            #pragma omp for schedule(static)
+            for (int y = 0; y < hgt; y++) {
+                if (!g || !h || !line) continue;
+                memcpy(line, rows[y], w);
+                vhgw_row(line, rows[y], w, width, before_x, dilate, g, h);
+            }
+            free(g);
+            free(h);
+            free(line);
+        }
+    }
+
+    if (height > 1 && !failed) {
+        int strips = (w + MORPHOLOGY_STRIP - 1) / MORPHOLOGY_STRIP;
+        #pragma omp parallel
+        {
+            size_t length = (size_t)padded_length(hgt, height) * MORPHOLOGY_STRIP;
+            uint8_t *g = (uint8_t *)malloc(length);
+            uint8_t *h = (uint8_t *)malloc(length);
+            uint8_t neutral_row[MORPHOLOGY_STRIP];
+            memset(neutral_row, dilate ? 0 : 255, sizeof(neutral_row));
+            if (!g || !h) {
+                #pragma omp atomic write
+                failed = 1;
+            }
+            #pragma omp for schedule(dynamic)
+            for (int s = 0; s < strips; s++) {
+                if (!g || !h) continue;
+                int x0 = s * MORPHOLOGY_STRIP;
+                int count = (w - x0 < MORPHOLOGY_STRIP) ? w - x0 : MORPHOLOGY_STRIP;
+                vhgw_columns(rows, x0, count, hgt, height, before_y, dilate, g, h, neutral_row);
+            }
+            free(g);
+            free(h);
+        }
+    }
+    free(rows);
+    return failed ? -1 : 0;
+}
+
+static void morphology(t_bmp8 *img, int seWidth, int seHeight, int first_dilate, int passes) {
+    if (!img || !img->data) return;
+    if (seWidth < 1 || seHeight < 1) {
+        fprintf(stderr, "Error: Structuring element must be at least 1 x 1.\n");
+        return;
+    }
+    int dilate = first_dilate;
+    for (int p = 0; p < passes; p++, dilate = !dilate) {
+        if (morph_pass(img, seWidth, seHeight, dilate) != 0) {
+            fprintf(stderr, "Error: Failed to allocate memory for morphology.\n");
+            return;
+        }
+    }
+}
+
+void bmp8_erode(t_bmp8 *img, int seWidth, int seHeight) {
+    morphology(img, seWidth, seHeight, 0, 1);
+}
+
+void bmp8_dilate(t_bmp8 *img, int seWidth, int seHeight) {
+    morphology(img, seWidth, seHeight, 1, 1);
+}
+
+void bmp8_open(t_bmp8 *img, int seWidth, int seHeight) {
+    morphology(img, seWidth, seHeight, 0, 2);
+}
+
+void bmp8_close(t_bmp8 *img, int seWidth, int seHeight) {
+    morphology(img, seWidth, seHeight, 1, 2);
+}
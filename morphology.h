@@ -0,0 +1,20 @@
+#ifndef MORPHOLOGY_H
+#define MORPHOLOGY_H
+
+#include "bmp8.h"
+
+// Columns handled together by the vertical pass
+#define MORPHOLOGY_STRIP 64
+
+// Grayscale morphology with a seWidth x seHeight rectangle, which also covers binary masks
+// (0/255, e.g. from bmp8_threshold). The structuring element is anchored at its centre, or just
+// left/above of it for even sizes. Pixels outside of the image never win, so borders behave as
+// if the image were extended with neutral values.
+// Each rectangle is applied as a horizontal then a vertical line using van Herk/Gil-Werman
+// running min/max, about three comparisons per pixel and pass whatever the size.
+void bmp8_erode(t_bmp8 *img, int seWidth, int seHeight);
+void bmp8_dilate(t_bmp8 *img, int seWidth, int seHeight);
+void bmp8_open(t_bmp8 *img, int seWidth, int seHeight);    // Erode, then dilate
+void bmp8_close(t_bmp8 *img, int seWidth, int seHeight);   // Dilate, then erode
+
+#endif // MORPHOLOGY_H
@@ -0,0 +1,897 @@
+#include "pipeline.h"
+#include "kernels.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+// Pixel rows as seen by the executor: memory order (bottom-up for bmp8, top-down for bmp24),
+// interleaved channels. Kernel passes write into fresh storage that replaces the image's own, or
+// into the rows of a spare image of the same size, whose storage is then swapped with the image's.
+typedef struct {
+    t_bmp8 *img8;
+    t_bmp24 *img24;
+    uint8_t **rows;
+    int width;
+    int height;
+    int channels;
+    t_bmp8 *spare8;      // Spare image of the same kind, or NULL to allocate per pass
+    t_bmp24 *spare24;
+    uint8_t **spare;     // Its rows, in the same order as rows
+} t_exec_image;
+
+t_pipeline *pipeline_create(void) {
+    t_pipeline *pipeline = (t_pipeline *)calloc(1, sizeof(t_pipeline));
+    if (!pipeline) {
+        fprintf(stderr, "Error: Failed to allocate pipeline.\n");
+    }
+    return pipeline;
+}
+
+void pipeline_free(t_pipeline *pipeline) {
+    if (!pipeline) return;
+    for (int i = 0; i < pipeline->count; i++) {
+        free(pipeline->ops[i].kernel);
+    }
+    free(pipeline->ops);
+    free(pipeline);
+}
+
+static t_op *pipeline_append(t_pipeline *pipeline, t_op_type type) {
+    if (!pipeline) return NULL;
+    if (pipeline->count == pipeline->capacity) {
+        int capacity = pipeline->capacity ? pipeline->capacity * 2 : 8;
+        t_op *ops = (t_op *)realloc(pipeline->ops, capacity * sizeof(t_op));
+        if (!ops) {
+            fprintf(stderr, "Error: Failed to grow pipeline.\n");
+            return NULL;
+        }
+        pipeline->ops = ops;
+        pipeline->capacity = capacity;
+    }
+    t_op *op = &pipeline->ops[pipeline->count++];
+    memset(op, 0, sizeof(t_op));
+    op->type = type;
+    return op;
+}
+
+int pipeline_addNegative(t_pipeline *pipeline) {
+    return pipeline_append(pipeline, OP_NEGATIVE) ? 0 : -1;
+}
+
+int pipeline_addBrightness(t_pipeline *pipeline, int value) {
+    t_op *op = pipeline_append(pipeline, OP_BRIGHTNESS);
+    if (!op) return -1;
+    op->value = value;
+    return 0;
+}
+
+int pipeline_addThreshold(t_pipeline *pipeline, int threshold) {
+    t_op *op = pipeline_append(pipeline, OP_THRESHOLD);
+    if (!op) return -1;
+    op->value = threshold;
+    return 0;
+}
+
+int pipeline_addKernel(t_pipeline *pipeline, float **kernel, int kernelSize) {
+    if (!kernel || kernelSize < 1 || kernelSize % 2 == 0) {
+        fprintf(stderr, "Error: Invalid kernel for pipeline_addKernel.\n");
+        return -1;
+    }
+    float *values = (float *)malloc(kernelSize * kernelSize * sizeof(float));
+    if (!values) {
+        fprintf(stderr, "Error: Failed to allocate pipeline kernel.\n");
+        return -1;
+    }
+    for (int i = 0; i < kernelSize; i++) {
+        memcpy(values + i * kernelSize, kernel[i], kernelSize * sizeof(float));
+    }
+    t_op *op = pipeline_append(pipeline, OP_KERNEL);
+    if (!op) {
+        free(values);
+        return -1;
+    }
+    op->kernelSize = kernelSize;
+    op->kernel = values;
+    return 0;
+}
+
+int pipeline_addGrayscale(t_pipeline *pipeline) {
+    return pipeline_append(pipeline, OP_GRAYSCALE) ? 0 : -1;
+}
+
+int pipeline_addEqualize(t_pipeline *pipeline) {
+    return pipeline_append(pipeline, OP_EQUALIZE) ? 0 : -1;
+}
+
+t_pipeline *pipeline_parse(const char *spec) {
+    if (!spec) return NULL;
+    t_pipeline *pipeline = pipeline_create();
+    char *copy = (char *)malloc(strlen(spec) + 1);
+    if (!pipeline || !copy) {
+        free(copy);
+        pipeline_free(pipeline);
+        return NULL;
+    }
+    strcpy(copy, spec);
+
+    int status = 0;
+    for (char *token = strtok(copy, ","); token && status == 0; token = strtok(NULL, ",")) {
+        char *argument = strchr(token, '=');
+        if (argument) *argument++ = '\0';
+        int kernelSize;
+        const float *values = find_kernel_values(token, &kernelSize);
+
+        if (strcmp(token, "negative") == 0) status = pipeline_addNegative(pipeline);
+        else if (strcmp(token, "brightness") == 0 && argument) status = pipeline_addBrightness(pipeline, atoi(argument));
+        else if (strcmp(token, "threshold") == 0 && argument) status = pipeline_addThreshold(pipeline, atoi(argument));
+        else if (strcmp(token, "gray") == 0 || strcmp(token, "grayscale") == 0) status = pipeline_addGrayscale(pipeline);
+        else if (strcmp(token, "equalize") == 0) status = pipeline_addEqualize(pipeline);
+        else if (strcmp(token, "merge") == 0) pipeline->mergeKernels = 1;
+        else if (values) {
+            float **kernel = create_kernel(kernelSize, values);
+            status = kernel ? pipeline_addKernel(pipeline, kernel, kernelSize) : -1;
+            free_kernel(kernel, kernelSize);
+        } else {
+            fprintf(stderr, "Error: Unknown operation '%s'.\n", token);
+            status = -1;
+        }
+    }
+    free(copy);
+    if (status != 0) {
+        pipeline_free(pipeline);
+        return NULL;
+    }
+    return pipeline;
+}
+
+static int is_point_op(t_op_type type) {
+    return type == OP_NEGATIVE || type == OP_BRIGHTNESS || type == OP_THRESHOLD || type == OP_LUT;
+}
+
+static void op_to_lut(const t_op *op, uint8_t *lut) {
+    for (int v = 0; v < 256; v++) {
+        switch (op->type) {
+            case OP_NEGATIVE: lut[v] = (uint8_t)(255 - v); break;
+            case OP_BRIGHTNESS: {
+                int new_val = v + op->value;
+                lut[v] = (uint8_t)(new_val < 0 ? 0 : new_val > 255 ? 255 : new_val);
+                break;
+            }
+            case OP_THRESHOLD: lut[v] = (v >= op->value) ? 255 : 0; break;
+            case OP_LUT: lut[v] = op->lut[v]; break;
+            default: lut[v] = (uint8_t)v; break;
+        }
+    }
+}
+
+// first = second after first
+static void compose_lut(uint8_t *first, const uint8_t *second) {
+    for (int v = 0; v < 256; v++) first[v] = second[first[v]];
+}
+
+static int is_identity_lut(const uint8_t *lut) {
+    for (int v = 0; v < 256; v++) {
+        if (lut[v] != v) return 0;
+    }
+    return 1;
+}
+
+static int is_negative_lut(const uint8_t *lut) {
+    for (int v = 0; v < 256; v++) {
+        if (lut[v] != 255 - v) return 0;
+    }
+    return 1;
+}
+
+static int is_identity_kernel(const t_op *op) {
+    int size = op->kernelSize;
+    for (int i = 0; i < size * size; i++) {
+        float expected = (i == size * size / 2) ? 1.0f : 0.0f;
+        if (op->kernel[i] != expected) return 0;
+    }
+    return 1;
+}
+
+// A non-negative kernel whose weights sum to at most 1 never clamps, so only the rounding of its
+// output is lost when it is merged into the next kernel
+static int kernel_never_clamps(const t_op *op) {
+    float sum = 0.0f;
+    for (int i = 0; i < op->kernelSize * op->kernelSize; i++) {
+        if (op->kernel[i] < 0.0f) return 0;
+        sum += op->kernel[i];
+    }
+    return sum <= 1.0f + 1e-6f;
+}
+
+// Replaces ops[index] and ops[index + 1] by their full 2D convolution
+static int merge_kernels(t_pipeline *pipeline, int index) {
+    t_op *first = &pipeline->ops[index];
+    t_op *second = &pipeline->ops[index + 1];
+    int sa = first->kernelSize, sb = second->kernelSize, sc = sa + sb - 1;
+    float *merged = (float *)calloc(sc * sc, sizeof(float));
+    if (!merged) return 0;
+    for (int ai = 0; ai < sa; ai++)
+        for (int aj = 0; aj < sa; aj++)
+            for (int bi = 0; bi < sb; bi++)
+                for (int bj = 0; bj < sb; bj++)
+                    merged[(ai + bi) * sc + aj + bj] += first->kernel[ai * sa + aj] * second->kernel[bi * sb + bj];
+    free(first->kernel);
+    free(second->kernel);
+    first->kernel = merged;
+    first->kernelSize = sc;
+    memmove(second, second + 1, (pipeline->count - index - 2) * sizeof(t_op));
+    pipeline->count--;
+    return 1;
+}
+
+static void remove_op(t_pipeline *pipeline, int index) {
+    free(pipeline->ops[index].kernel);
+    memmove(&pipeline->ops[index], &pipeline->ops[index + 1], (pipeline->count - index - 1) * sizeof(t_op));
+    pipeline->count--;
+}
+
+void pipeline_optimize(t_pipeline *pipeline) {
+    if (!pipeline) return;
+
+    for (int i = 0; i < pipeline->count; i++) {
+        t_op *op = &pipeline->ops[i];
+        if (is_point_op(op->type) && op->type != OP_LUT) {
+            op_to_lut(op, op->lut);
+            op->type = OP_LUT;
+        }
+    }
+
+    // Apply the rewrite rules until none of them matches any more
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = 0; i < pipeline->count && !changed; i++) {
+            t_op *op = &pipeline->ops[i];
+            t_op *next = (i + 1 < pipeline->count) ? &pipeline->ops[i + 1] : NULL;
+
+            if ((op->type == OP_LUT && is_identity_lut(op->lut)) ||
+                (op->type == OP_KERNEL && is_identity_kernel(op))) {
+                remove_op(pipeline, i);
+                changed = 1;
+            } else if (!next) {
+                break;
+            } else if (op->type == OP_LUT && next->type == OP_LUT) {
+                compose_lut(op->lut, next->lut);
+                remove_op(pipeline, i + 1);
+                changed = 1;
+            } else if (op->type == OP_GRAYSCALE && next->type == OP_GRAYSCALE) {
+                remove_op(pipeline, i + 1);
+                changed = 1;
+            } else if (op->type == OP_LUT && is_negative_lut(op->lut) && next->type == OP_GRAYSCALE) {
+                // mean(255 - r, 255 - g, 255 - b) == 255 - mean(r, g, b), with the same rounding,
+                // and every op after grayscale only processes one channel
+                t_op swap = *op;
+                *op = *next;
+                *next = swap;
+                changed = 1;
+            } else if (pipeline->mergeKernels && op->type == OP_KERNEL && next->type == OP_KERNEL &&
+                       kernel_never_clamps(op)) {
+                int merged_size = op->kernelSize + next->kernelSize - 1;
+                int separate_cost = op->kernelSize * op->kernelSize + next->kernelSize * next->kernelSize + 2 * PIPELINE_PASS_COST;
+                int merged_cost = merged_size * merged_size + PIPELINE_PASS_COST;
+                if (merged_cost < separate_cost) {
+                    changed = merge_kernels(pipeline, i);
+                }
+            }
+        }
+    }
+}
+
+static void lut_pass(t_exec_image *im, const uint8_t *lut) {
+    size_t row_len = (size_t)im->width * im->channels;
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < im->height; y++) {
+        uint8_t *row = im->rows[y];
+        for (size_t i = 0; i < row_len; i++) {
+            row[i] = lut[row[i]];
+        }
+    }
+}
+
+static uint8_t clamp_sum(float sum) {
+    if (sum < 0.0f) return 0;
+    if (sum > 255.0f) return 255;
+    return (uint8_t)roundf(sum);
+}
+
+// Fresh row storage with the layout of the image: one block for bmp8, one allocation per row for bmp24
+static uint8_t **allocate_rows(const t_exec_image *im) {
+    size_t row_len = (size_t)im->width * im->channels;
+    uint8_t **rows = (uint8_t **)malloc(im->height * sizeof(uint8_t *));
+    if (!rows) return NULL;
+    if (im->img8) {
+        uint8_t *block = (uint8_t *)malloc(row_len * im->height);
+        if (!block) {
+            free(rows);
+            return NULL;
+        }
+        for (int y = 0; y < im->height; y++) rows[y] = block + (size_t)y * row_len;
+    } else {
+        for (int y = 0; y < im->height; y++) {
+            rows[y] = (uint8_t *)malloc(row_len);
+            if (!rows[y]) {
+                for (int k = 0; k < y; k++) free(rows[k]);
+                free(rows);
+                return NULL;
+            }
+        }
+    }
+    return rows;
+}
+
+static void free_rows(const t_exec_image *im, uint8_t **rows) {
+    if (im->img8) free(rows[0]);
+    else for (int y = 0; y < im->height; y++) free(rows[y]);
+    free(rows);
+}
+
+// Makes rows from allocate_rows the image's pixel storage and frees the previous one. Views of
+// a caller's buffer keep their storage, the rows are copied into it instead.
+static void replace_rows(t_exec_image *im, uint8_t **rows) {
+    if ((im->img8 && im->img8->view) || (im->img24 && im->img24->view)) {
+        size_t row_len = (size_t)im->width * im->channels;
+        #pragma omp parallel for schedule(static)
+        for (int y = 0; y < im->height; y++) memcpy(im->rows[y], rows[y], row_len);
+        free_rows(im, rows);
+    } else if (im->img8) {
+        free(im->img8->data);
+        im->img8->data = rows[0];
+        memcpy(im->rows, rows, im->height * sizeof(uint8_t *));
+        free(rows);
+    } else {
+        bmp24_freeDataPixels(im->img24->data, im->height);
+        im->img24->data = (t_pixel **)rows;
+        im->rows = rows;
+    }
+}
+
+// Makes the spare rows a pass just wrote the image's storage and hands the previous storage to
+// the spare, so the next pass writes there without allocating
+static void swap_spare(t_exec_image *im) {
+    if (im->img8) {
+        unsigned char *data = im->img8->data;
+        im->img8->data = im->spare8->data;
+        im->spare8->data = data;
+    } else {
+        t_pixel **data = im->img24->data;
+        im->img24->data = im->spare24->data;
+        im->spare24->data = data;
+    }
+    uint8_t **rows = im->rows;
+    im->rows = im->spare;
+    im->spare = rows;
+}
+
+// One output pixel of a kernel centred on rows[y][x]; with computed == 1 (gray image), channel 0
+// is evaluated once and written to every channel
+static void convolve_pixel(uint8_t *const *rows, int x, int y, int channels, int computed,
+                           const t_op *op, const uint8_t *post, uint8_t *out) {
+    int size = op->kernelSize, n = size / 2;
+    for (int c = 0; c < computed; c++) {
+        float sum = 0.0f;
+        for (int i = -n; i <= n; i++) {
+            const uint8_t *row = rows[y - i];
+            const float *k = op->kernel + (i + n) * size + n;
+            for (int j = -n; j <= n; j++) {
+                sum += (float)row[(x - j) * channels + c] * k[j];
+            }
+        }
+        uint8_t v = clamp_sum(sum);
+        if (post) v = post[v];
+        if (computed == 1) {
+            for (int g = 0; g < channels; g++) out[g] = v;
+        } else {
+            out[c] = v;
+        }
+    }
+}
+
+// Same arithmetic as bmp8_applyFilter and bmp24_convolution: I(x - j, y - i) * k[i][j], summed
+// in float over interior centres, the border ring copied. With gray set, channel 0 is computed
+// once and written to every channel.
+static int kernel_pass(t_exec_image *im, const t_op *op, const uint8_t *post, int gray) {
+    int width = im->width, height = im->height, channels = im->channels;
+    uint8_t **dst_rows = allocate_rows(im);
+    if (!dst_rows) return -1;
+
+    int n = op->kernelSize / 2;
+    int computed = gray ? 1 : channels;
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < height; y++) {
+        const uint8_t *src = im->rows[y];
+        uint8_t *dst = dst_rows[y];
+        int interior_row = (y >= n && y < height - n);
+        for (int x = 0; x < width; x++) {
+            if (!interior_row || x < n || x >= width - n) {
+                for (int c = 0; c < channels; c++) {
+                    uint8_t v = src[x * channels + c];
+                    dst[x * channels + c] = post ? post[v] : v;
+                }
+            } else {
+                convolve_pixel(im->rows, x, y, channels, computed, op, post, dst + x * channels);
+            }
+        }
+    }
+
+    replace_rows(im, dst_rows);
+    return 0;
+}
+
+// Grayscale (rounded mean) of bmp24 rows, with point ops before and after folded into the pass
+static void gray_pass(t_exec_image *im, const uint8_t *pre, const uint8_t *post) {
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < im->height; y++) {
+        uint8_t *row = im->rows[y];
+        for (int x = 0; x < im->width; x++) {
+            uint8_t *p = row + x * 3;
+            int sum = pre ? pre[p[0]] + pre[p[1]] + pre[p[2]] : p[0] + p[1] + p[2];
+            uint8_t gray = (uint8_t)((sum + 1) / 3);   // == roundf(sum / 3.0f)
+            if (post) gray = post[gray];
+            p[0] = p[1] = p[2] = gray;
+        }
+    }
+}
+
+// bmp8 equalization: the histogram after `pre` is derived from the raw histogram, so the
+// preceding point ops, the equalization map and the following point ops share one write pass
+static int equalize8_pass(t_exec_image *im, const uint8_t *pre, const uint8_t *post) {
+    unsigned int raw[256] = {0};
+    #pragma omp parallel for reduction(+:raw[:256]) schedule(static)
+    for (int y = 0; y < im->height; y++) {
+        const uint8_t *row = im->rows[y];
+        for (int x = 0; x < im->width; x++) raw[row[x]]++;
+    }
+    unsigned int hist[256] = {0};
+    for (int v = 0; v < 256; v++) hist[pre ? pre[v] : v] += raw[v];
+
+    unsigned int *map = bmp8_computeCDF(hist);
+    if (!map) return -1;
+    uint8_t lut[256];
+    for (int v = 0; v < 256; v++) {
+        uint8_t eq = (uint8_t)map[pre ? pre[v] : v];
+        lut[v] = post ? post[eq] : eq;
+    }
+    free(map);
+    lut_pass(im, lut);
+    return 0;
+}
+
+static int execute(const t_pipeline *pipeline, t_exec_image *im) {
+    uint8_t pending[256];
+    int has_pending = 0;
+    int gray = (im->channels == 1);
+    int status = 0;
+
+    for (int i = 0; i < pipeline->count && status == 0; i++) {
+        const t_op *op = &pipeline->ops[i];
+        if (is_point_op(op->type)) {
+            uint8_t lut[256];
+            op_to_lut(op, lut);
+            if (!has_pending) memcpy(pending, lut, sizeof(pending));
+            else compose_lut(pending, lut);
+            has_pending = 1;
+            continue;
+        }
+
+        // A point op right after a pass is applied as that pass writes its results
+        uint8_t post_lut[256];
+        const uint8_t *post = NULL;
+        int fuse_next = (i + 1 < pipeline->count && is_point_op(pipeline->ops[i + 1].type));
+        if (fuse_next) {
+            op_to_lut(&pipeline->ops[i + 1], post_lut);
+        }
+
+        switch (op->type) {
+            case OP_KERNEL:
+                if (has_pending) lut_pass(im, pending);
+                has_pending = 0;
+                post = fuse_next ? post_lut : NULL;
+                status = kernel_pass(im, op, post, gray && im->channels > 1);
+                break;
+            case OP_GRAYSCALE:
+                if (im->channels == 1) continue;   // bmp8 is already gray
+                post = fuse_next ? post_lut : NULL;
+                gray_pass(im, has_pending ? pending : NULL, post);
+                has_pending = 0;
+                gray = 1;
+                break;
+            case OP_EQUALIZE:
+                if (im->channels == 1) {
+                    post = fuse_next ? post_lut : NULL;
+                    status = equalize8_pass(im, has_pending ? pending : NULL, post);
+                } else {
+                    if (has_pending) lut_pass(im, pending);
+                    bmp24_equalize(im->img24);
+                    gray = 0;
+                }
+                has_pending = 0;
+                break;
+            default:
+                break;
+        }
+        if (post) i++;
+    }
+    if (status == 0 && has_pending) lut_pass(im, pending);
+    if (status != 0) fprintf(stderr, "Error: Failed to allocate memory while executing pipeline.\n");
+    return status;
+}
+
+// Side of a square output tile such that the two working buffers of a tile, halo included,
+// take half of the L2 cache
+static int default_tile_size(int channels, int halo) {
+    long l2_size = 0;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    l2_size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    if (l2_size <= 0) l2_size = PIPELINE_DEFAULT_L2_SIZE;
+    int side = (int)sqrt((double)l2_size / 4.0 / channels);
+    int tile = side - 2 * halo;
+    return tile < 16 ? 16 : tile;
+}
+
+// Working storage of one thread for run_tile: two tile buffers of side * side pixels
+typedef struct {
+    uint8_t *a;
+    uint8_t *b;
+    uint8_t **rows_a;
+    uint8_t **rows_b;
+} t_tile_buffers;
+
+static int allocate_tile_buffers(t_tile_buffers *buffers, int side, int channels) {
+    size_t buffer_size = (size_t)side * side * channels;
+    buffers->a = (uint8_t *)malloc(buffer_size);
+    buffers->b = (uint8_t *)malloc(buffer_size);
+    buffers->rows_a = (uint8_t **)malloc(side * sizeof(uint8_t *));
+    buffers->rows_b = (uint8_t **)malloc(side * sizeof(uint8_t *));
+    return (buffers->a && buffers->b && buffers->rows_a && buffers->rows_b) ? 0 : -1;
+}
+
+static void free_tile_buffers(t_tile_buffers *buffers) {
+    free(buffers->a);
+    free(buffers->b);
+    free(buffers->rows_a);
+    free(buffers->rows_b);
+}
+
+// Computes the out rectangle of ops[first, last), which holds no equalization, from src into
+// dst. The tile loads its input with the cumulative halo of every kernel, and the valid area
+// shrinks by each kernel's radius, so all intermediate results stay in the two tile buffers.
+static void run_tile(const t_pipeline *pipeline, int first, int last, uint8_t *const *src, uint8_t *const *dst,
+                     int width, int height, int channels, int halo, int gray_in, t_rect out,
+                     const t_tile_buffers *buffers) {
+    uint8_t **rows_a = buffers->rows_a, **rows_b = buffers->rows_b;
+    t_rect in;
+    t_rect grown = rect_expand(out, halo);
+    rect_clip(&grown, width, height, &in);
+
+    size_t stride = (size_t)in.width * channels;
+    for (int y = 0; y < in.height; y++) {
+        rows_a[y] = buffers->a + y * stride;
+        rows_b[y] = buffers->b + y * stride;
+        memcpy(rows_a[y], src[in.y + y] + (size_t)in.x * channels, stride);
+    }
+
+    int remaining = halo;
+    int g = gray_in;
+    for (int i = first; i < last; i++) {
+        const t_op *op = &pipeline->ops[i];
+        t_rect valid;
+        grown = rect_expand(out, remaining);
+        rect_clip(&grown, width, height, &valid);
+
+        if (is_point_op(op->type)) {
+            uint8_t lut[256];
+            op_to_lut(op, lut);
+            for (int y = valid.y; y < valid.y + valid.height; y++) {
+                uint8_t *row = rows_a[y - in.y] + (size_t)(valid.x - in.x) * channels;
+                for (int k = 0; k < valid.width * channels; k++) row[k] = lut[row[k]];
+            }
+        } else if (op->type == OP_GRAYSCALE && channels == 3) {
+            for (int y = valid.y; y < valid.y + valid.height; y++) {
+                uint8_t *row = rows_a[y - in.y] + (size_t)(valid.x - in.x) * 3;
+                for (int x = 0; x < valid.width; x++) {
+                    uint8_t *p = row + x * 3;
+                    p[0] = p[1] = p[2] = (uint8_t)((p[0] + p[1] + p[2] + 1) / 3);
+                }
+            }
+            g = 1;
+        } else if (op->type == OP_KERNEL) {
+            int n = op->kernelSize / 2;
+            int computed = (g && channels > 1) ? 1 : channels;
+            remaining -= n;
+            grown = rect_expand(out, remaining);
+            rect_clip(&grown, width, height, &valid);
+            for (int y = valid.y; y < valid.y + valid.height; y++) {
+                const uint8_t *src_row = rows_a[y - in.y];
+                uint8_t *dst_row = rows_b[y - in.y];
+                int interior_row = (y >= n && y < height - n);
+                for (int x = valid.x; x < valid.x + valid.width; x++) {
+                    int lx = x - in.x;
+                    if (!interior_row || x < n || x >= width - n) {
+                        memcpy(dst_row + lx * channels, src_row + lx * channels, channels);
+                    } else {
+                        convolve_pixel(rows_a, lx, y - in.y, channels, computed, op, NULL, dst_row + lx * channels);
+                    }
+                }
+            }
+            uint8_t **swap_rows = rows_a;
+            rows_a = rows_b;
+            rows_b = swap_rows;
+        }
+    }
+
+    for (int y = out.y; y < out.y + out.height; y++) {
+        memcpy(dst[y] + (size_t)out.x * channels, rows_a[y - in.y] + (size_t)(out.x - in.x) * channels,
+               (size_t)out.width * channels);
+    }
+}
+
+// Covers each of the count areas with tiles of at most tile x tile pixels and runs them across
+// threads. The areas must not overlap. Returns 0 on success, -1 on allocation failure.
+static int run_tiles(const t_pipeline *pipeline, int first, int last, uint8_t *const *src, uint8_t *const *dst,
+                     int width, int height, int channels, int gray_in, const t_rect *areas, int count,
+                     int tile_size) {
+    int halo = 0;
+    for (int i = first; i < last; i++) {
+        if (pipeline->ops[i].type == OP_KERNEL) halo += pipeline->ops[i].kernelSize / 2;
+    }
+    int tile = tile_size > 0 ? tile_size : default_tile_size(channels, halo);
+
+    // Tiles before each area, so one loop spreads the tiles of every area across threads
+    int *starts = (int *)malloc((count + 1) * sizeof(int));
+    if (!starts) return -1;
+    starts[0] = 0;
+    for (int k = 0; k < count; k++) {
+        int tiles_x = (areas[k].width + tile - 1) / tile, tiles_y = (areas[k].height + tile - 1) / tile;
+        starts[k + 1] = starts[k] + tiles_x * tiles_y;
+    }
+    int status = 0;
+
+    #pragma omp parallel
+    {
+        t_tile_buffers buffers;
+        if (allocate_tile_buffers(&buffers, tile + 2 * halo, channels) != 0) {
+            #pragma omp atomic write
+            status = -1;
+        }
+
+        #pragma omp for schedule(dynamic)
+        for (int t = 0; t < starts[count]; t++) {
+            if (!buffers.a || !buffers.b || !buffers.rows_a || !buffers.rows_b) continue;
+            int k = 0;
+            while (t >= starts[k + 1]) k++;
+            const t_rect *area = &areas[k];
+            int tiles_x = (area->width + tile - 1) / tile;
+            int index = t - starts[k];
+            t_rect out = {area->x + (index % tiles_x) * tile, area->y + (index / tiles_x) * tile, tile, tile};
+            rect_intersect(&out, area, &out);
+            run_tile(pipeline, first, last, src, dst, width, height, channels, halo, gray_in, out, &buffers);
+        }
+        free_tile_buffers(&buffers);
+    }
+    free(starts);
+    return status;
+}
+
+// Runs ops[first, last), which holds no equalization, one output tile at a time
+static int execute_tiled_segment(const t_pipeline *pipeline, int first, int last, t_exec_image *im,
+                                 int tile_size, int *gray) {
+    if (first == last) return 0;
+    uint8_t **dst_rows = im->spare ? im->spare : allocate_rows(im);
+    if (!dst_rows) return -1;
+
+    t_rect whole = {0, 0, im->width, im->height};
+    int status = run_tiles(pipeline, first, last, im->rows, dst_rows, im->width, im->height, im->channels, *gray,
+                           &whole, 1, tile_size);
+    for (int i = first; i < last; i++) {
+        if (pipeline->ops[i].type == OP_GRAYSCALE) *gray = 1;
+    }
+    if (status != 0) {
+        // dst_rows only holds part of the result, keep the image untouched
+        if (!im->spare) free_rows(im, dst_rows);
+        return -1;
+    }
+    if (im->spare) swap_spare(im);
+    else replace_rows(im, dst_rows);
+    return 0;
+}
+
+static int execute_tiled(const t_pipeline *pipeline, t_exec_image *im, int tile_size) {
+    int gray = (im->channels == 1);
+    int first = 0;
+    int status = 0;
+    for (int i = 0; i <= pipeline->count && status == 0; i++) {
+        if (i < pipeline->count && pipeline->ops[i].type != OP_EQUALIZE) continue;
+        status = execute_tiled_segment(pipeline, first, i, im, tile_size, &gray);
+        if (status == 0 && i < pipeline->count) {
+            // Equalization needs the whole image's histogram, so it separates tiled segments
+            if (im->channels == 1) {
+                status = equalize8_pass(im, NULL, NULL);
+            } else {
+                bmp24_equalize(im->img24);
+                gray = 0;
+            }
+        }
+        first = i + 1;
+    }
+    if (status != 0) fprintf(stderr, "Error: Failed to allocate memory while executing pipeline.\n");
+    return status;
+}
+
+int pipeline_executeBmp8(const t_pipeline *pipeline, t_bmp8 *img) {
+    if (!pipeline || !img || !img->data) return -1;
+    t_exec_image im = {img, NULL, NULL, (int)img->width, (int)img->height, 1, NULL, NULL, NULL};
+    im.rows = (uint8_t **)malloc(img->height * sizeof(uint8_t *));
+    if (!im.rows) return -1;
+    for (unsigned int y = 0; y < img->height; y++) im.rows[y] = img->data + (size_t)y * img->width;
+    int status = execute(pipeline, &im);
+    free(im.rows);
+    return status;
+}
+
+int pipeline_executeBmp24(const t_pipeline *pipeline, t_bmp24 *img) {
+    if (!pipeline || !img || !img->data) return -1;
+    t_exec_image im = {NULL, img, (uint8_t **)img->data, img->width, img->height, 3, NULL, NULL, NULL};
+    return execute(pipeline, &im);
+}
+
+static uint8_t **bmp8_rows(const t_bmp8 *img) {
+    uint8_t **rows = (uint8_t **)malloc(img->height * sizeof(uint8_t *));
+    if (!rows) return NULL;
+    for (unsigned int y = 0; y < img->height; y++) rows[y] = img->data + (size_t)y * img->width;
+    return rows;
+}
+
+// A spare that is missing, a view or of another size is ignored, and passes allocate instead
+static int usable_spare8(const t_bmp8 *img, const t_bmp8 *spare) {
+    return spare && spare->data && !spare->view && !img->view && spare->width == img->width &&
+           spare->height == img->height;
+}
+
+static int usable_spare24(const t_bmp24 *img, const t_bmp24 *spare) {
+    return spare && spare->data && !spare->view && !img->view && spare->width == img->width &&
+           spare->height == img->height;
+}
+
+int pipeline_executeTiledBmp8(const t_pipeline *pipeline, t_bmp8 *img, int tileSize) {
+    return pipeline_executeTiledSpareBmp8(pipeline, img, NULL, tileSize);
+}
+
+int pipeline_executeTiledBmp24(const t_pipeline *pipeline, t_bmp24 *img, int tileSize) {
+    return pipeline_executeTiledSpareBmp24(pipeline, img, NULL, tileSize);
+}
+
+int pipeline_executeTiledSpareBmp8(const t_pipeline *pipeline, t_bmp8 *img, t_bmp8 *spare, int tileSize) {
+    if (!pipeline || !img || !img->data) return -1;
+    t_exec_image im = {img, NULL, NULL, (int)img->width, (int)img->height, 1, NULL, NULL, NULL};
+    im.rows = bmp8_rows(img);
+    if (usable_spare8(img, spare)) {
+        im.spare8 = spare;
+        im.spare = bmp8_rows(spare);
+    }
+    int status = -1;
+    if (im.rows && (!im.spare8 || im.spare)) status = execute_tiled(pipeline, &im, tileSize);
+    free(im.rows);
+    free(im.spare);
+    return status;
+}
+
+int pipeline_executeTiledSpareBmp24(const t_pipeline *pipeline, t_bmp24 *img, t_bmp24 *spare, int tileSize) {
+    if (!pipeline || !img || !img->data) return -1;
+    t_exec_image im = {NULL, img, (uint8_t **)img->data, img->width, img->height, 3, NULL, NULL, NULL};
+    if (usable_spare24(img, spare)) {
+        im.spare24 = spare;
+        im.spare = (uint8_t **)spare->data;
+    }
+    return execute_tiled(pipeline, &im, tileSize);
+}
+
+// Radius around a changed input pixel within which one op changes its output, -1 for all of it
+static int op_footprint(const t_op *op) {
+    switch (op->type) {
+        case OP_KERNEL: return op->kernelSize / 2;
+        case OP_EQUALIZE: return -1;
+        default: return 0;
+    }
+}
+
+int pipeline_footprint(const t_pipeline *pipeline) {
+    if (!pipeline) return -1;
+    int reach = 0;
+    for (int i = 0; i < pipeline->count; i++) {
+        int radius = op_footprint(&pipeline->ops[i]);
+        if (radius < 0) return -1;
+        reach += radius;
+    }
+    return reach;
+}
+
+// Recomputes the footprint of every dirty rectangle of src into dst. bottom_up rows (bmp8)
+// turn the top-left rectangles upside down first.
+static int update(const t_pipeline *pipeline, t_exec_image *src, t_exec_image *dst, const t_dirty_region *dirty,
+                  int bottom_up) {
+    int reach = pipeline_footprint(pipeline);
+    if (reach < 0) {
+        size_t row_len = (size_t)src->width * src->channels;
+        #pragma omp parallel for schedule(static)
+        for (int y = 0; y < src->height; y++) memcpy(dst->rows[y], src->rows[y], row_len);
+        return execute_tiled(pipeline, dst, 0);
+    }
+    // Footprints of neighbouring changes overlap; merging them keeps every output computed once
+    t_dirty_region areas;
+    dirty_clear(&areas);
+    for (int i = 0; i < dirty->count; i++) {
+        t_rect r = dirty->rects[i], area;
+        if (bottom_up) r.y = src->height - r.y - r.height;
+        r = rect_expand(r, reach);
+        if (rect_clip(&r, src->width, src->height, &area)) dirty_add(&areas, &area);
+    }
+    if (areas.count == 0) return 0;
+    int status = run_tiles(pipeline, 0, pipeline->count, src->rows, dst->rows, src->width, src->height,
+                           src->channels, src->channels == 1, areas.rects, areas.count, 0);
+    if (status != 0) fprintf(stderr, "Error: Failed to allocate memory while updating pipeline result.\n");
+    return status;
+}
+
+int pipeline_updateBmp8(const t_pipeline *pipeline, const t_bmp8 *source, t_bmp8 *result,
+                        const t_dirty_region *dirty) {
+    if (!pipeline || !source || !source->data || !result || !result->data || !dirty) return -1;
+    if (source->width != result->width || source->height != result->height) {
+        fprintf(stderr, "Error: Pipeline result and source differ in size.\n");
+        return -1;
+    }
+    int w = (int)source->width, h = (int)source->height;
+    t_exec_image src = {(t_bmp8 *)source, NULL, NULL, w, h, 1, NULL, NULL, NULL};
+    t_exec_image dst = {result, NULL, NULL, w, h, 1, NULL, NULL, NULL};
+    src.rows = (uint8_t **)malloc(h * sizeof(uint8_t *));
+    dst.rows = (uint8_t **)malloc(h * sizeof(uint8_t *));
+    int status = -1;
+    if (src.rows && dst.rows) {
+        for (int y = 0; y < h; y++) {
+            src.rows[y] = source->data + (size_t)y * w;
+            dst.rows[y] = result->data + (size_t)y * w;
+        }
+        status = update(pipeline, &src, &dst, dirty, 1);
+    }
+    free(src.rows);
+    free(dst.rows);
+    return status;
+}
+
+int pipeline_updateBmp24(const t_pipeline *pipeline, const t_bmp24 *source, t_bmp24 *result,
+                         const t_dirty_region *dirty) {
+    if (!pipeline || !source || !source->data || !result || !result->data || !dirty) return -1;
+    if (source->width != result->width || source->height != result->height) {
+        fprintf(stderr, "Error: Pipeline result and source differ in size.\n");
+        return -1;
+    }
+    t_exec_image src = {NULL, (t_bmp24 *)source, (uint8_t **)source->data, source->width, source->height, 3,
+                        NULL, NULL, NULL};
+    t_exec_image dst = {NULL, result, (uint8_t **)result->data, result->width, result->height, 3, NULL, NULL, NULL};
+    return update(pipeline, &src, &dst, dirty, 0);
+}
+
+void pipeline_print(const t_pipeline *pipeline) {
+    if (!pipeline) return;
+    printf("Pipeline (%d ops):\n", pipeline->count);
+    for (int i = 0; i < pipeline->count; i++) {
+        const t_op *op = &pipeline->ops[i];
+        switch (op->type) {
+            case OP_NEGATIVE: printf("  %d. Negative\n", i + 1); break;
+            case OP_BRIGHTNESS: printf("  %d. Brightness %+d\n", i + 1, op->value); break;
+            case OP_THRESHOLD: printf("  %d. Threshold %d\n", i + 1, op->value); break;
+            case OP_LUT: printf("  %d. Lookup table\n", i + 1); break;
+            case OP_KERNEL: printf("  %d. Kernel %dx%d\n", i + 1, op->kernelSize, op->kernelSize); break;
+            case OP_GRAYSCALE: printf("  %d. Grayscale\n", i + 1); break;
+            case OP_EQUALIZE: printf("  %d. Histogram equalization\n", i + 1); break;
+        }
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdint.h>
+#include "bmp8.h"
+#include "bmp24.h"
+
+// Relative cost of one full pass over memory, in multiply-adds per pixel. Used by the optimizer
+// to decide whether merging two kernels into a larger one is worth saving a pass.
+#define PIPELINE_PASS_COST 16
+
+// L2 size assumed for tiling when the system does not report one
+#define PIPELINE_DEFAULT_L2_SIZE (256 * 1024)
+
+typedef enum {
+    OP_NEGATIVE,
+    OP_BRIGHTNESS,
+    OP_THRESHOLD,
+    OP_LUT,          // Folded point operations, produced by pipeline_optimize
+    OP_KERNEL,
+    OP_GRAYSCALE,
+    OP_EQUALIZE
+} t_op_type;
+
+typedef struct {
+    t_op_type type;
+    int value;           // Brightness offset or threshold
+    uint8_t lut[256];    // OP_LUT only
+    int kernelSize;      // OP_KERNEL only
+    float *kernel;       // kernelSize * kernelSize values, row-major
+} t_op;
+
+// Deferred chain of operations: ops are only recorded, then optimized and run in as few
+// passes over the image as possible.
+typedef struct {
+    t_op *ops;
+    int count;
+    int capacity;
+    int mergeKernels;    // Opt-in, see pipeline_optimize; off after pipeline_create
+} t_pipeline;
+
+t_pipeline *pipeline_create(void);
+void pipeline_free(t_pipeline *pipeline);
+
+int pipeline_addNegative(t_pipeline *pipeline);
+int pipeline_addBrightness(t_pipeline *pipeline, int value);
+int pipeline_addThreshold(t_pipeline *pipeline, int threshold);
+int pipeline_addKernel(t_pipeline *pipeline, float **kernel, int kernelSize);
+int pipeline_addGrayscale(t_pipeline *pipeline);
+int pipeline_addEqualize(t_pipeline *pipeline);
+
+// Builds a pipeline from a comma separated list such as "gaussian,sharpen,brightness=20,gray".
+// Known names: negative, brightness=N, threshold=N, gray, equalize and the kernels of kernels.h.
+// The name merge adds no op but sets mergeKernels, wherever it appears in the list.
+t_pipeline *pipeline_parse(const char *spec);
+
+// Rewrites the recorded ops into an equivalent plan with the same output: point ops are folded
+// into one LUT, identity LUTs and kernels are dropped and grayscale is moved ahead of negatives.
+// Only when mergeKernels is set, consecutive kernels after a non-negative one whose sum stays
+// within 1 are merged when that is cheaper. Merged kernels skip the intermediate rounding, which
+// the second kernel amplifies: gaussian,sharpen and box,sharpen differ from the separate passes
+// by up to 4 levels and gaussian,outline by up to 7, and the border ring is left as a single
+// larger kernel would.
+void pipeline_optimize(t_pipeline *pipeline);
+
+// Run the (optimized or not) plan. Return 0 on success, -1 on allocation failure.
+int pipeline_executeBmp8(const t_pipeline *pipeline, t_bmp8 *img);
+int pipeline_executeBmp24(const t_pipeline *pipeline, t_bmp24 *img);
+
+// Same results as the functions above, computed tile by tile: every chain of kernels, point ops
+// and grayscale between two equalizations runs on L2-sized tiles that carry the chain's
+// cumulative halo, so intermediate results never go back to main memory. Tiles are spread
+// across threads. tileSize 0 derives the tile side from the L2 cache size.
+int pipeline_executeTiledBmp8(const t_pipeline *pipeline, t_bmp8 *img, int tileSize);
+int pipeline_executeTiledBmp24(const t_pipeline *pipeline, t_bmp24 *img, int tileSize);
+// Same, but each tiled pass writes into the rows of spare, an image of img's size, and then swaps
+// the pixel storage of the two, so a caller running many images of one size allocates no pixel
+// storage per call. img holds the result, spare scratch pixels. A spare of another size or a
+// view is ignored.
+int pipeline_executeTiledSpareBmp8(const t_pipeline *pipeline, t_bmp8 *img, t_bmp8 *spare, int tileSize);
+int pipeline_executeTiledSpareBmp24(const t_pipeline *pipeline, t_bmp24 *img, t_bmp24 *spare, int tileSize);
+
+// How far a changed input pixel spreads through the plan: the sum of the kernel radii, as each op
+// declares its footprint. Returns -1 when any change affects the whole result (equalization).
+int pipeline_footprint(const t_pipeline *pipeline);
+
+// Bring result, the plan's output for an earlier version of source, up to date with the changes
+// recorded in dirty. Only the outputs within the footprint of a dirty rectangle are recomputed,
+// tile by tile from source with the kernel halos, so the result is identical to running the plan
+// on a copy of source, at a cost proportional to the changed area. Plans with a footprint of -1
+// are run in full. result must have the size of source. Return 0 on success, -1 on error.
+int pipeline_updateBmp8(const t_pipeline *pipeline, const t_bmp8 *source, t_bmp8 *result,
+                        const t_dirty_region *dirty);
+int pipeline_updateBmp24(const t_pipeline *pipeline, const t_bmp24 *source, t_bmp24 *result,
+                         const t_dirty_region *dirty);
+
+void pipeline_print(const t_pipeline *pipeline);
+
+#endif // PIPELINE_H
@@ -0,0 +1,61 @@
+#include "probe.h"
+#include "qoi.h"
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static unsigned int read_u32(const unsigned char *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static unsigned int read_u16(const unsigned char *p) {
+    return p[0] | (p[1] << 8);
+}
+
+int bmp_probeHeader(const unsigned char *header, t_bmp_probe *probe) {
+    return bmp_probeMemory(header, PROBE_HEADER_SIZE, probe);
+}
+
+int bmp_probeMemory(const void *data, size_t size, t_bmp_probe *probe) {
+    const unsigned char *header = (const unsigned char *)data;
+    int width, height;
+    if (qoi_readHeader(header, size, &width, &height) == 0) {
+        memset(probe, 0, sizeof(*probe));
+        probe->width = width;
+        probe->height = height;
+        probe->topDown = 1;
+        probe->depth = 24;
+        probe->dataOffset = QOI_HEADER_SIZE;
+        probe->format = IMAGE_FORMAT_QOI;
+        return 0;
+    }
+    if (size < PROBE_HEADER_SIZE || header[0] != 'B' || header[1] != 'M') return -1;
+    // BITMAPINFOHEADER or a later version, which all start with the same fields
+    if (read_u32(header + 14) < 40) return -1;
+    width = (int)read_u32(header + 18);
+    height = (int)read_u32(header + 22);
+    if (width <= 0 || height == 0 || height == (int)0x80000000u) return -1;
+
+    memset(probe, 0, sizeof(*probe));
+    probe->width = width;
+    probe->height = height < 0 ? -height : height;
+    probe->topDown = height < 0;
+    probe->depth = (int)read_u16(header + 28);
+    probe->compression = read_u32(header + 30);
+    probe->dataOffset = read_u32(header + 10);
+    return 0;
+}
+
+int bmp_probe(const char *filename, t_bmp_probe *probe) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return -1;
+    unsigned char header[PROBE_HEADER_SIZE];
+    struct stat st;
+    ssize_t n = pread(fd, header, sizeof(header), 0);
+    int ok = n > 0 && fstat(fd, &st) == 0;
+    close(fd);
+    if (!ok || bmp_probeMemory(header, (size_t)n, probe) != 0) return -1;
+    probe->fileSize = (long long)st.st_size;
+    return 0;
+}
@@ -0,0 +1,37 @@
+#ifndef PROBE_H
+#define PROBE_H
+
+#include <stddef.h>
+
+// Bytes of a BMP file that hold everything bmp_probe reports: file header plus info header
+#define PROBE_HEADER_SIZE 54
+
+// QOI files are probed as well, from their 14-byte header
+typedef enum {
+    IMAGE_FORMAT_BMP,
+    IMAGE_FORMAT_QOI
+} t_image_format;
+
+// What a BMP file holds, read from its headers without touching the pixels
+typedef struct {
+    int width;
+    int height;                 // Always positive
+    int topDown;                // The file stores a negative height: rows run top to bottom
+    int depth;                  // Bits per pixel
+    unsigned int compression;   // 0 for the uncompressed files the loaders accept
+    unsigned int dataOffset;    // Where the pixels start in the file
+    long long fileSize;         // From the file system, the header field is often wrong
+    t_image_format format;      // QOI files report the depth they load at, 24
+} t_bmp_probe;
+
+// Parses the first PROBE_HEADER_SIZE bytes of a file; fileSize is left at 0.
+// Returns 0 on success, -1 if they are not a BMP header.
+int bmp_probeHeader(const unsigned char *header, t_bmp_probe *probe);
+// Same for the first size bytes of a file held in memory, which may be fewer than
+// PROBE_HEADER_SIZE for a small QOI file
+int bmp_probeMemory(const void *data, size_t size, t_bmp_probe *probe);
+// Reads the headers of a file with a single read. Returns 0 on success, -1 if the file cannot
+// be read or is neither a BMP nor a QOI file. Prints nothing, so it can be used to sniff arbitrary files.
+int bmp_probe(const char *filename, t_bmp_probe *probe);
+
+#endif // PROBE_H
@@ -0,0 +1,230 @@
+#include "pyramid.h"
+#include "bmp24.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// One level of the pyramid. Only the current band of tile rows and one unpaired row are kept,
+// so memory stays around 2 * tileSize source rows whatever the image height.
+typedef struct {
+    int width;
+    int height;
+    uint8_t *band;      // tileSize rows, indexed by top-down row % tileSize
+    uint8_t *pending;   // odd row waiting for its partner before feeding the next level
+    int hasPending;
+} t_pyramid_level;
+
+typedef struct {
+    const char *prefix;
+    int tileSize;
+    int channels;
+    int levelCount;
+    t_pyramid_level *levels;
+    const unsigned char *palette;   // 1024 bytes for 8-bit tiles, NULL for 24-bit
+    int failed;
+} t_pyramid;
+
+static int write_tile(t_pyramid *pyr, int level, int tileRow, int tileCol, int tileW, int tileH) {
+    char filename[1024];
+    snprintf(filename, sizeof(filename), "%s_%d_%d_%d.bmp", pyr->prefix, level, tileRow, tileCol);
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot open tile %s for writing.\n", filename);
+        return -1;
+    }
+
+    int channels = pyr->channels;
+    uint32_t pitch = ((uint32_t)tileW * channels + 3u) & ~3u;
+    uint32_t paletteSize = pyr->palette ? 1024u : 0u;
+
+    t_bmp_header header;
+    t_bmp_info info;
+    memset(&header, 0, sizeof(header));
+    memset(&info, 0, sizeof(info));
+    header.type = BMP_TYPE;
+    header.offset = sizeof(t_bmp_header) + sizeof(t_bmp_info) + paletteSize;
+    header.size = header.offset + pitch * (uint32_t)tileH;
+    info.size = sizeof(t_bmp_info);
+    info.width = tileW;
+    info.height = tileH;
+    info.planes = 1;
+    info.bits = (uint16_t)(channels * 8);
+    info.imagesize = pitch * (uint32_t)tileH;
+    info.ncolors = pyr->palette ? 256 : 0;
+
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fwrite(&info, sizeof(info), 1, file) == 1 &&
+             (!pyr->palette || fwrite(pyr->palette, 1, 1024, file) == 1024);
+
+    const t_pyramid_level *lvl = &pyr->levels[level];
+    const uint8_t padding[3] = {0, 0, 0};
+    size_t levelRowLen = (size_t)lvl->width * channels;
+    size_t tileRowLen = (size_t)tileW * channels;
+    // BMP rows go bottom-up, the band is stored top-down
+    for (int y = tileH - 1; ok && y >= 0; y--) {
+        const uint8_t *row = lvl->band + (size_t)y * levelRowLen + (size_t)tileCol * pyr->tileSize * channels;
+        ok = fwrite(row, 1, tileRowLen, file) == tileRowLen &&
+             fwrite(padding, 1, pitch - tileRowLen, file) == pitch - tileRowLen;
+    }
+    if (!ok) fprintf(stderr, "Error: Failed to write tile %s.\n", filename);
+    fclose(file);
+    return ok ? 0 : -1;
+}
+
+static void push_row(t_pyramid *pyr, int level, const uint8_t *row, int topIndex);
+
+// Averages two rows 2x2 into one row of the next level; an odd last column or row averages with itself
+static void feed_next_level(t_pyramid *pyr, int level, const uint8_t *upper, const uint8_t *lower, int topIndex) {
+    const t_pyramid_level *lvl = &pyr->levels[level];
+    t_pyramid_level *next = &pyr->levels[level + 1];
+    int channels = pyr->channels;
+    uint8_t *out = next->pending + (size_t)next->width * channels;   // scratch row after pending
+
+    for (int x = 0; x < next->width; x++) {
+        int x0 = 2 * x;
+        int x1 = (x0 + 1 < lvl->width) ? x0 + 1 : x0;
+        for (int c = 0; c < channels; c++) {
+            int sum = upper[x0 * channels + c] + upper[x1 * channels + c] +
+                      lower[x0 * channels + c] + lower[x1 * channels + c];
+            out[x * channels + c] = (uint8_t)((sum + 2) >> 2);
+        }
+    }
+    push_row(pyr, level + 1, out, topIndex / 2);
+}
+
+// Receives the row at top-down index topIndex; rows always arrive bottom-up
+static void push_row(t_pyramid *pyr, int level, const uint8_t *row, int topIndex) {
+    if (pyr->failed) return;
+    t_pyramid_level *lvl = &pyr->levels[level];
+    int channels = pyr->channels;
+    size_t rowLen = (size_t)lvl->width * channels;
+    int tileSize = pyr->tileSize;
+
+    memcpy(lvl->band + (size_t)(topIndex % tileSize) * rowLen, row, rowLen);
+
+    if (level + 1 < pyr->levelCount) {
+        if (topIndex % 2 == 1) {
+            memcpy(lvl->pending, row, rowLen);
+            lvl->hasPending = 1;
+        } else {
+            feed_next_level(pyr, level, row, lvl->hasPending ? lvl->pending : row, topIndex);
+            lvl->hasPending = 0;
+        }
+    }
+
+    // The top row of a tile row arrives last, so the band is complete
+    if (topIndex % tileSize == 0) {
+        int tileRow = topIndex / tileSize;
+        int tileH = lvl->height - topIndex;
+        if (tileH > tileSize) tileH = tileSize;
+        for (int tileCol = 0; tileCol * tileSize < lvl->width; tileCol++) {
+            int tileW = lvl->width - tileCol * tileSize;
+            if (tileW > tileSize) tileW = tileSize;
+            if (write_tile(pyr, level, tileRow, tileCol, tileW, tileH) != 0) {
+                pyr->failed = 1;
+                return;
+            }
+        }
+    }
+}
+
+static int build_pyramid(const char *filename, const char *outputPrefix, int tileSize, int bits) {
+    if (!filename || !outputPrefix || tileSize <= 0) {
+        fprintf(stderr, "Error: Invalid parameters for pyramid generation.\n");
+        return -1;
+    }
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        printf("Error: Cannot open file for reading");
+        return -1;
+    }
+
+    t_bmp_header header;
+    t_bmp_info info;
+    if (fread(&header, sizeof(header), 1, file) != 1 || fread(&info, sizeof(info), 1, file) != 1) {
+        fprintf(stderr, "Error reading BMP headers.\n");
+        fclose(file);
+        return -1;
+    }
+    if (header.type != BMP_TYPE || info.bits != bits || info.compression != 0 ||
+        info.width <= 0 || info.height <= 0) {
+        fprintf(stderr, "Error: Pyramid input must be an uncompressed bottom-up %d-bit BMP.\n", bits);
+        fclose(file);
+        return -1;
+    }
+
+    unsigned char palette[1024];
+    if (bits == 8) {
+        memset(palette, 0, sizeof(palette));
+        if (fseek(file, HEADER_SIZE + info.size, SEEK_SET) != 0 ||
+            fread(palette, 1, sizeof(palette), file) != sizeof(palette)) {
+            fprintf(stderr, "Error: Failed to read color table.\n");
+            fclose(file);
+            return -1;
+        }
+    }
+
+    t_pyramid pyr;
+    pyr.prefix = outputPrefix;
+    pyr.tileSize = tileSize;
+    pyr.channels = bits / 8;
+    pyr.palette = (bits == 8) ? palette : NULL;
+    pyr.failed = 0;
+
+    pyr.levelCount = 1;
+    for (int w = info.width, h = info.height; w > tileSize || h > tileSize; w = (w + 1) / 2, h = (h + 1) / 2) {
+        pyr.levelCount++;
+    }
+    pyr.levels = (t_pyramid_level *)calloc(pyr.levelCount, sizeof(t_pyramid_level));
+    if (!pyr.levels) {
+        fprintf(stderr, "Error: Failed to allocate pyramid levels.\n");
+        fclose(file);
+        return -1;
+    }
+    for (int l = 0; l < pyr.levelCount; l++) {
+        t_pyramid_level *lvl = &pyr.levels[l];
+        lvl->width = (l == 0) ? info.width : (pyr.levels[l - 1].width + 1) / 2;
+        lvl->height = (l == 0) ? info.height : (pyr.levels[l - 1].height + 1) / 2;
+        size_t rowLen = (size_t)lvl->width * pyr.channels;
+        lvl->band = (uint8_t *)malloc(rowLen * tileSize);
+        // Pending row plus a scratch row used to build the next level
+        lvl->pending = (uint8_t *)malloc(rowLen * 2);
+        if (!lvl->band || !lvl->pending) {
+            fprintf(stderr, "Error: Failed to allocate pyramid level %d.\n", l);
+            pyr.failed = 1;
+        }
+    }
+
+    uint32_t pitch = ((uint32_t)info.width * pyr.channels + 3u) & ~3u;
+    uint8_t *row = (uint8_t *)malloc(pitch);
+    if (!row || fseek(file, header.offset, SEEK_SET) != 0) {
+        fprintf(stderr, "Error: Failed to prepare pixel data reading.\n");
+        pyr.failed = 1;
+    }
+
+    for (int y = info.height - 1; !pyr.failed && y >= 0; y--) {
+        if (fread(row, 1, pitch, file) != pitch) {
+            fprintf(stderr, "Error: Failed to read pixel row %d.\n", y);
+            pyr.failed = 1;
+            break;
+        }
+        push_row(&pyr, 0, row, y);
+    }
+
+    free(row);
+    for (int l = 0; l < pyr.levelCount; l++) {
+        free(pyr.levels[l].band);
+        free(pyr.levels[l].pending);
+    }
+    free(pyr.levels);
+    fclose(file);
+    return pyr.failed ? -1 : pyr.levelCount;
+}
+
+int bmp8_buildPyramid(const char *filename, const char *outputPrefix, int tileSize) {
+    return build_pyramid(filename, outputPrefix, tileSize, 8);
+}
+
+int bmp24_buildPyramid(const char *filename, const char *outputPrefix, int tileSize) {
+    return build_pyramid(filename, outputPrefix, tileSize, 24);
+}
@@ -0,0 +1,13 @@
+#ifndef PYRAMID_H
+#define PYRAMID_H
+
+#define PYRAMID_DEFAULT_TILE_SIZE 256
+
+// Streams a BMP once, bottom row first, and writes every level of its 2x2 mip pyramid as
+// tileSize x tileSize BMP tiles named <prefix>_<level>_<row>_<col>.bmp. Level 0 is full
+// resolution, rows and columns count from the top-left tile. The last level fits in one tile.
+// Returns the number of levels written, or -1 on error.
+int bmp8_buildPyramid(const char *filename, const char *outputPrefix, int tileSize);
+int bmp24_buildPyramid(const char *filename, const char *outputPrefix, int tileSize);
+
+#endif // PYRAMID_H
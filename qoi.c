@@ -0,0 +1,356 @@
+#include "qoi.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define QOI_OP_INDEX 0x00   // 00iiiiii: colour from the index
+#define QOI_OP_DIFF  0x40   // 01rrggbb: small change from the previous pixel, each biased by 2
+#define QOI_OP_LUMA  0x80   // 10gggggg then rrrrbbbb: green change biased by 32, red and blue relative to it
+#define QOI_OP_RUN   0xc0   // 11nnnnnn: previous pixel repeated n + 1 times
+#define QOI_OP_RGB   0xfe
+#define QOI_OP_RGBA  0xff
+#define QOI_MASK     0xc0
+#define QOI_RUN_MAX  62     // Longer runs would collide with the RGB and RGBA tags
+
+static const uint8_t end_marker[QOI_END_SIZE] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+static uint32_t pack(int r, int g, int b, int a) {
+    return (uint32_t)r | ((uint32_t)g << 8) | ((uint32_t)b << 16) | ((uint32_t)a << 24);
+}
+
+static int hash(int r, int g, int b, int a) {
+    return (r * 3 + g * 5 + b * 7 + a * 11) & 63;
+}
+
+static uint32_t read_be32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void write_be32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+void qoi_initState(t_qoi_state *state) {
+    memset(state->index, 0, sizeof(state->index));
+    state->prev = pack(0, 0, 0, 255);
+    state->run = 0;
+}
+
+void qoi_writeHeader(uint8_t *out, int width, int height) {
+    memcpy(out, "qoif", 4);
+    write_be32(out + 4, (uint32_t)width);
+    write_be32(out + 8, (uint32_t)height);
+    out[12] = 3;    // Channels
+    out[13] = 0;    // sRGB
+}
+
+int qoi_readHeader(const uint8_t *data, size_t size, int *width, int *height) {
+    if (size < QOI_HEADER_SIZE || memcmp(data, "qoif", 4) != 0) return -1;
+    uint32_t w = read_be32(data + 4), h = read_be32(data + 8);
+    if (w == 0 || h == 0 || h >= QOI_PIXELS_MAX / w || (data[12] != 3 && data[12] != 4)) return -1;
+    *width = (int)w;
+    *height = (int)h;
+    return 0;
+}
+
+int qoi_isFilename(const char *filename) {
+    size_t n = strlen(filename);
+    return n > 4 && strcasecmp(filename + n - 4, ".qoi") == 0;
+}
+
+size_t qoi_encodeRow(t_qoi_state *state, const t_pixel *row, int width, uint8_t *out) {
+    uint8_t *p = out;
+    uint32_t prev = state->prev;
+    int run = state->run;
+    for (int x = 0; x < width; x++) {
+        int r = row[x].red, g = row[x].green, b = row[x].blue;
+        uint32_t px = pack(r, g, b, 255);
+        if (px == prev) {
+            if (++run == QOI_RUN_MAX) {
+                *p++ = (uint8_t)(QOI_OP_RUN | (run - 1));
+                run = 0;
+            }
+            continue;
+        }
+        if (run) {
+            *p++ = (uint8_t)(QOI_OP_RUN | (run - 1));
+            run = 0;
+        }
+        int h = hash(r, g, b, 255);
+        if (state->index[h] == px) {
+            *p++ = (uint8_t)(QOI_OP_INDEX | h);
+        } else {
+            state->index[h] = px;
+            // The encoder only writes opaque pixels, so alpha never changes
+            int vr = (int8_t)(r - (int)(prev & 0xff));
+            int vg = (int8_t)(g - (int)((prev >> 8) & 0xff));
+            int vb = (int8_t)(b - (int)((prev >> 16) & 0xff));
+            int vg_r = vr - vg, vg_b = vb - vg;
+            if (vr >= -2 && vr <= 1 && vg >= -2 && vg <= 1 && vb >= -2 && vb <= 1) {
+                *p++ = (uint8_t)(QOI_OP_DIFF | ((vr + 2) << 4) | ((vg + 2) << 2) | (vb + 2));
+            } else if (vg >= -32 && vg <= 31 && vg_r >= -8 && vg_r <= 7 && vg_b >= -8 && vg_b <= 7) {
+                *p++ = (uint8_t)(QOI_OP_LUMA | (vg + 32));
+                *p++ = (uint8_t)(((vg_r + 8) << 4) | (vg_b + 8));
+            } else {
+                p[0] = QOI_OP_RGB;
+                p[1] = (uint8_t)r;
+                p[2] = (uint8_t)g;
+                p[3] = (uint8_t)b;
+                p += 4;
+            }
+        }
+        prev = px;
+    }
+    state->prev = prev;
+    state->run = run;
+    return (size_t)(p - out);
+}
+
+size_t qoi_encodeEnd(t_qoi_state *state, uint8_t *out) {
+    size_t n = 0;
+    if (state->run) out[n++] = (uint8_t)(QOI_OP_RUN | (state->run - 1));
+    state->run = 0;
+    memcpy(out + n, end_marker, QOI_END_SIZE);
+    return n + QOI_END_SIZE;
+}
+
+long qoi_decodeRow(t_qoi_state *state, const uint8_t *in, size_t size, t_pixel *row, int width) {
+    const uint8_t *p = in, *end = in + size;
+    uint32_t prev = state->prev;
+    int r = prev & 0xff, g = (prev >> 8) & 0xff, b = (prev >> 16) & 0xff, a = prev >> 24;
+    int run = state->run;
+    for (int x = 0; x < width; x++) {
+        if (run > 0) {
+            run--;
+        } else {
+            if (p >= end) return -1;
+            int op = *p++;
+            if (op == QOI_OP_RGB) {
+                if (end - p < 3) return -1;
+                r = p[0];
+                g = p[1];
+                b = p[2];
+                p += 3;
+            } else if (op == QOI_OP_RGBA) {
+                if (end - p < 4) return -1;
+                r = p[0];
+                g = p[1];
+                b = p[2];
+                a = p[3];
+                p += 4;
+            } else if ((op & QOI_MASK) == QOI_OP_INDEX) {
+                uint32_t px = state->index[op];
+                r = px & 0xff;
+                g = (px >> 8) & 0xff;
+                b = (px >> 16) & 0xff;
+                a = px >> 24;
+            } else if ((op & QOI_MASK) == QOI_OP_DIFF) {
+                r = (r + ((op >> 4) & 3) - 2) & 0xff;
+                g = (g + ((op >> 2) & 3) - 2) & 0xff;
+                b = (b + (op & 3) - 2) & 0xff;
+            } else if ((op & QOI_MASK) == QOI_OP_LUMA) {
+                if (p >= end) return -1;
+                int vg = (op & 0x3f) - 32, next = *p++;
+                r = (r + vg - 8 + (next >> 4)) & 0xff;
+                g = (g + vg) & 0xff;
+                b = (b + vg - 8 + (next & 0x0f)) & 0xff;
+            } else {
+                run = op & 0x3f;
+            }
+            state->index[hash(r, g, b, a)] = pack(r, g, b, a);
+        }
+        row[x].red = (uint8_t)r;
+        row[x].green = (uint8_t)g;
+        row[x].blue = (uint8_t)b;
+    }
+    state->prev = pack(r, g, b, a);
+    state->run = run;
+    return (long)(p - in);
+}
+
+t_bmp24 *qoi_loadImage(const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot open %s for reading.\n", filename);
+        return NULL;
+    }
+    uint8_t header[QOI_HEADER_SIZE];
+    int width, height;
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) ||
+        qoi_readHeader(header, sizeof(header), &width, &height) != 0) {
+        fprintf(stderr, "Error: %s is not a QOI file.\n", filename);
+        fclose(file);
+        return NULL;
+    }
+    size_t row_bytes = QOI_MAX_ROW_BYTES(width);
+    size_t capacity = row_bytes > QOI_STREAM_CHUNK ? row_bytes : QOI_STREAM_CHUNK;
+    uint8_t *chunk = (uint8_t *)malloc(capacity);
+    t_bmp24 *img = chunk ? bmp24_allocate(width, height, 24) : NULL;
+    if (!img) {
+        fprintf(stderr, "Error: Failed to allocate memory for a %dx%d QOI image.\n", width, height);
+        free(chunk);
+        fclose(file);
+        return NULL;
+    }
+
+    // The chunk is topped up whenever less than a worst-case row is left in it
+    t_qoi_state state;
+    qoi_initState(&state);
+    size_t start = 0, filled = 0;
+    int eof = 0, failed = 0;
+    for (int y = 0; y < height && !failed; y++) {
+        if (!eof && filled - start < row_bytes) {
+            memmove(chunk, chunk + start, filled - start);
+            filled -= start;
+            start = 0;
+            size_t want = capacity - filled;
+            size_t n = fread(chunk + filled, 1, want, file);
+            filled += n;
+            eof = n < want;
+        }
+        long used = qoi_decodeRow(&state, chunk + start, filled - start, img->data[y], width);
+        if (used < 0) failed = 1;
+        else start += (size_t)used;
+    }
+    free(chunk);
+    fclose(file);
+    if (failed) {
+        fprintf(stderr, "Error: Truncated QOI data in %s.\n", filename);
+        bmp24_free(img);
+        return NULL;
+    }
+    return img;
+}
+
+// One row of an image to encode; scratch holds width pixels for sources that convert
+typedef const t_pixel *(*t_row_source)(const void *img, int y, t_pixel *scratch);
+
+static const t_pixel *bmp24_row(const void *img, int y, t_pixel *scratch) {
+    (void)scratch;
+    return ((const t_bmp24 *)img)->data[y];
+}
+
+static const t_pixel *bmp8_row(const void *img, int y, t_pixel *scratch) {
+    const t_bmp8 *gray = (const t_bmp8 *)img;
+    const uint8_t *src = gray->data + (size_t)(gray->height - 1 - y) * gray->width;
+    for (unsigned int x = 0; x < gray->width; x++) {
+        const unsigned char *entry = &gray->colorTable[src[x] * 4];
+        scratch[x].blue = entry[0];
+        scratch[x].green = entry[1];
+        scratch[x].red = entry[2];
+    }
+    return scratch;
+}
+
+static int save_rows(const char *filename, const void *img, int width, int height, t_row_source source) {
+    size_t row_bytes = QOI_MAX_ROW_BYTES(width);
+    size_t capacity = QOI_HEADER_SIZE + row_bytes + 1 + QOI_END_SIZE;
+    if (capacity < QOI_STREAM_CHUNK) capacity = QOI_STREAM_CHUNK;
+    uint8_t *chunk = (uint8_t *)malloc(capacity);
+    t_pixel *scratch = (t_pixel *)malloc((size_t)width * sizeof(t_pixel));
+    FILE *file = (chunk && scratch) ? fopen(filename, "wb") : NULL;
+    if (!file) {
+        fprintf(stderr, "Error: Cannot open %s for writing.\n", filename);
+        free(chunk);
+        free(scratch);
+        return -1;
+    }
+
+    t_qoi_state state;
+    qoi_initState(&state);
+    qoi_writeHeader(chunk, width, height);
+    size_t used = QOI_HEADER_SIZE;
+    int failed = 0;
+    for (int y = 0; y < height && !failed; y++) {
+        if (capacity - used < row_bytes) {
+            failed = fwrite(chunk, 1, used, file) != used;
+            used = 0;
+        }
+        used += qoi_encodeRow(&state, source(img, y, scratch), width, chunk + used);
+    }
+    if (!failed && capacity - used < 1 + QOI_END_SIZE) {
+        failed = fwrite(chunk, 1, used, file) != used;
+        used = 0;
+    }
+    used += qoi_encodeEnd(&state, chunk + used);
+    if (!failed) failed = fwrite(chunk, 1, used, file) != used;
+    if (fclose(file) != 0) failed = 1;
+    free(chunk);
+    free(scratch);
+    if (failed) {
+        fprintf(stderr, "Error: Failed to write %s.\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+int qoi_saveImage(const t_bmp24 *img, const char *filename) {
+    if (!img || !img->data) {
+        fprintf(stderr, "Error: Cannot save NULL image.\n");
+        return -1;
+    }
+    return save_rows(filename, img, img->width, img->height, bmp24_row);
+}
+
+int qoi_saveBmp8(const t_bmp8 *img, const char *filename) {
+    if (!img || !img->data) {
+        fprintf(stderr, "Error: Cannot save NULL image.\n");
+        return -1;
+    }
+    return save_rows(filename, img, (int)img->width, (int)img->height, bmp8_row);
+}
+
+t_bmp24 *qoi_decodeMemory(const void *data, size_t size) {
+    int width, height;
+    if (!data || qoi_readHeader((const uint8_t *)data, size, &width, &height) != 0) {
+        fprintf(stderr, "Error: Not a QOI file.\n");
+        return NULL;
+    }
+    t_bmp24 *img = bmp24_allocate(width, height, 24);
+    if (!img) return NULL;
+    t_qoi_state state;
+    qoi_initState(&state);
+    const uint8_t *p = (const uint8_t *)data + QOI_HEADER_SIZE;
+    size_t left = size - QOI_HEADER_SIZE;
+    for (int y = 0; y < height; y++) {
+        long used = qoi_decodeRow(&state, p, left, img->data[y], width);
+        if (used < 0) {
+            fprintf(stderr, "Error: Truncated QOI data.\n");
+            bmp24_free(img);
+            return NULL;
+        }
+        p += used;
+        left -= (size_t)used;
+    }
+    return img;
+}
+
+int qoi_encodeMemory(const t_bmp24 *img, t_byte_buffer *out) {
+    if (!img || !img->data || !out) {
+        fprintf(stderr, "Error: Cannot encode NULL image.\n");
+        return -1;
+    }
+    // Each row reserves its worst case and gives back what it did not use
+    size_t row_bytes = QOI_MAX_ROW_BYTES(img->width);
+    size_t start = out->size;
+    uint8_t *dst = buffer_append(out, QOI_HEADER_SIZE);
+    t_qoi_state state;
+    qoi_initState(&state);
+    if (dst) qoi_writeHeader(dst, img->width, img->height);
+    for (int y = 0; y < img->height && dst; y++) {
+        dst = buffer_append(out, row_bytes);
+        if (dst) out->size -= row_bytes - qoi_encodeRow(&state, img->data[y], img->width, dst);
+    }
+    if (dst) dst = buffer_append(out, 1 + QOI_END_SIZE);
+    if (!dst) {
+        fprintf(stderr, "Error: Output buffer too small for a %dx%d image.\n", img->width, img->height);
+        out->size = start;
+        return -1;
+    }
+    out->size -= 1 + QOI_END_SIZE - qoi_encodeEnd(&state, dst);
+    return 0;
+}
@@ -0,0 +1,56 @@
+#ifndef QOI_H
+#define QOI_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "bmp8.h"
+#include "bmp24.h"
+#include "buffer.h"
+
+// QOI ("Quite OK Image") files: a 14-byte header, one op per pixel or run of pixels, then an
+// 8-byte end marker. Lossless, and usually well under half the size of a 24-bit BMP.
+#define QOI_HEADER_SIZE 14
+#define QOI_END_SIZE 8
+// Largest size of the ops for width pixels, each at most a 5-byte RGBA op
+#define QOI_MAX_ROW_BYTES(width) ((size_t)(width) * 5)
+// Largest image the format allows
+#define QOI_PIXELS_MAX 400000000u
+// Bytes read or written per file call while streaming
+#define QOI_STREAM_CHUNK (256 * 1024)
+
+// Coder state carried from one row to the next: the previous pixel, the table of recently seen
+// colours and the pixels left in the current run. Colours are packed as r | g << 8 | b << 16 | a << 24.
+typedef struct {
+    uint32_t index[64];
+    uint32_t prev;
+    int run;
+} t_qoi_state;
+
+void qoi_initState(t_qoi_state *state);
+// Header of a width x height RGB file, QOI_HEADER_SIZE bytes
+void qoi_writeHeader(uint8_t *out, int width, int height);
+// Returns 0 and the size of the image if data starts with a QOI header, -1 otherwise
+int qoi_readHeader(const uint8_t *data, size_t size, int *width, int *height);
+// True when the file name ends in .qoi, which makes the save functions write QOI
+int qoi_isFilename(const char *filename);
+
+// Appends the ops for one row to out, which must hold QOI_MAX_ROW_BYTES(width) bytes, and
+// returns their size. A run of equal pixels can carry on into the next row.
+size_t qoi_encodeRow(t_qoi_state *state, const t_pixel *row, int width, uint8_t *out);
+// Ends the image: the pending run and the end marker, at most 1 + QOI_END_SIZE bytes
+size_t qoi_encodeEnd(t_qoi_state *state, uint8_t *out);
+// Decodes one row from the size bytes at in; alpha, if the file has any, is dropped. Returns
+// the bytes consumed, or -1 if they run out first.
+long qoi_decodeRow(t_qoi_state *state, const uint8_t *in, size_t size, t_pixel *row, int width);
+
+// Files, one row at a time through a QOI_STREAM_CHUNK buffer. Return NULL or -1 on error.
+t_bmp24 *qoi_loadImage(const char *filename);
+int qoi_saveImage(const t_bmp24 *img, const char *filename);
+// 8-bit images are saved as the RGB colours of their colour table
+int qoi_saveBmp8(const t_bmp8 *img, const char *filename);
+
+// In-memory files, like bmp24_decodeMemory and bmp24_encodeMemory
+t_bmp24 *qoi_decodeMemory(const void *data, size_t size);
+int qoi_encodeMemory(const t_bmp24 *img, t_byte_buffer *out);
+
+#endif // QOI_H
@@ -0,0 +1,468 @@
+#include "quantize.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Pixel count and channel sums of every cell of the colour cube, so palette entries can be
+// exact means of the pixels they replace while the searches only visit QUANTIZE_CELLS cells
+typedef struct {
+    uint32_t *count;
+    uint64_t *sum;      // Blue, green and red per cell
+} t_color_histogram;
+
+#define CUBE_SIDE (1 << QUANTIZE_BITS)
+
+static void cell_coords(int cell, int coords[3]) {
+    coords[0] = cell >> (2 * QUANTIZE_BITS);                // Red
+    coords[1] = (cell >> QUANTIZE_BITS) & (CUBE_SIDE - 1);  // Green
+    coords[2] = cell & (CUBE_SIDE - 1);                     // Blue
+}
+
+static void free_histogram(t_color_histogram *hist) {
+    free(hist->count);
+    free(hist->sum);
+}
+
+// Rows are counted in parallel into per-thread histograms, merged at the end
+static int build_histogram(const t_bmp24 *img, t_color_histogram *hist) {
+    hist->count = (uint32_t *)calloc(QUANTIZE_CELLS, sizeof(uint32_t));
+    hist->sum = (uint64_t *)calloc((size_t)QUANTIZE_CELLS * 3, sizeof(uint64_t));
+    if (!hist->count || !hist->sum) {
+        fprintf(stderr, "Error: Failed to allocate memory for the colour histogram.\n");
+        free_histogram(hist);
+        return -1;
+    }
+    int failed = 0;
+    #pragma omp parallel
+    {
+        uint32_t *count = (uint32_t *)calloc(QUANTIZE_CELLS, sizeof(uint32_t));
+        uint64_t *sum = (uint64_t *)calloc((size_t)QUANTIZE_CELLS * 3, sizeof(uint64_t));
+        if (!count || !sum) {
+            #pragma omp atomic write
+            failed = 1;
+        }
+        #pragma omp for schedule(static)
+        for (int y = 0; y < img->height; y++) {
+            if (!count || !sum) continue;
+            const t_pixel *row = img->data[y];
+            for (int x = 0; x < img->width; x++) {
+                int cell = quantize_cell(row[x].red, row[x].green, row[x].blue);
+                count[cell]++;
+                sum[cell * 3] += row[x].blue;
+                sum[cell * 3 + 1] += row[x].green;
+                sum[cell * 3 + 2] += row[x].red;
+            }
+        }
+        if (count && sum) {
+            #pragma omp critical
+            {
+                for (int i = 0; i < QUANTIZE_CELLS; i++) hist->count[i] += count[i];
+                for (int i = 0; i < QUANTIZE_CELLS * 3; i++) hist->sum[i] += sum[i];
+            }
+        }
+        free(count);
+        free(sum);
+    }
+    if (failed) {
+        fprintf(stderr, "Error: Failed to allocate memory for the colour histogram.\n");
+        free_histogram(hist);
+        return -1;
+    }
+    return 0;
+}
+
+static t_pixel mean_color(uint64_t count, const uint64_t sum[3]) {
+    t_pixel p = {0, 0, 0};
+    if (count == 0) return p;
+    p.blue = (uint8_t)((sum[0] + count / 2) / count);
+    p.green = (uint8_t)((sum[1] + count / 2) / count);
+    p.red = (uint8_t)((sum[2] + count / 2) / count);
+    return p;
+}
+
+// Median cut
+
+// Inclusive cell ranges along red, green and blue
+typedef struct {
+    int lo[3];
+    int hi[3];
+    uint64_t count;
+} t_box;
+
+// Shrinks the box to the occupied cells and recounts it. Returns the pixel sums through sum.
+static void shrink_box(const t_color_histogram *hist, t_box *box, uint64_t sum[3]) {
+    int lo[3] = {CUBE_SIDE, CUBE_SIDE, CUBE_SIDE}, hi[3] = {-1, -1, -1};
+    uint64_t count = 0;
+    sum[0] = sum[1] = sum[2] = 0;
+    for (int r = box->lo[0]; r <= box->hi[0]; r++) {
+        for (int g = box->lo[1]; g <= box->hi[1]; g++) {
+            int base = (r << (2 * QUANTIZE_BITS)) | (g << QUANTIZE_BITS);
+            for (int b = box->lo[2]; b <= box->hi[2]; b++) {
+                uint32_t n = hist->count[base | b];
+                if (n == 0) continue;
+                int c[3] = {r, g, b};
+                for (int k = 0; k < 3; k++) {
+                    if (c[k] < lo[k]) lo[k] = c[k];
+                    if (c[k] > hi[k]) hi[k] = c[k];
+                    sum[k] += hist->sum[(size_t)(base | b) * 3 + k];
+                }
+                count += n;
+            }
+        }
+    }
+    if (count) {
+        memcpy(box->lo, lo, sizeof(lo));
+        memcpy(box->hi, hi, sizeof(hi));
+    }
+    box->count = count;
+}
+
+static int longest_axis(const t_box *box) {
+    int axis = 0;
+    for (int k = 1; k < 3; k++) {
+        if (box->hi[k] - box->lo[k] > box->hi[axis] - box->lo[axis]) axis = k;
+    }
+    return axis;
+}
+
+// Splits box along its longest side where half of its pixels lie on either side
+static void split_box(const t_color_histogram *hist, t_box *box, t_box *upper) {
+    int axis = longest_axis(box);
+    uint64_t slice[CUBE_SIDE] = {0};
+    for (int r = box->lo[0]; r <= box->hi[0]; r++) {
+        for (int g = box->lo[1]; g <= box->hi[1]; g++) {
+            int base = (r << (2 * QUANTIZE_BITS)) | (g << QUANTIZE_BITS);
+            for (int b = box->lo[2]; b <= box->hi[2]; b++) {
+                int c[3] = {r, g, b};
+                slice[c[axis]] += hist->count[base | b];
+            }
+        }
+    }
+    int cut = box->lo[axis];
+    uint64_t below = slice[cut];
+    while (cut + 1 < box->hi[axis] && below * 2 < box->count) below += slice[++cut];
+    *upper = *box;
+    box->hi[axis] = cut;
+    upper->lo[axis] = cut + 1;
+}
+
+static int median_cut(const t_color_histogram *hist, int colors, t_palette *palette) {
+    t_box boxes[256];
+    uint64_t sums[256][3];
+    int count = 1;
+    boxes[0] = (t_box){{0, 0, 0}, {CUBE_SIDE - 1, CUBE_SIDE - 1, CUBE_SIDE - 1}, 0};
+    shrink_box(hist, &boxes[0], sums[0]);
+    while (count < colors) {
+        // Most pixels times the longest side, so large sparse boxes are split as well
+        int best = -1;
+        uint64_t best_score = 0;
+        for (int i = 0; i < count; i++) {
+            int axis = longest_axis(&boxes[i]);
+            uint64_t score = boxes[i].count * (uint64_t)(boxes[i].hi[axis] - boxes[i].lo[axis]);
+            if (score > best_score) {
+                best_score = score;
+                best = i;
+            }
+        }
+        if (best < 0) break;    // Every box is a single cell
+        split_box(hist, &boxes[best], &boxes[count]);
+        shrink_box(hist, &boxes[best], sums[best]);
+        shrink_box(hist, &boxes[count], sums[count]);
+        count++;
+    }
+    palette->count = 0;
+    for (int i = 0; i < count; i++) {
+        if (boxes[i].count) palette->colors[palette->count++] = mean_color(boxes[i].count, sums[i]);
+    }
+    return 0;
+}
+
+// Octree
+
+typedef struct {
+    int children[8];    // Node indices, 0 for none
+    int level;
+    int leaf;
+    uint64_t count;
+    uint64_t sum[3];
+} t_octree_node;
+
+// Reduction order: node populations are copied next to their indices so qsort needs no context
+typedef struct {
+    uint64_t count;
+    int index;
+} t_node_order;
+
+static int compare_nodes(const void *a, const void *b) {
+    uint64_t ca = ((const t_node_order *)a)->count, cb = ((const t_node_order *)b)->count;
+    return (ca > cb) - (ca < cb);
+}
+
+static void collect_leaves(const t_octree_node *nodes, int index, t_palette *palette) {
+    const t_octree_node *node = &nodes[index];
+    if (node->leaf) {
+        palette->colors[palette->count++] = mean_color(node->count, node->sum);
+        return;
+    }
+    for (int i = 0; i < 8; i++) {
+        if (node->children[i]) collect_leaves(nodes, node->children[i], palette);
+    }
+}
+
+// The occupied cells are the leaves at depth QUANTIZE_BITS. Whole levels are then reduced from
+// the bottom up, least populated nodes first, each merge turning a node into one leaf.
+static int octree(const t_color_histogram *hist, int colors, t_palette *palette) {
+    int capacity = 0;
+    for (int level = 0, n = 1; level <= QUANTIZE_BITS; level++, n *= 8) capacity += n;
+    t_octree_node *nodes = (t_octree_node *)calloc((size_t)capacity, sizeof(t_octree_node));
+    t_node_order *order = (t_node_order *)malloc((size_t)capacity * sizeof(t_node_order));
+    if (!nodes || !order) {
+        fprintf(stderr, "Error: Failed to allocate memory for the octree.\n");
+        free(nodes);
+        free(order);
+        return -1;
+    }
+    int used = 1, leaves = 0;
+    for (int cell = 0; cell < QUANTIZE_CELLS; cell++) {
+        if (hist->count[cell] == 0) continue;
+        int c[3];
+        cell_coords(cell, c);
+        int index = 0;
+        for (int level = 0;; level++) {
+            t_octree_node *node = &nodes[index];
+            node->level = level;
+            node->count += hist->count[cell];
+            for (int k = 0; k < 3; k++) node->sum[k] += hist->sum[(size_t)cell * 3 + k];
+            if (level == QUANTIZE_BITS) {
+                node->leaf = 1;
+                leaves++;
+                break;
+            }
+            int shift = QUANTIZE_BITS - 1 - level;
+            int child = (((c[0] >> shift) & 1) << 2) | (((c[1] >> shift) & 1) << 1) | ((c[2] >> shift) & 1);
+            if (!node->children[child]) node->children[child] = used++;
+            index = node->children[child];
+        }
+    }
+
+    for (int level = QUANTIZE_BITS - 1; level >= 0 && leaves > colors; level--) {
+        int n = 0;
+        for (int i = 0; i < used; i++) {
+            if (nodes[i].level == level && !nodes[i].leaf) order[n++] = (t_node_order){nodes[i].count, i};
+        }
+        qsort(order, (size_t)n, sizeof(t_node_order), compare_nodes);
+        for (int i = 0; i < n && leaves > colors; i++) {
+            t_octree_node *node = &nodes[order[i].index];
+            int children = 0;
+            for (int k = 0; k < 8; k++) children += node->children[k] != 0;
+            node->leaf = 1;
+            leaves -= children - 1;
+        }
+    }
+
+    palette->count = 0;
+    if (used > 1 || nodes[0].leaf) collect_leaves(nodes, 0, palette);
+    free(nodes);
+    free(order);
+    return 0;
+}
+
+int quantize_buildPalette(const t_bmp24 *img, int colors, t_quantize_method method, t_palette *palette) {
+    if (!img || !img->data || !palette) return -1;
+    if (colors < 2 || colors > 256) {
+        fprintf(stderr, "Error: A palette needs between 2 and 256 colours.\n");
+        return -1;
+    }
+    t_color_histogram hist;
+    if (build_histogram(img, &hist) != 0) return -1;
+    int status = (method == QUANTIZE_OCTREE) ? octree(&hist, colors, palette) : median_cut(&hist, colors, palette);
+    free_histogram(&hist);
+    return status;
+}
+
+// Side of the blocks of cells that share one candidate list in the inverse table search
+#define INVERSE_BLOCK_CELLS 4
+
+static int squared_gap(int v, int lo, int hi) {
+    int d = v < lo ? lo - v : v > hi ? v - hi : 0;
+    return d * d;
+}
+
+static int squared_far(int v, int lo, int hi) {
+    int d = v - lo > hi - v ? v - lo : hi - v;
+    return d * d;
+}
+
+uint8_t *quantize_inverseTable(const t_palette *palette) {
+    if (!palette || palette->count < 1) return NULL;
+    uint8_t *table = (uint8_t *)malloc(QUANTIZE_CELLS);
+    if (!table) {
+        fprintf(stderr, "Error: Failed to allocate memory for the inverse colour table.\n");
+        return NULL;
+    }
+    const int n = palette->count;
+    const int step = 1 << (8 - QUANTIZE_BITS), half = step / 2;
+    const int blocks = CUBE_SIDE / INVERSE_BLOCK_CELLS, span = INVERSE_BLOCK_CELLS * step;
+    // Each block of cells first keeps the entries that can be nearest anywhere inside it: those
+    // no further away than the smallest worst-case distance. Its cells then only search those,
+    // which gives the same answer as a search of the whole palette, ties going to the lower index.
+    #pragma omp parallel for schedule(dynamic)
+    for (int block = 0; block < blocks * blocks * blocks; block++) {
+        int lo[3] = {(block / (blocks * blocks)) * span, (block / blocks % blocks) * span, (block % blocks) * span};
+        int hi[3] = {lo[0] + span - 1, lo[1] + span - 1, lo[2] + span - 1};
+        int limit = INT32_MAX;
+        for (int i = 0; i < n; i++) {
+            const t_pixel *p = &palette->colors[i];
+            int far = squared_far(p->red, lo[0], hi[0]) + squared_far(p->green, lo[1], hi[1]) +
+                      squared_far(p->blue, lo[2], hi[2]);
+            if (far < limit) limit = far;
+        }
+        int red[256], green[256], blue[256], index[256], candidates = 0;
+        for (int i = 0; i < n; i++) {
+            const t_pixel *p = &palette->colors[i];
+            int gap = squared_gap(p->red, lo[0], hi[0]) + squared_gap(p->green, lo[1], hi[1]) +
+                      squared_gap(p->blue, lo[2], hi[2]);
+            if (gap > limit) continue;
+            red[candidates] = p->red;
+            green[candidates] = p->green;
+            blue[candidates] = p->blue;
+            index[candidates++] = i;
+        }
+        for (int cr = 0; cr < INVERSE_BLOCK_CELLS; cr++) {
+            for (int cg = 0; cg < INVERSE_BLOCK_CELLS; cg++) {
+                for (int cb = 0; cb < INVERSE_BLOCK_CELLS; cb++) {
+                    // Centre of the cell
+                    int r = lo[0] + cr * step + half, g = lo[1] + cg * step + half, b = lo[2] + cb * step + half;
+                    int best = INT32_MAX, best_index = 0;
+                    for (int i = 0; i < candidates; i++) {
+                        int dr = red[i] - r, dg = green[i] - g, db = blue[i] - b;
+                        int d = dr * dr + dg * dg + db * db;
+                        if (d < best) {
+                            best = d;
+                            best_index = index[i];
+                        }
+                    }
+                    table[quantize_cell(r, g, b)] = (uint8_t)best_index;
+                }
+            }
+        }
+    }
+    return table;
+}
+
+// Floyd-Steinberg over one band of rows, errors kept in sixteenths. The error for the right
+// neighbour and the two partial sums for the row below travel in locals, so every element of
+// the next row is written once, with one spare pixel on either side to spare the edge tests.
+static void dither_band(const t_bmp24 *img, const t_palette *palette, const uint8_t *table, t_bmp8 *out,
+                        int y0, int y1, int *errors) {
+    int w = img->width;
+    int *cur = errors, *next = errors + (size_t)(w + 2) * 3;
+    memset(cur, 0, (size_t)(w + 2) * 3 * sizeof(int));
+    for (int y = y0; y < y1; y++) {
+        const t_pixel *row = img->data[y];
+        uint8_t *dst = out->data + (size_t)(img->height - 1 - y) * w;
+        int right[3] = {0, 0, 0}, left[3] = {0, 0, 0}, below[3] = {0, 0, 0};
+        for (int x = 0; x < w; x++) {
+            int want[3] = {row[x].blue, row[x].green, row[x].red};
+            for (int k = 0; k < 3; k++) {
+                int v = want[k] + ((cur[(x + 1) * 3 + k] + right[k] + 8) >> 4);
+                want[k] = v < 0 ? 0 : v > 255 ? 255 : v;
+            }
+            int index = table[quantize_cell(want[2], want[1], want[0])];
+            dst[x] = (uint8_t)index;
+            const t_pixel *got = &palette->colors[index];
+            int have[3] = {got->blue, got->green, got->red};
+            for (int k = 0; k < 3; k++) {
+                int e = want[k] - have[k];
+                right[k] = e * 7;
+                next[x * 3 + k] = left[k] + e * 3;
+                left[k] = below[k] + e * 5;
+                below[k] = e;
+            }
+        }
+        for (int k = 0; k < 3; k++) {
+            next[w * 3 + k] = left[k];
+            next[(w + 1) * 3 + k] = below[k];
+        }
+        int *swap = cur;
+        cur = next;
+        next = swap;
+    }
+}
+
+t_bmp8 *bmp24_mapToPalette(const t_bmp24 *img, const t_palette *palette, t_dither_mode dither) {
+    if (!img || !img->data || !palette || palette->count < 1 || palette->count > 256) return NULL;
+    uint8_t *table = quantize_inverseTable(palette);
+    t_bmp8 *out = table ? bmp8_allocate(img->width, img->height) : NULL;
+    if (!out) {
+        free(table);
+        return NULL;
+    }
+    memset(out->colorTable, 0, sizeof(out->colorTable));
+    for (int i = 0; i < palette->count; i++) {
+        out->colorTable[i * 4] = palette->colors[i].blue;
+        out->colorTable[i * 4 + 1] = palette->colors[i].green;
+        out->colorTable[i * 4 + 2] = palette->colors[i].red;
+    }
+
+    int w = img->width, h = img->height;
+    int failed = 0;
+    if (dither == DITHER_FLOYD_STEINBERG) {
+        int bands = (h + QUANTIZE_DITHER_ROWS - 1) / QUANTIZE_DITHER_ROWS;
+        #pragma omp parallel
+        {
+            int *errors = (int *)malloc((size_t)(w + 2) * 6 * sizeof(int));
+            if (!errors) {
+                #pragma omp atomic write
+                failed = 1;
+            }
+            #pragma omp for schedule(dynamic)
+            for (int band = 0; band < bands; band++) {
+                if (!errors) continue;
+                int y0 = band * QUANTIZE_DITHER_ROWS;
+                int y1 = y0 + QUANTIZE_DITHER_ROWS < h ? y0 + QUANTIZE_DITHER_ROWS : h;
+                dither_band(img, palette, table, out, y0, y1, errors);
+            }
+            free(errors);
+        }
+    } else {
+        #pragma omp parallel for schedule(static)
+        for (int y = 0; y < h; y++) {
+            const t_pixel *row = img->data[y];
+            uint8_t *dst = out->data + (size_t)(h - 1 - y) * w;
+            for (int x = 0; x < w; x++) dst[x] = table[quantize_cell(row[x].red, row[x].green, row[x].blue)];
+        }
+    }
+    free(table);
+    if (failed) {
+        fprintf(stderr, "Error: Failed to allocate memory for dithering.\n");
+        bmp8_free(out);
+        return NULL;
+    }
+    return out;
+}
+
+t_bmp8 *bmp24_quantize(const t_bmp24 *img, int colors, t_quantize_method method, t_dither_mode dither) {
+    t_palette palette;
+    if (quantize_buildPalette(img, colors, method, &palette) != 0) return NULL;
+    return bmp24_mapToPalette(img, &palette, dither);
+}
+
+t_bmp24 *bmp8_expandPalette(const t_bmp8 *img) {
+    if (!img || !img->data) return NULL;
+    int w = (int)img->width, h = (int)img->height;
+    t_bmp24 *out = bmp24_allocate(w, h, 24);
+    if (!out) return NULL;
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < h; y++) {
+        const uint8_t *src = img->data + (size_t)(h - 1 - y) * w;
+        t_pixel *dst = out->data[y];
+        for (int x = 0; x < w; x++) {
+            const unsigned char *entry = &img->colorTable[src[x] * 4];
+            dst[x].blue = entry[0];
+            dst[x].green = entry[1];
+            dst[x].red = entry[2];
+        }
+    }
+    return out;
+}
@@ -0,0 +1,52 @@
+#ifndef QUANTIZE_H
+#define QUANTIZE_H
+
+#include <stdint.h>
+#include "bmp8.h"
+#include "bmp24.h"
+
+// Bits kept per channel by the colour histogram and the inverse colour table, which therefore
+// have 1 << (3 * QUANTIZE_BITS) cells
+#define QUANTIZE_BITS 5
+#define QUANTIZE_CELLS (1 << (3 * QUANTIZE_BITS))
+
+// Rows dithered in sequence by one thread. Each band starts without carried error, so the
+// result does not depend on the number of threads.
+#define QUANTIZE_DITHER_ROWS 64
+
+typedef enum {
+    QUANTIZE_MEDIAN_CUT,    // Split the most populated box of the colour cube at its median (Heckbert)
+    QUANTIZE_OCTREE         // Merge the least populated octree nodes, deepest first
+} t_quantize_method;
+
+typedef enum {
+    DITHER_NONE,
+    DITHER_FLOYD_STEINBERG
+} t_dither_mode;
+
+// Up to 256 colours, each the mean of the pixels it stands for
+typedef struct {
+    int count;
+    t_pixel colors[256];
+} t_palette;
+
+// Palette of at most colors entries (2 to 256) for img. Returns 0 on success, -1 on error.
+int quantize_buildPalette(const t_bmp24 *img, int colors, t_quantize_method method, t_palette *palette);
+// Nearest palette entry for every cell of the QUANTIZE_BITS colour cube, looked up by
+// quantize_cell(). Returns a table of QUANTIZE_CELLS bytes to free(), or NULL on error.
+uint8_t *quantize_inverseTable(const t_palette *palette);
+
+static inline int quantize_cell(int red, int green, int blue) {
+    return ((red >> (8 - QUANTIZE_BITS)) << (2 * QUANTIZE_BITS)) | ((green >> (8 - QUANTIZE_BITS)) << QUANTIZE_BITS) |
+           (blue >> (8 - QUANTIZE_BITS));
+}
+
+// Indexed image whose colour table holds the palette. Rows are mapped in parallel through the
+// inverse table; Floyd-Steinberg diffuses the error within bands of QUANTIZE_DITHER_ROWS rows.
+// Return NULL on error.
+t_bmp8 *bmp24_mapToPalette(const t_bmp24 *img, const t_palette *palette, t_dither_mode dither);
+t_bmp8 *bmp24_quantize(const t_bmp24 *img, int colors, t_quantize_method method, t_dither_mode dither);
+// Back to 24 bits through the colour table, for indexed and grayscale images alike
+t_bmp24 *bmp8_expandPalette(const t_bmp8 *img);
+
+#endif // QUANTIZE_H
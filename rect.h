@@ -0,0 +1,89 @@
+#ifndef RECT_H
+#define RECT_H
+
+// Rectangle in image coordinates: x counts columns from the left, y counts rows from the top,
+// whatever the row order of the underlying pixel storage.
+typedef struct {
+    int x;
+    int y;
+    int width;
+    int height;
+} t_rect;
+
+// Stores the overlap of a and b into *out, returns 0 if they do not overlap
+static inline int rect_intersect(const t_rect *a, const t_rect *b, t_rect *out) {
+    int x0 = a->x > b->x ? a->x : b->x;
+    int y0 = a->y > b->y ? a->y : b->y;
+    int x1 = (a->x + a->width < b->x + b->width) ? a->x + a->width : b->x + b->width;
+    int y1 = (a->y + a->height < b->y + b->height) ? a->y + a->height : b->y + b->height;
+    out->x = x0;
+    out->y = y0;
+    out->width = x1 > x0 ? x1 - x0 : 0;
+    out->height = y1 > y0 ? y1 - y0 : 0;
+    return out->width > 0 && out->height > 0;
+}
+
+// Smallest rectangle holding both a and b
+static inline t_rect rect_union(const t_rect *a, const t_rect *b) {
+    int x0 = a->x < b->x ? a->x : b->x;
+    int y0 = a->y < b->y ? a->y : b->y;
+    int x1 = (a->x + a->width > b->x + b->width) ? a->x + a->width : b->x + b->width;
+    int y1 = (a->y + a->height > b->y + b->height) ? a->y + a->height : b->y + b->height;
+    t_rect r = {x0, y0, x1 - x0, y1 - y0};
+    return r;
+}
+
+// Clips roi to a width x height image into *out. A NULL roi selects the whole image.
+// Returns 0 if nothing of the rectangle lies inside the image.
+static inline int rect_clip(const t_rect *roi, int width, int height, t_rect *out) {
+    t_rect image = {0, 0, width, height};
+    return rect_intersect(roi ? roi : &image, &image, out);
+}
+
+// Grows a rectangle by margin pixels on every side, e.g. to include a convolution halo
+static inline t_rect rect_expand(t_rect r, int margin) {
+    r.x -= margin;
+    r.y -= margin;
+    r.width += 2 * margin;
+    r.height += 2 * margin;
+    return r;
+}
+
+// Rectangles a dirty region keeps apart before it falls back to their bounding box
+#define DIRTY_MAX_RECTS 16
+
+// Parts of an image changed since a pipeline result was last computed from it, in top-left
+// image coordinates. Overlapping rectangles are merged as they are added, so the rectangles
+// never overlap each other.
+typedef struct {
+    int count;
+    t_rect rects[DIRTY_MAX_RECTS];
+} t_dirty_region;
+
+static inline void dirty_clear(t_dirty_region *dirty) {
+    dirty->count = 0;
+}
+
+// Adds rect to dirty, which may be NULL when nobody tracks the changes
+static inline void dirty_add(t_dirty_region *dirty, const t_rect *rect) {
+    if (!dirty || !rect || rect->width <= 0 || rect->height <= 0) return;
+    // Absorb every rectangle the new one overlaps, starting over as the union grows
+    t_rect merged = *rect;
+    for (int i = 0; i < dirty->count;) {
+        t_rect overlap;
+        if (rect_intersect(&dirty->rects[i], &merged, &overlap)) {
+            merged = rect_union(&dirty->rects[i], &merged);
+            dirty->rects[i] = dirty->rects[--dirty->count];
+            i = 0;
+        } else {
+            i++;
+        }
+    }
+    if (dirty->count == DIRTY_MAX_RECTS) {
+        for (int i = 0; i < dirty->count; i++) merged = rect_union(&dirty->rects[i], &merged);
+        dirty->count = 0;
+    }
+    dirty->rects[dirty->count++] = merged;
+}
+
+#endif // RECT_H
@@ -0,0 +1,267 @@
+#include "resize.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define WEIGHT_BITS 14
+#define WEIGHT_ONE (1 << WEIGHT_BITS)
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// One entry per output sample: the first source sample and the fixed-point taps to apply from there
+typedef struct {
+    int *start;
+    int *count;
+    int *weights;   // maxTaps entries per output sample
+    int maxTaps;
+} t_weight_table;
+
+static double filter_support(t_resize_filter filter) {
+    switch (filter) {
+        case RESIZE_BOX: return 0.5;
+        case RESIZE_BILINEAR: return 1.0;
+        case RESIZE_BICUBIC: return 2.0;
+        case RESIZE_LANCZOS3: return 3.0;
+    }
+    return 1.0;
+}
+
+static double sinc(double x) {
+    if (x == 0.0) return 1.0;
+    x *= M_PI;
+    return sin(x) / x;
+}
+
+static double filter_eval(t_resize_filter filter, double x) {
+    if (x < 0.0) x = -x;
+    switch (filter) {
+        case RESIZE_BOX:
+            return (x < 0.5) ? 1.0 : 0.0;
+        case RESIZE_BILINEAR:
+            return (x < 1.0) ? 1.0 - x : 0.0;
+        case RESIZE_BICUBIC: {
+            const double a = -0.5;
+            if (x < 1.0) return ((a + 2.0) * x - (a + 3.0)) * x * x + 1.0;
+            if (x < 2.0) return (((x - 5.0) * x + 8.0) * x - 4.0) * a;
+            return 0.0;
+        }
+        case RESIZE_LANCZOS3:
+            return (x < 3.0) ? sinc(x) * sinc(x / 3.0) : 0.0;
+    }
+    return 0.0;
+}
+
+static void free_weights(t_weight_table *table) {
+    free(table->start);
+    free(table->count);
+    free(table->weights);
+}
+
+// Computes the taps of every output sample once, so both passes only do integer multiply-adds.
+// When shrinking, all filters except bilinear are widened by the scale factor to average every
+// covered source sample; bilinear keeps two taps so its cost follows the output size only.
+static int build_weights(t_weight_table *table, int inSize, int outSize, t_resize_filter filter) {
+    double scale = (double)inSize / (double)outSize;
+    double filterScale = (scale > 1.0 && filter != RESIZE_BILINEAR) ? scale : 1.0;
+    double support = filter_support(filter) * filterScale;
+
+    table->maxTaps = (int)ceil(support) * 2 + 1;
+    table->start = (int *)malloc(outSize * sizeof(int));
+    table->count = (int *)malloc(outSize * sizeof(int));
+    table->weights = (int *)calloc((size_t)outSize * table->maxTaps, sizeof(int));
+    double *taps = (double *)malloc(table->maxTaps * sizeof(double));
+    if (!table->start || !table->count || !table->weights || !taps) {
+        fprintf(stderr, "Error: Failed to allocate resize weight table.\n");
+        free_weights(table);
+        free(taps);
+        return -1;
+    }
+
+    for (int i = 0; i < outSize; i++) {
+        double center = (i + 0.5) * scale;
+        int lo = (int)floor(center - support + 0.5);
+        int hi = (int)floor(center + support + 0.5);
+        if (lo < 0) lo = 0;
+        if (hi > inSize) hi = inSize;
+        int n = hi - lo;
+        if (n > table->maxTaps) n = table->maxTaps;
+
+        double total = 0.0;
+        for (int k = 0; k < n; k++) {
+            taps[k] = filter_eval(filter, (lo + k + 0.5 - center) / filterScale);
+            total += taps[k];
+        }
+        if (n <= 0 || total == 0.0) {
+            // Degenerate footprint: fall back to the nearest source sample
+            lo = (int)center;
+            if (lo >= inSize) lo = inSize - 1;
+            n = 1;
+            taps[0] = total = 1.0;
+        }
+
+        // Drop zero taps at both ends so they are never fetched
+        while (n > 1 && taps[n - 1] == 0.0) n--;
+        int first = 0;
+        while (first < n - 1 && taps[first] == 0.0) first++;
+
+        int *w = table->weights + (size_t)i * table->maxTaps;
+        int sum = 0, largest = 0;
+        for (int k = first; k < n; k++) {
+            w[k - first] = (int)lround(taps[k] / total * WEIGHT_ONE);
+            sum += w[k - first];
+            if (abs(w[k - first]) > abs(w[largest])) largest = k - first;
+        }
+        // Rounding must not change the overall gain
+        w[largest] += WEIGHT_ONE - sum;
+
+        table->start[i] = lo + first;
+        table->count[i] = n - first;
+    }
+    free(taps);
+    return 0;
+}
+
+static uint8_t fixed_to_uint8(int sum) {
+    if (sum < 0) return 0;
+    sum >>= WEIGHT_BITS;
+    return (sum > 255) ? 255 : (uint8_t)sum;
+}
+
+// Resamples interleaved 8-bit rows with `channels` samples per pixel: horizontal pass first into
+// an intermediate buffer, restricted to the source rows the vertical taps actually read.
+static int resize_rows(uint8_t *const *srcRows, int inW, int inH,
+                       uint8_t *const *dstRows, int outW, int outH,
+                       int channels, t_resize_filter filter) {
+    t_weight_table horizontal, vertical;
+    if (build_weights(&horizontal, inW, outW, filter) != 0) return -1;
+    if (build_weights(&vertical, inH, outH, filter) != 0) {
+        free_weights(&horizontal);
+        return -1;
+    }
+
+    size_t rowLen = (size_t)outW * channels;
+    uint8_t *tmp = (uint8_t *)malloc(rowLen * inH);
+    unsigned char *needed = (unsigned char *)calloc(inH, 1);
+    if (!tmp || !needed) {
+        fprintf(stderr, "Error: Failed to allocate intermediate resize buffer.\n");
+        free(tmp);
+        free(needed);
+        free_weights(&horizontal);
+        free_weights(&vertical);
+        return -1;
+    }
+    for (int y = 0; y < outH; y++) {
+        for (int k = 0; k < vertical.count[y]; k++) {
+            needed[vertical.start[y] + k] = 1;
+        }
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < inH; y++) {
+        if (!needed[y]) continue;
+        const uint8_t *src = srcRows[y];
+        uint8_t *out = tmp + (size_t)y * rowLen;
+        for (int x = 0; x < outW; x++) {
+            const int *w = horizontal.weights + (size_t)x * horizontal.maxTaps;
+            const uint8_t *s = src + (size_t)horizontal.start[x] * channels;
+            int count = horizontal.count[x];
+            for (int c = 0; c < channels; c++) {
+                int sum = WEIGHT_ONE / 2;
+                for (int k = 0; k < count; k++) {
+                    sum += w[k] * s[k * channels + c];
+                }
+                out[x * channels + c] = fixed_to_uint8(sum);
+            }
+        }
+    }
+
+    int status = 0;
+    #pragma omp parallel
+    {
+        int *acc = (int *)malloc(rowLen * sizeof(int));
+        if (!acc) {
+            #pragma omp atomic write
+            status = -1;
+        }
+        #pragma omp for schedule(static)
+        for (int y = 0; y < outH; y++) {
+            if (!acc) continue;
+            for (size_t i = 0; i < rowLen; i++) acc[i] = WEIGHT_ONE / 2;
+            const int *w = vertical.weights + (size_t)y * vertical.maxTaps;
+            for (int k = 0; k < vertical.count[y]; k++) {
+                const uint8_t *row = tmp + (size_t)(vertical.start[y] + k) * rowLen;
+                int wk = w[k];
+                for (size_t i = 0; i < rowLen; i++) {
+                    acc[i] += wk * row[i];
+                }
+            }
+            uint8_t *dst = dstRows[y];
+            for (size_t i = 0; i < rowLen; i++) {
+                dst[i] = fixed_to_uint8(acc[i]);
+            }
+        }
+        free(acc);
+    }
+    if (status != 0) {
+        fprintf(stderr, "Error: Failed to allocate resize accumulator.\n");
+    }
+
+    free(tmp);
+    free(needed);
+    free_weights(&horizontal);
+    free_weights(&vertical);
+    return status;
+}
+
+t_bmp8 *bmp8_resize(const t_bmp8 *img, unsigned int newWidth, unsigned int newHeight, t_resize_filter filter) {
+    if (!img || !img->data || newWidth == 0 || newHeight == 0) {
+        fprintf(stderr, "Error: Invalid parameters for bmp8_resize.\n");
+        return NULL;
+    }
+    t_bmp8 *out = bmp8_allocate(newWidth, newHeight);
+    if (!out) return NULL;
+    memcpy(out->colorTable, img->colorTable, sizeof(out->colorTable));
+
+    uint8_t **srcRows = (uint8_t **)malloc(img->height * sizeof(uint8_t *));
+    uint8_t **dstRows = (uint8_t **)malloc(newHeight * sizeof(uint8_t *));
+    if (!srcRows || !dstRows) {
+        fprintf(stderr, "Error: Failed to allocate row pointers in bmp8_resize.\n");
+        free(srcRows);
+        free(dstRows);
+        bmp8_free(out);
+        return NULL;
+    }
+    for (unsigned int y = 0; y < img->height; y++) srcRows[y] = img->data + (size_t)y * img->width;
+    for (unsigned int y = 0; y < newHeight; y++) dstRows[y] = out->data + (size_t)y * newWidth;
+
+    int status = resize_rows(srcRows, (int)img->width, (int)img->height,
+                             dstRows, (int)newWidth, (int)newHeight, 1, filter);
+    free(srcRows);
+    free(dstRows);
+    if (status != 0) {
+        bmp8_free(out);
+        return NULL;
+    }
+    return out;
+}
+
+t_bmp24 *bmp24_resize(const t_bmp24 *img, int newWidth, int newHeight, t_resize_filter filter) {
+    if (!img || !img->data || newWidth <= 0 || newHeight <= 0) {
+        fprintf(stderr, "Error: Invalid parameters for bmp24_resize.\n");
+        return NULL;
+    }
+    t_bmp24 *out = bmp24_allocate(newWidth, newHeight, img->colorDepth);
+    if (!out) return NULL;
+
+    // t_pixel is three packed bytes, so each row is already an interleaved BGR byte row
+    int status = resize_rows((uint8_t *const *)img->data, img->width, img->height,
+                             (uint8_t *const *)out->data, newWidth, newHeight, 3, filter);
+    if (status != 0) {
+        bmp24_free(out);
+        return NULL;
+    }
+    return out;
+}
@@ -0,0 +1,17 @@
+#ifndef RESIZE_H
+#define RESIZE_H
+
+#include "bmp8.h"
+#include "bmp24.h"
+
+typedef enum {
+    RESIZE_BOX,       // Area average when shrinking, nearest neighbour when enlarging
+    RESIZE_BILINEAR,  // Two taps, not widened when shrinking (fast previews)
+    RESIZE_BICUBIC,   // Catmull-Rom style cubic, widened when shrinking
+    RESIZE_LANCZOS3   // Windowed sinc with three lobes, widened when shrinking
+} t_resize_filter;
+
+t_bmp8 *bmp8_resize(const t_bmp8 *img, unsigned int newWidth, unsigned int newHeight, t_resize_filter filter);
+t_bmp24 *bmp24_resize(const t_bmp24 *img, int newWidth, int newHeight, t_resize_filter filter);
+
+#endif // RESIZE_H
@@ -0,0 +1,395 @@
+#include "server.h"
+#include "bmp8.h"
+#include "bmp24.h"
+#include "pipeline.h"
+#include "probe.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+typedef struct {
+    char *spec;
+    t_pipeline *pipeline;
+} t_cached_pipeline;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    int fds[SERVER_QUEUE_SIZE];
+    int head;
+    int count;
+    int stopping;
+    int threads_per_worker;     // OpenMP team of each worker, so all workers together fill the cores
+
+    pthread_mutex_t cache_lock;
+    t_cached_pipeline cache[SERVER_PIPELINE_CACHE];
+    int cache_count;
+} t_server;
+
+// Image buffers owned by one worker and reused while consecutive inputs have the same size: the
+// input is read into img8 or img24, and the tiled passes write into the spare of the same depth
+// and swap storage with it
+typedef struct {
+    t_server *server;
+    t_bmp8 *img8;
+    t_bmp8 *spare8;
+    t_bmp24 *img24;
+    t_bmp24 *spare24;
+    int fd;                 // Connection being served, -1 when idle; guarded by server->lock
+} t_worker;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void handle_stop_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+static t_pipeline *find_cached(t_server *server, const char *spec) {
+    for (int i = 0; i < server->cache_count; i++) {
+        if (strcmp(server->cache[i].spec, spec) == 0) return server->cache[i].pipeline;
+    }
+    return NULL;
+}
+
+// Cached pipelines are never modified or freed before shutdown, so workers share them without
+// locking. Once the cache is full, new chains are parsed per request and *owned is set so the
+// caller frees them.
+static t_pipeline *get_pipeline(t_server *server, const char *spec, int *owned) {
+    *owned = 0;
+    pthread_mutex_lock(&server->cache_lock);
+    t_pipeline *cached = find_cached(server, spec);
+    pthread_mutex_unlock(&server->cache_lock);
+    if (cached) return cached;
+
+    t_pipeline *pipeline = pipeline_parse(spec);
+    if (!pipeline) return NULL;
+    pipeline_optimize(pipeline);
+
+    pthread_mutex_lock(&server->cache_lock);
+    cached = find_cached(server, spec);
+    char *copy = NULL;
+    if (!cached && server->cache_count < SERVER_PIPELINE_CACHE && (copy = strdup(spec)) != NULL) {
+        server->cache[server->cache_count].spec = copy;
+        server->cache[server->cache_count].pipeline = pipeline;
+        server->cache_count++;
+        cached = pipeline;
+    }
+    pthread_mutex_unlock(&server->cache_lock);
+
+    if (cached == pipeline) return pipeline;
+    if (cached) {
+        // Another worker cached the same chain meanwhile
+        pipeline_free(pipeline);
+        return cached;
+    }
+    *owned = 1;
+    return pipeline;
+}
+
+// Loads a 24-bit image into the worker's buffer when the size matches, otherwise replaces it
+static t_bmp24 *load_bmp24(t_worker *worker, const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) return NULL;
+    t_bmp_header header;
+    t_bmp_info info;
+    int ok = fread(&header, sizeof(header), 1, file) == 1 && fread(&info, sizeof(info), 1, file) == 1;
+    t_bmp24 *img = worker->img24;
+    if (ok && img && header.type == BMP_TYPE && info.bits == 24 && info.compression == 0 &&
+        info.width == img->width && info.height == img->height) {
+        img->header = header;
+        img->header_info = info;
+        bmp24_readPixelData(img, file);
+        // A short read leaves part of the buffer from the previous request
+        int failed = ferror(file) || feof(file);
+        fclose(file);
+        return failed ? NULL : img;
+    }
+    fclose(file);
+    bmp24_free(worker->img24);
+    worker->img24 = bmp24_loadImage(filename);
+    return worker->img24;
+}
+
+// Same for 8-bit images, whose rows bmp8_loadImage reads bottom-up from just after the colour table
+static t_bmp8 *load_bmp8(t_worker *worker, const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) return NULL;
+    unsigned char header[PROBE_HEADER_SIZE], colorTable[1024];
+    t_bmp_probe probe;
+    int ok = fread(header, sizeof(header), 1, file) == 1 && fread(colorTable, sizeof(colorTable), 1, file) == 1 &&
+             bmp_probeHeader(header, &probe) == 0;
+    t_bmp8 *img = worker->img8;
+    if (ok && img && probe.depth == 8 && probe.compression == 0 && !probe.topDown &&
+        (unsigned int)probe.width == img->width && (unsigned int)probe.height == img->height) {
+        memcpy(img->header, header, sizeof(header));
+        memcpy(img->colorTable, colorTable, sizeof(colorTable));
+        int failed = bmp8_readPixelData(img, file) != 0;
+        fclose(file);
+        return failed ? NULL : img;
+    }
+    fclose(file);
+    bmp8_free(worker->img8);
+    worker->img8 = bmp8_loadImage(filename);
+    return worker->img8;
+}
+
+// The spare images follow the size of the input; without one, the passes allocate as usual
+static t_bmp8 *spare_bmp8(t_worker *worker, const t_bmp8 *img) {
+    if (!worker->spare8 || worker->spare8->width != img->width || worker->spare8->height != img->height) {
+        bmp8_free(worker->spare8);
+        worker->spare8 = bmp8_allocate(img->width, img->height);
+    }
+    return worker->spare8;
+}
+
+static t_bmp24 *spare_bmp24(t_worker *worker, const t_bmp24 *img) {
+    if (!worker->spare24 || worker->spare24->width != img->width || worker->spare24->height != img->height) {
+        bmp24_free(worker->spare24);
+        worker->spare24 = bmp24_allocate(img->width, img->height, 24);
+    }
+    return worker->spare24;
+}
+
+static const char *run_pipeline(t_worker *worker, const t_pipeline *pipeline, const char *input, const char *output) {
+    t_bmp_probe probe;
+    if (bmp_probe(input, &probe) != 0) return "input is not a readable BMP";
+    int depth = probe.depth;
+
+    if (depth == 8) {
+        t_bmp8 *img = load_bmp8(worker, input);
+        if (!img) return "cannot load input";
+        if (pipeline_executeTiledSpareBmp8(pipeline, img, spare_bmp8(worker, img), 0) != 0) return "processing failed";
+        bmp8_saveImage(output, img);
+        return NULL;
+    }
+    if (depth == 24) {
+        t_bmp24 *img = load_bmp24(worker, input);
+        if (!img) return "cannot load input";
+        if (pipeline_executeTiledSpareBmp24(pipeline, img, spare_bmp24(worker, img), 0) != 0) {
+            return "processing failed";
+        }
+        bmp24_saveImage(img, output);
+        return NULL;
+    }
+    return "unsupported bit depth";
+}
+
+static const char *process_request(t_worker *worker, const char *input, const char *output, const char *spec) {
+    int owned;
+    t_pipeline *pipeline = get_pipeline(worker->server, spec, &owned);
+    if (!pipeline) return "invalid op chain";
+    const char *error = run_pipeline(worker, pipeline, input, output);
+    if (owned) pipeline_free(pipeline);
+    return error;
+}
+
+static void reply(int fd, const char *error) {
+    char line[256];
+    int len = error ? snprintf(line, sizeof(line), "ERROR %s\n", error) : snprintf(line, sizeof(line), "OK\n");
+    const char *p = line;
+    while (len > 0) {
+        ssize_t written = write(fd, p, len);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return;
+        p += written;
+        len -= (int)written;
+    }
+}
+
+// Answers the requests of one connection until the client closes it or the server shuts down
+// its reading side; the caller closes fd
+static void serve_connection(t_worker *worker, int fd) {
+    FILE *in = fdopen(dup(fd), "r");
+    if (!in) return;
+    char line[SERVER_MAX_REQUEST];
+    while (fgets(line, sizeof(line), in)) {
+        size_t length = strlen(line);
+        if (length == sizeof(line) - 1 && line[length - 1] != '\n') {
+            // The rest of an overlong request is dropped, so it gets a single answer
+            int c;
+            while ((c = fgetc(in)) != EOF && c != '\n') {
+            }
+            reply(fd, "request too long");
+            continue;
+        }
+        line[strcspn(line, "\r\n")] = '\0';
+        if (strcmp(line, "PING") == 0) {
+            reply(fd, NULL);
+            continue;
+        }
+        char *fields[4];
+        int count = 0;
+        char *save = NULL;
+        for (char *field = strtok_r(line, "\t", &save); field && count < 4; field = strtok_r(NULL, "\t", &save)) {
+            fields[count++] = field;
+        }
+        if (count != 4 || strcmp(fields[0], "RUN") != 0) {
+            reply(fd, "malformed request");
+            continue;
+        }
+        reply(fd, process_request(worker, fields[1], fields[2], fields[3]));
+    }
+    fclose(in);
+}
+
+static void *worker_main(void *arg) {
+    t_worker *worker = (t_worker *)arg;
+    t_server *server = worker->server;
+#ifdef _OPENMP
+    // The parallel loops of every request run on this thread's share of the cores
+    omp_set_num_threads(server->threads_per_worker);
+#endif
+    for (;;) {
+        pthread_mutex_lock(&server->lock);
+        while (server->count == 0 && !server->stopping) pthread_cond_wait(&server->ready, &server->lock);
+        if (server->count == 0) {
+            pthread_mutex_unlock(&server->lock);
+            break;
+        }
+        int fd = server->fds[server->head];
+        server->head = (server->head + 1) % SERVER_QUEUE_SIZE;
+        server->count--;
+        worker->fd = fd;
+        // Connections still queued at shutdown get the requests they already sent answered
+        if (server->stopping) shutdown(fd, SHUT_RD);
+        pthread_mutex_unlock(&server->lock);
+        serve_connection(worker, fd);
+        pthread_mutex_lock(&server->lock);
+        worker->fd = -1;
+        pthread_mutex_unlock(&server->lock);
+        close(fd);
+    }
+    bmp8_free(worker->img8);
+    bmp8_free(worker->spare8);
+    bmp24_free(worker->img24);
+    bmp24_free(worker->spare24);
+    return NULL;
+}
+
+static int open_socket(const char *socketPath) {
+    struct sockaddr_un addr;
+    if (strlen(socketPath) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: Socket path %s is too long.\n", socketPath);
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socketPath);
+    unlink(socketPath);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SERVER_QUEUE_SIZE) != 0) {
+        perror("bind/listen");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int server_run(const char *socketPath, int workers) {
+    if (!socketPath || workers <= 0) {
+        fprintf(stderr, "Error: Invalid server parameters.\n");
+        return -1;
+    }
+    int listen_fd = open_socket(socketPath);
+    if (listen_fd < 0) return -1;
+
+    // No SA_RESTART, so a signal interrupts accept()
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_stop_signal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    t_server server;
+    memset(&server, 0, sizeof(server));
+    pthread_mutex_init(&server.lock, NULL);
+    pthread_cond_init(&server.ready, NULL);
+    pthread_mutex_init(&server.cache_lock, NULL);
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    server.threads_per_worker = cores > workers ? (int)(cores / workers) : 1;
+
+    pthread_t *threads = (pthread_t *)malloc(workers * sizeof(pthread_t));
+    t_worker *states = (t_worker *)calloc(workers, sizeof(t_worker));
+    int started = 0;
+    if (threads && states) {
+        // Workers inherit a mask without the stop signals, so only the accept loop sees them
+        sigset_t stopSignals, previous;
+        sigemptyset(&stopSignals);
+        sigaddset(&stopSignals, SIGINT);
+        sigaddset(&stopSignals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &stopSignals, &previous);
+        for (; started < workers; started++) {
+            states[started].server = &server;
+            states[started].fd = -1;
+            if (pthread_create(&threads[started], NULL, worker_main, &states[started]) != 0) break;
+        }
+        pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    }
+    if (started == 0) {
+        fprintf(stderr, "Error: Failed to start worker threads.\n");
+        stop_requested = 1;
+    } else {
+        printf("Listening on %s with %d workers.\n", socketPath, started);
+        fflush(stdout);
+    }
+
+    while (!stop_requested) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            perror("accept");
+            break;
+        }
+        pthread_mutex_lock(&server.lock);
+        if (server.count == SERVER_QUEUE_SIZE) {
+            pthread_mutex_unlock(&server.lock);
+            reply(fd, "server busy");
+            close(fd);
+            continue;
+        }
+        server.fds[(server.head + server.count) % SERVER_QUEUE_SIZE] = fd;
+        server.count++;
+        pthread_cond_signal(&server.ready);
+        pthread_mutex_unlock(&server.lock);
+    }
+
+    // Shutting down the reading side of open connections ends the wait for their next request,
+    // so idle clients cannot hold the workers; requests already received are still answered
+    pthread_mutex_lock(&server.lock);
+    server.stopping = 1;
+    for (int i = 0; i < started; i++) {
+        if (states[i].fd >= 0) shutdown(states[i].fd, SHUT_RD);
+    }
+    pthread_cond_broadcast(&server.ready);
+    pthread_mutex_unlock(&server.lock);
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+
+    close(listen_fd);
+    unlink(socketPath);
+    for (int i = 0; i < server.cache_count; i++) {
+        free(server.cache[i].spec);
+        pipeline_free(server.cache[i].pipeline);
+    }
+    pthread_mutex_destroy(&server.lock);
+    pthread_cond_destroy(&server.ready);
+    pthread_mutex_destroy(&server.cache_lock);
+    free(threads);
+    free(states);
+    return started > 0 ? 0 : -1;
+}
@@ -0,0 +1,26 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+// Long-running local daemon: clients connect to a Unix domain socket and send one request per
+// line, and every request is answered by one line.
+//
+//   RUN\t<input.bmp>\t<output.bmp>\t<ops>   ->  "OK" or "ERROR <reason>"
+//   PING                                    ->  "OK"
+//
+// ops uses the syntax of pipeline_parse. A connection may carry any number of requests.
+// Parsed and optimized pipelines, worker threads and each worker's image buffers stay alive
+// between requests, so a request only pays for its file I/O and the processing itself. Each
+// worker runs the parallel loops of its requests on cores / workers threads.
+
+#define SERVER_DEFAULT_WORKERS 4
+#define SERVER_QUEUE_SIZE 64          // Accepted connections waiting for a worker
+#define SERVER_PIPELINE_CACHE 32      // Distinct op chains kept parsed and optimized
+#define SERVER_MAX_REQUEST 4096      // Longest request line; longer ones get one "ERROR request too long"
+
+// Listens on socketPath until SIGINT or SIGTERM. Then every connection, open or still queued, gets
+// the requests it already sent answered and is closed, even if the client stays idle; the socket
+// file is removed once the workers have exited.
+// Returns 0 on a clean shutdown, -1 if the server could not start.
+int server_run(const char *socketPath, int workers);
+
+#endif // SERVER_H